@@ -0,0 +1,120 @@
+/*
+ * Copyright (C) Ethan Gutknecht 2021 (gutkneET@miamioh.edu)
+ *
+ * Implementation of the bounded queue of requests.
+ */
+
+#include <thread>
+#include <cstdlib>
+#include <utility>
+#include <iterator>
+#include <algorithm>
+#include "AdmissionQueue.h"
+#include "Helper.h"
+
+const char* const AdmissionQueue::PriorityNames[] = {"interactive", "scan",
+                                                     "wait"};
+
+AdmissionQueue::AdmissionQueue(size_t capacity, int maxWaitMs) :
+    capacity(capacity), maxWait(maxWaitMs) {
+}
+
+int
+AdmissionQueue::fromEnv(const std::string& var, int defaultValue) {
+    const char* const env = std::getenv(var.c_str());
+    if (env == nullptr) {
+        return defaultValue;
+    }
+    const int value = std::atoi(env);
+    if (value <= 0) {
+        throw Exp("Invalid " + var + " " + env + " (expected a number > 0)");
+    }
+    return value;
+}
+
+bool
+AdmissionQueue::push(Priority priority, Task run, Task reject,
+        bool admitted) {
+    Task evicted;
+    {
+        std::lock_guard<std::mutex> guard(mutex);
+        if (numJobs >= capacity && priority == Interactive) {
+            // Make room by evicting the newest request of the lowest
+            // priority, which has been waiting the least. Requests that
+            // were admitted before are not evicted.
+            for (int p = NumPriorities - 1; (!evicted && p > Interactive);
+                 p--) {
+                const auto job = std::find_if(jobs[p].rbegin(),
+                    jobs[p].rend(), [](const Job& j) { return !j.admitted; });
+                if (job != jobs[p].rend()) {
+                    evicted = std::move(job->reject);
+                    jobs[p].erase(std::next(job).base());
+                    numJobs--;
+                }
+            }
+        }
+        if (!admitted && (numJobs >= capacity ||
+                          jobs[priority].size() >= (capacity >> priority))) {
+            return false;
+        }
+        jobs[priority].push_back({std::chrono::steady_clock::now(),
+                std::move(run), std::move(reject), admitted});
+        numJobs++;
+    }
+    jobReady.notify_one();
+    if (evicted) {
+        evicted();  // Outside the lock, as it writes to a client.
+    }
+    return true;
+}
+
+void
+AdmissionQueue::start(int numWorkers) {
+    scanWorkers = std::max(1, numWorkers / 2);
+    for (int i = 0; (i < std::max(1, numWorkers)); i++) {
+        std::thread(&AdmissionQueue::work, this).detach();
+    }
+}
+
+int
+AdmissionQueue::runnable() const {
+    int p = Interactive;
+    while ((p < NumPriorities && (jobs[p].empty() ||
+            (p != Interactive && runningScans >= scanWorkers)))) {
+        p++;
+    }
+    return p;
+}
+
+void
+AdmissionQueue::work() {
+    while (true) {
+        Job job;
+        int p;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            jobReady.wait(lock, [&] { return (p = runnable()) <
+                        NumPriorities; });
+            job = std::move(jobs[p].front());
+            jobs[p].pop_front();
+            numJobs--;
+            runningScans += (p != Interactive);
+        }
+        // A client that waited this long has likely given up. So the time
+        // to run its request is better spent on newer requests. A resumed
+        // request was waited for on purpose, so it is always run.
+        if (!job.admitted &&
+            std::chrono::steady_clock::now() - job.arrived > maxWait) {
+            job.reject();
+        } else {
+            job.run();
+        }
+        if (p != Interactive) {
+            {
+                std::lock_guard<std::mutex> guard(mutex);
+                runningScans--;
+            }
+            jobReady.notify_one();  // Another scan may run now.
+        }
+    }
+}
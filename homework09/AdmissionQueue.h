@@ -0,0 +1,142 @@
+#ifndef ADMISSION_QUEUE_H
+#define ADMISSION_QUEUE_H
+
+/*
+ * Copyright (C) Ethan Gutknecht 2021 (gutkneET@miamioh.edu)
+ *
+ * A bounded queue of requests that are run by a fixed pool of worker
+ * threads. When the server is overloaded, requests are rejected right away
+ * (instead of piling up in threads) if the queue is full, or if they wait
+ * in the queue for too long. Cheap (interactive) requests are run before
+ * scans and wait queries, which may use only half the workers, so that
+ * cheap requests stay fast under overload.
+ */
+
+#include <mutex>
+#include <deque>
+#include <chrono>
+#include <string>
+#include <functional>
+#include <condition_variable>
+
+/** A bounded, prioritized queue of requests */
+class AdmissionQueue {
+public:
+    /** The priorities of requests, from highest to lowest */
+    enum Priority { Interactive, Scan, Wait, NumPriorities };
+
+    /** The names of the priorities, as shown by explain */
+    static const char* const PriorityNames[NumPriorities];
+
+    /** The work to be done to run (or reject) a request */
+    using Task = std::function<void()>;
+
+    /**
+     * Creates a queue. The server sets its size (default 256) and deadline
+     * (default 1000 milliseconds) via SQLAIR_QUEUE_SIZE and SQLAIR_QUEUE_MS
+     * (see fromEnv()).
+     *
+     * @param capacity The maximum number of requests in the queue.
+     * @param maxWaitMs The longest time (in milliseconds) that a request
+     * may wait in the queue.
+     */
+    AdmissionQueue(size_t capacity, int maxWaitMs);
+
+    /**
+     * Returns a setting from an environment variable, or a default value
+     * if the variable is not set.
+     *
+     * @exception Exp Thrown if the variable is not a number > 0.
+     */
+    static int fromEnv(const std::string& var, int defaultValue);
+
+    /**
+     * Adds a request to the queue. Each priority may use only a part of
+     * the queue (all of it for interactive requests, half for scans, and a
+     * quarter for wait queries). If an interactive request finds the queue
+     * full, the newest request with a lower priority is rejected to make
+     * room for it.
+     *
+     * @param priority The priority of the request.
+     * @param run The task that runs the request.
+     * @param reject The task that tells the client that the request was
+     * rejected, if it waits in the queue for too long or is evicted.
+     * @param admitted True if the request was admitted before (such as a
+     * parked wait query that is resumed), in which case it is added even
+     * if the queue is full, and is run however long it waits.
+     *
+     * @return False if there is no room for the request. The caller must
+     * then reject the request.
+     */
+    bool push(Priority priority, Task run, Task reject,
+        bool admitted = false);
+
+    /**
+     * Starts the (detached) worker threads that run the requests.
+     *
+     * @param numWorkers The number of worker threads.
+     */
+    void start(int numWorkers);
+
+private:
+    /** A request waiting in the queue */
+    struct Job {
+        /** The time when the request was added to the queue */
+        std::chrono::steady_clock::time_point arrived;
+
+        /** The task that runs the request */
+        Task run;
+
+        /** The task that rejects the request */
+        Task reject;
+
+        /**
+         * True if the request was admitted before (see push), in which
+         * case it is neither rejected for its wait nor evicted
+         */
+        bool admitted;
+    };
+
+    /**
+     * Runs the requests in the queue, highest priority first. Requests
+     * that waited for longer than the deadline (unless they were admitted
+     * before) are rejected instead. Each
+     * worker thread runs this method, which never returns.
+     */
+    void work();
+
+    /**
+     * Returns the highest priority with a request that can be run now, or
+     * NumPriorities if there is none. The caller must hold the mutex.
+     */
+    int runnable() const;
+
+    /** The maximum number of requests in the queue */
+    const size_t capacity;
+
+    /** The longest time a request may wait in the queue */
+    const std::chrono::milliseconds maxWait;
+
+    /** The requests waiting at each priority, oldest first */
+    std::deque<Job> jobs[NumPriorities];
+
+    /** The number of requests in jobs */
+    size_t numJobs = 0;
+
+    /**
+     * The number of workers that may run scans (and wait queries) at the
+     * same time
+     */
+    int scanWorkers = 1;
+
+    /** The number of workers running scans or wait queries */
+    int runningScans = 0;
+
+    /** Guards the jobs */
+    std::mutex mutex;
+
+    /** Notified when a request is added to the queue or a scan ends */
+    std::condition_variable jobReady;
+};
+
+#endif /* ADMISSION_QUEUE_H */
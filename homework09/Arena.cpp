@@ -0,0 +1,125 @@
+/*
+ * Copyright (C) Ethan Gutknecht 2021 (gutkneET@miamioh.edu)
+ *
+ * Implementation of the arena allocator and the reusable output buffer.
+ */
+
+#include <algorithm>
+#include <mutex>
+#include "Arena.h"
+
+// Definition for the constant used by reference.
+const size_t Arena::MaxRetained;
+
+/** The mutex used to guard the pools of arenas and buffers below */
+std::mutex poolMutex;
+
+/**
+ * The server uses a separate thread for each connection. So that their
+ * memory is reused, the arena and output buffer of a thread are placed in
+ * a pool when the thread finishes and are reused by the next thread.
+ */
+template <typename T>
+class Borrowed {
+public:
+    explicit Borrowed(std::vector<std::unique_ptr<T>>& pool) : pool(pool) {
+        std::lock_guard<std::mutex> guard(poolMutex);
+        if (pool.empty()) {
+            obj.reset(new T());
+        } else {
+            obj = std::move(pool.back());
+            pool.pop_back();
+        }
+    }
+
+    ~Borrowed() {
+        std::lock_guard<std::mutex> guard(poolMutex);
+        pool.push_back(std::move(obj));
+    }
+
+    std::vector<std::unique_ptr<T>>& pool;
+    std::unique_ptr<T> obj;
+};
+
+/** The arenas and output buffers that are not used by any thread */
+std::vector<std::unique_ptr<Arena>> arenaPool;
+std::vector<std::unique_ptr<OutputBuffer>> bufferPool;
+
+void*
+Arena::allocate(size_t bytes, size_t align) {
+    while (current < chunks.size()) {
+        // Align the offset in the current chunk & check if there is space.
+        const size_t start = (offset + align - 1) / align * align;
+        if (start + bytes <= chunks[current].second) {
+            offset = start + bytes;
+            return chunks[current].first.get() + start;
+        }
+        current++;
+        offset = 0;
+    }
+    // Need a new chunk. Chunks are allocated via new[], so they are
+    // suitably aligned for any type.
+    const size_t size = std::max(chunkSize, bytes);
+    chunks.emplace_back(std::unique_ptr<char[]>(new char[size]), size);
+    current = chunks.size() - 1;
+    offset  = bytes;
+    return chunks.back().first.get();
+}
+
+void
+Arena::rewind(const Mark& pos) {
+    current = pos.first;
+    offset  = pos.second;
+    // Free chunks (that are not in use) if we are holding on to too much.
+    while (chunks.size() > current + 1 && capacity() > MaxRetained) {
+        chunks.pop_back();
+    }
+}
+
+size_t
+Arena::capacity() const {
+    size_t total = 0;
+    for (const auto& chunk : chunks) {
+        total += chunk.second;
+    }
+    return total;
+}
+
+Arena&
+Arena::forThread() {
+    thread_local Borrowed<Arena> arena(arenaPool);
+    return *arena.obj;
+}
+
+//----------------------------[  OutputBuffer  ]---------------------------
+
+OutputBuffer::StringBuf::int_type
+OutputBuffer::StringBuf::overflow(int_type ch) {
+    if (!traits_type::eq_int_type(ch, traits_type::eof())) {
+        data.push_back(traits_type::to_char_type(ch));
+    }
+    return traits_type::not_eof(ch);
+}
+
+std::streamsize
+OutputBuffer::StringBuf::xsputn(const char* str, std::streamsize n) {
+    data.append(str, n);
+    return n;
+}
+
+void
+OutputBuffer::clear() {
+    buf.data.clear();
+    std::ostream::clear();  // Reset any error flags
+    // Do not hold on to the memory used by an unusually large result.
+    if (buf.data.capacity() > (1 << 20)) {
+        std::string().swap(buf.data);
+    }
+}
+
+OutputBuffer&
+OutputBuffer::forThread() {
+    thread_local Borrowed<OutputBuffer> buffer(bufferPool);
+    buffer.obj->clear();
+    return *buffer.obj;
+}
@@ -0,0 +1,171 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+/*
+ * Copyright (C) Ethan Gutknecht 2021 (gutkneET@miamioh.edu)
+ *
+ * A bump (or arena) allocator for temporary data used while processing a
+ * query, and a reusable output buffer to stage the results of queries.
+ */
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <cstddef>
+#include <iostream>
+
+/**
+ * A simple bump allocator. Memory is allocated by advancing an offset in a
+ * large chunk and is freed all at once by rewinding to an earlier mark.
+ * The chunks are retained and reused, so once an arena has warmed up, it
+ * does not call malloc at all. Each thread has its own arena (see
+ * forThread()) for temporary data needed while processing a query.
+ */
+class Arena {
+public:
+    /** The position in the arena returned by mark() */
+    using Mark = std::pair<size_t, size_t>;
+
+    /**
+     * Creates an empty arena. Chunks are allocated when needed.
+     *
+     * @param chunkSize The size of each chunk. Larger requests get their
+     * own chunk.
+     */
+    explicit Arena(size_t chunkSize = 64 * 1024) : chunkSize(chunkSize) {}
+
+    /**
+     * Allocates memory from the arena. The memory is released when the
+     * arena is rewound to a mark before this allocation.
+     *
+     * @param bytes The number of bytes to allocate.
+     * @param align The alignment needed for the memory.
+     */
+    void* allocate(size_t bytes, size_t align = alignof(std::max_align_t));
+
+    /** Returns the current position, to be passed to rewind() */
+    Mark mark() const { return {current, offset}; }
+
+    /**
+     * Releases all the memory allocated after a given mark. Chunks beyond
+     * the retained limit are freed.
+     *
+     * @param pos A position returned by an earlier call to mark().
+     */
+    void rewind(const Mark& pos);
+
+    /** Returns the total size of the chunks held by this arena */
+    size_t capacity() const;
+
+    /** Returns the arena for temporary data used by the calling thread */
+    static Arena& forThread();
+
+    /**
+     * A convenience class that rewinds the arena (to where it was when this
+     * object was created) when it goes out of scope. Scopes can be nested.
+     */
+    class Scope {
+    public:
+        explicit Scope(Arena& arena = Arena::forThread()) :
+            arena(arena), start(arena.mark()) {}
+        ~Scope() { arena.rewind(start); }
+        Arena& arena;
+    private:
+        const Mark start;
+    };
+
+private:
+    /** Chunks beyond this total size are freed by rewind() */
+    static const size_t MaxRetained = 1 << 20;
+
+    /** The default size of each chunk */
+    const size_t chunkSize;
+
+    /** The chunks, with the size of each chunk */
+    std::vector<std::pair<std::unique_ptr<char[]>, size_t>> chunks;
+
+    /** The index of the chunk currently being used */
+    size_t current = 0;
+
+    /** The offset of the next free byte in the current chunk */
+    size_t offset = 0;
+};
+
+/**
+ * An allocator to have standard containers (such as std::vector) allocate
+ * their memory from an Arena. Deallocation is a no-op, as the memory is
+ * released when the arena is rewound.
+ */
+template <typename T>
+class ArenaAllocator {
+public:
+    using value_type = T;
+
+    explicit ArenaAllocator(Arena& arena = Arena::forThread()) :
+        arena(&arena) {}
+
+    template <typename U>
+    ArenaAllocator(const ArenaAllocator<U>& other) : arena(other.arena) {}
+
+    T* allocate(size_t n) {
+        return static_cast<T*>(arena->allocate(n * sizeof(T), alignof(T)));
+    }
+
+    void deallocate(T*, size_t) {}
+
+    template <typename U>
+    bool operator==(const ArenaAllocator<U>& other) const {
+        return arena == other.arena;
+    }
+
+    template <typename U>
+    bool operator!=(const ArenaAllocator<U>& other) const {
+        return arena != other.arena;
+    }
+
+    /** The arena from where memory is allocated */
+    Arena* arena;
+};
+
+/** Shortcut for a vector whose memory is allocated from an arena */
+template <typename T>
+using ArenaVec = std::vector<T, ArenaAllocator<T>>;
+
+/**
+ * An output stream that writes to a buffer that is reused for each query.
+ * Unlike a std::ostringstream, the memory of the buffer is retained, so
+ * staging results does not call malloc once the buffer has grown to fit
+ * typical results. The data can be written out without making a copy.
+ */
+class OutputBuffer : public std::ostream {
+public:
+    OutputBuffer() : std::ostream(&buf) {}
+
+    /** Returns a pointer to the data written to this buffer */
+    const char* data() const { return buf.data.data(); }
+
+    /** Returns the number of bytes written to this buffer */
+    size_t size() const { return buf.data.size(); }
+
+    /** Discards the data, but keeps the memory, for reuse */
+    void clear();
+
+    /**
+     * Returns the output buffer of the calling thread, after clearing it.
+     * The same buffer must not be used for two queries at the same time.
+     */
+    static OutputBuffer& forThread();
+
+private:
+    /** The stream buffer that appends characters to a string */
+    struct StringBuf : public std::streambuf {
+        int_type overflow(int_type ch) override;
+        std::streamsize xsputn(const char* str, std::streamsize n) override;
+        std::string data;
+    };
+
+    /** The buffer to where data is written */
+    StringBuf buf;
+};
+
+#endif /* ARENA_H */
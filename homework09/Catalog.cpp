@@ -0,0 +1,59 @@
+/*
+ * Copyright (C) Ethan Gutknecht 2021 (gutkneET@miamioh.edu)
+ *
+ * Implementation of the catalog of tables loaded in memory.
+ */
+
+#include "Catalog.h"
+#include "Helper.h"
+
+thread_local const CSV* Catalog::Locked::held = nullptr;
+
+Catalog::Catalog() {
+    maps.emplace_back(new Map());
+    current.store(maps.back().get());
+}
+
+Catalog::Table*
+Catalog::find(const CSV& csv) const {
+    const Map& map = *current.load(std::memory_order_acquire);
+    const auto entry = map.byCSV.find(&csv);
+    return (entry == map.byCSV.end() ? nullptr : entry->second);
+}
+
+Catalog::Table&
+Catalog::of(const CSV& csv) const {
+    Table* const table = find(csv);
+    if (table == nullptr) {
+        throw Exp("Table not found.");
+    }
+    return *table;
+}
+
+Catalog::Table&
+Catalog::add(std::unique_ptr<Table> table) {
+    std::lock_guard<std::mutex> guard(mutex);
+    const Map& latest = *current.load();
+    const auto entry = latest.byName.find(table->name);
+    if (entry != latest.byName.end()) {
+        return *entry->second;
+    }
+    // Readers may be using the latest map. So add the table to a copy and
+    // then have readers switch to the copy.
+    std::unique_ptr<Map> map(new Map(latest));
+    map->byName[table->name] = table.get();
+    map->byCSV[&table->csv]  = table.get();
+    current.store(map.get(), std::memory_order_release);
+    maps.push_back(std::move(map));
+    owned.push_back(std::move(table));
+    return *owned.back();
+}
+
+std::vector<Catalog::Table*>
+Catalog::tables() const {
+    std::vector<Table*> result;
+    for (const auto& entry : current.load(std::memory_order_acquire)->byName) {
+        result.push_back(entry.second);
+    }
+    return result;
+}
@@ -0,0 +1,170 @@
+#ifndef CATALOG_H
+#define CATALOG_H
+
+/*
+ * Copyright (C) Ethan Gutknecht 2021 (gutkneET@miamioh.edu)
+ *
+ * The catalog of tables loaded in memory. Every query looks up its table
+ * in the catalog, so lookups do not use any locks. Instead, the catalog
+ * is a read-only map that is copied (with the new table added) each time
+ * a table is loaded, i.e., read-copy-update. Tables are loaded rarely and
+ * are never removed, so the old copies of the map (that queries may still
+ * be reading) are simply kept until the catalog is destroyed.
+ */
+
+#include <mutex>
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <shared_mutex>
+#include "CSV.h"
+#include "Dictionary.h"
+#include "Transaction.h"
+#include "LazyColumns.h"
+#include "ZoneMap.h"
+#include "TrigramIndex.h"
+#include "WaitList.h"
+#include "TableStats.h"
+
+/** The tables loaded in memory, by name */
+class Catalog {
+public:
+    /** A table loaded in memory, with the data used to access it */
+    struct Table {
+        /** The name of the CSV file or URL */
+        std::string name;
+
+        /** The data in the table */
+        CSV csv;
+
+        /** The dictionary for the encoded columns of the CSV */
+        std::unique_ptr<Dictionary> dict;
+
+        /** The row versions of the CSV, used to validate transactions */
+        std::unique_ptr<TableVersions> versions;
+
+        /**
+         * The fields of the columns that are yet to be loaded, or nullptr
+         * if all the columns were loaded with the table.
+         */
+        std::unique_ptr<LazyColumns> lazy;
+
+        /** The zone maps used to skip blocks of rows in scans */
+        std::unique_ptr<ZoneMap> zones;
+
+        /** The trigram indexes used for like conditions */
+        std::unique_ptr<TrigramIndex> trigrams;
+
+        /** The wait queries waiting for the table to change */
+        std::unique_ptr<WaitList> waiters;
+
+        /** The statistics used to plan queries, once analyzed */
+        std::unique_ptr<TableStats> stats;
+
+        /**
+         * Held (shared) by scans while they access the rows, and held
+         * exclusively by copy into while it appends rows, which may move
+         * the rows in memory, and by statements that change values. When
+         * the CSV's own lock is also needed, this one is taken first (in
+         * address order, for more than one table).
+         */
+        std::shared_timed_mutex rowsMutex;
+    };
+
+    /**
+     * Notes that the calling thread holds the locks on a table (the
+     * exclusive lock on its rows and the lock on its CSV) while it runs a
+     * group of statements in a batch. The statements then do not lock the
+     * table again (see SQLAir::readRows, SQLAir::writeRows, and
+     * SQLAir::lockTable). The table is noted until this object is
+     * destroyed. As the lock on the rows is exclusive, even a group of
+     * selects blocks all other readers of the table while it runs.
+     */
+    class Locked {
+    public:
+        /**
+         * Notes that the calling thread holds the locks on a table.
+         *
+         * @param csv The CSV of the table, whose locks must be held.
+         */
+        explicit Locked(const CSV& csv) { held = &csv; }
+
+        /** Notes that the locks are no longer held */
+        ~Locked() { held = nullptr; }
+
+        /** Returns true if the calling thread holds the locks on a CSV */
+        static bool holds(const CSV& csv) { return held == &csv; }
+
+    private:
+        /** The CSV whose locks are held by each thread, if any */
+        static thread_local const CSV* held;
+    };
+
+    Catalog();
+
+    /**
+     * Returns the table with a given name, or nullptr if the table has not
+     * been loaded. This method does not use any locks.
+     *
+     * @param name The name of the CSV file or URL.
+     */
+    Table* find(const std::string& name) const {
+        const Map& map = *current.load(std::memory_order_acquire);
+        const auto entry = map.byName.find(name);
+        return (entry == map.byName.end() ? nullptr : entry->second);
+    }
+
+    /**
+     * Returns the table for a CSV, or nullptr if the CSV is not in the
+     * catalog (such as the columns of a stream() scan). This method does
+     * not use any locks.
+     *
+     * @param csv The CSV whose table is to be returned.
+     */
+    Table* find(const CSV& csv) const;
+
+    /**
+     * Returns the table for a CSV. This method does not use any locks.
+     *
+     * @param csv A CSV that is in the catalog.
+     *
+     * @exception Exp Thrown if the CSV is not in the catalog.
+     */
+    Table& of(const CSV& csv) const;
+
+    /**
+     * Adds a newly loaded table to the catalog. If another thread added a
+     * table with the same name meanwhile, that table is used instead.
+     *
+     * @param table The table to be added.
+     *
+     * @return The table in the catalog.
+     */
+    Table& add(std::unique_ptr<Table> table);
+
+    /** Returns all the tables in the catalog */
+    std::vector<Table*> tables() const;
+
+private:
+    /** A (read-only) version of the catalog */
+    struct Map {
+        std::unordered_map<std::string, Table*> byName;
+        std::unordered_map<const CSV*, Table*> byCSV;
+    };
+
+    /** The latest version of the catalog */
+    std::atomic<const Map*> current;
+
+    /** All the versions of the catalog, as queries may be using them */
+    std::vector<std::unique_ptr<const Map>> maps;
+
+    /** The tables in the catalog */
+    std::vector<std::unique_ptr<Table>> owned;
+
+    /** The mutex used by threads adding tables to the catalog */
+    std::mutex mutex;
+};
+
+#endif /* CATALOG_H */
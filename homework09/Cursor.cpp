@@ -0,0 +1,44 @@
+/*
+ * Copyright (C) Ethan Gutknecht 2021 (gutkneET@miamioh.edu)
+ *
+ * Implementation of cursors that return the results of a select in pages.
+ */
+
+#include <utility>
+#include "Cursor.h"
+#include "Helper.h"
+
+Cursor::Cursor(const std::string& name, const std::string& table, CSV& csv,
+        const StrVec& colNames, std::unique_ptr<Predicate> where,
+        const ZoneMap* zones, const TrigramIndex* index, uint64_t version) :
+    name(name), csv(csv), colNames(colNames), where(std::move(where)),
+    lastUsed(std::chrono::steady_clock::now()), table(table),
+    numRows(csv.size()), version(version),
+    plan(numRows, this->where.get(), zones, index) {
+    for (const auto& colName : colNames) {
+        colIdxs.push_back(csv.getColumnIndex(colName));
+    }
+}
+
+size_t
+Cursor::next(const TableVersions& versions) {
+    // The zone maps and trigram indexes only grow with changes. So the
+    // rows they skip could not have matched in the snapshot either.
+    for (rowIdx = plan.next(rowIdx); (rowIdx < numRows);
+         rowIdx = plan.next(rowIdx + 1)) {
+        if (versions.row(rowIdx) > version) {
+            throw Exp("Cursor " + name + " is out of date, as " + table +
+                      " changed after it was declared.");
+        }
+        if (where == nullptr || where->eval(csv[rowIdx])) {
+            return rowIdx++;
+        }
+    }
+    return numRows;
+}
+
+bool
+Cursor::atEnd() {
+    rowIdx = plan.next(rowIdx);
+    return rowIdx >= numRows;
+}
@@ -0,0 +1,101 @@
+#ifndef CURSOR_H
+#define CURSOR_H
+
+/*
+ * Copyright (C) Ethan Gutknecht 2021 (gutkneET@miamioh.edu)
+ *
+ * Cursors that return the results of a select in pages, for example:
+ *
+ *     declare c cursor for select * from test.csv where rating > 4
+ *     fetch 100 from c
+ *     close c
+ *
+ * A cursor keeps the position of its scan, so each fetch checks only the
+ * rows after the previous one. The results are those of a snapshot of the
+ * table when the cursor was declared: rows added later are not returned
+ * and, if a row the cursor has yet to check was changed, fetch reports
+ * that the cursor is out of date (rather than mixing old and new data).
+ */
+
+#include <chrono>
+#include <memory>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include "CSV.h"
+#include "Predicate.h"
+#include "ScanPlan.h"
+#include "Transaction.h"
+
+/** A cursor declared by a "declare" statement in a session */
+class Cursor {
+public:
+    /**
+     * Creates a cursor positioned at the first row of a table.
+     *
+     * @param name The name of the cursor.
+     * @param table The name of the table, for error messages.
+     * @param csv The table being scanned.
+     * @param colNames The columns returned (without any "*").
+     * @param where The where clause (bound to the CSV), if any.
+     * @param zones The zone maps (built for the where clause), if any.
+     * @param index The trigram indexes of the CSV, if any.
+     * @param version The version of the table, i.e., of the snapshot.
+     */
+    Cursor(const std::string& name, const std::string& table, CSV& csv,
+        const StrVec& colNames, std::unique_ptr<Predicate> where,
+        const ZoneMap* zones, const TrigramIndex* index, uint64_t version);
+
+    /**
+     * Returns the index of the next row that matches the where clause, or
+     * the number of rows in the snapshot if there are none. The caller
+     * must hold the lock on the CSV.
+     *
+     * @param versions The versions of the rows of the CSV.
+     *
+     * @exception Exp If a row was changed after the cursor was declared.
+     */
+    size_t next(const TableVersions& versions);
+
+    /** Returns true if the cursor has no more rows to check */
+    bool atEnd();
+
+    /** Returns the number of rows in the snapshot */
+    size_t size() const { return numRows; }
+
+    /** The name of the cursor */
+    const std::string name;
+
+    /** The table scanned by the cursor */
+    CSV& csv;
+
+    /** The columns returned by the cursor */
+    const StrVec colNames;
+
+    /** The indexes of the columns in colNames */
+    std::vector<int> colIdxs;
+
+    /** The where clause, if any. It is bound again before each fetch. */
+    const std::unique_ptr<Predicate> where;
+
+    /** The time when the cursor was last used */
+    std::chrono::steady_clock::time_point lastUsed;
+
+private:
+    /** The name of the table, for error messages */
+    const std::string table;
+
+    /** The number of rows in the snapshot */
+    const size_t numRows;
+
+    /** The version of the table in the snapshot */
+    const uint64_t version;
+
+    /** The rows skipped via the zone maps and trigram index */
+    ScanPlan plan;
+
+    /** The index of the next row to be checked */
+    size_t rowIdx = 0;
+};
+
+#endif /* CURSOR_H */
@@ -0,0 +1,148 @@
+/*
+ * Copyright (C) Ethan Gutknecht 2021 (gutkneET@miamioh.edu)
+ *
+ * Implementation of dictionary encoding for low-cardinality columns.
+ */
+
+#include <algorithm>
+#include <unordered_set>
+#include "Dictionary.h"
+#include "ZoneMap.h"
+#include "TrigramIndex.h"
+#include "TableStats.h"
+
+// Definitions for the constants used by reference.
+const uint16_t Dictionary::Raw;
+const size_t Dictionary::MinRows;
+const size_t Dictionary::MinRepeats;
+
+uint16_t
+Dictionary::Column::add(const std::string& val) {
+    std::lock_guard<std::mutex> guard(mutex);
+    const auto entry = lookup.find(val);
+    if (entry != lookup.end()) {
+        return entry->second;
+    }
+    const int code = size.load(std::memory_order_relaxed);
+    if (code >= Raw) {
+        return Raw;  // The dictionary is full.
+    }
+    if (chunks[code >> 8] == nullptr) {
+        chunks[code >> 8].reset(new std::string[256]);
+    }
+    chunks[code >> 8][code & 0xFF] = val;
+    lookup.emplace(val, code);
+    // Publish the value before the code is used by any row.
+    size.store(code + 1, std::memory_order_release);
+    return code;
+}
+
+void
+Dictionary::encode(CSV& csv, bool lazy) {
+    columns.clear();
+    columns.resize(csv.getColumnCount());
+    for (int col = 0; (!lazy && col < csv.getColumnCount()); col++) {
+        encodeColumn(csv, col);
+    }
+}
+
+void
+Dictionary::encodeColumn(CSV& csv, int col) {
+    if (csv.size() < MinRows) {
+        return;  // Small tables are not worth encoding.
+    }
+    // Check if the column has few enough distinct values.
+    const size_t maxValues = std::min<size_t>(Raw, csv.size() / MinRepeats);
+    std::unordered_set<std::string> distinct;
+    for (size_t i = 0; (i < csv.size() && distinct.size() <= maxValues); i++) {
+        distinct.insert(csv[i].at(col));
+    }
+    if (distinct.size() > maxValues) {
+        return;  // Too many distinct values to encode this column.
+    }
+    std::unique_ptr<Column> column(new Column());
+    column->codes.resize(csv.size());
+    for (size_t i = 0; (i < csv.size()); i++) {
+        column->codes[i] = column->add(csv[i].at(col));
+        std::string().swap(csv[i].at(col));  // Release the memory
+    }
+    columns[col] = std::move(column);
+}
+
+void
+Dictionary::append(CSV& csv, size_t firstRow) {
+    for (int col = 0; (col < csv.getColumnCount()); col++) {
+        if (!isEncoded(col)) {
+            encodeColumn(csv, col);
+            continue;
+        }
+        Column& column = *columns[col];
+        column.codes.resize(csv.size());
+        for (size_t i = firstRow; (i < csv.size()); i++) {
+            column.codes[i] = column.add(csv[i].at(col));
+            if (column.codes[i] != Raw) {
+                std::string().swap(csv[i].at(col));  // Release the memory
+            }
+        }
+    }
+}
+
+void
+Dictionary::set(CSVRow& row, size_t rowIdx, int col, const std::string& val) {
+    if (zones != nullptr) {
+        zones->widen(rowIdx, col, val);
+    }
+    if (trigrams != nullptr) {
+        trigrams->add(rowIdx, col, val);
+    }
+    if (stats != nullptr) {
+        stats->changed();
+    }
+    if (!isEncoded(col)) {
+        row.at(col) = val;
+        return;
+    }
+    const uint16_t code = columns[col]->add(val);
+    // Values that do not fit in the dictionary are stored in the row.
+    row.at(col) = (code == Raw ? val : "");
+    columns[col]->codes[rowIdx] = code;
+}
+
+int
+Dictionary::codeOf(int col, const std::string& val) const {
+    std::lock_guard<std::mutex> guard(columns[col]->mutex);
+    const auto entry = columns[col]->lookup.find(val);
+    return (entry != columns[col]->lookup.end() ? entry->second : -1);
+}
+
+size_t
+Dictionary::memoryUsed() const {
+    size_t bytes = 0;
+    for (const auto& column : columns) {
+        if (column == nullptr) {
+            continue;
+        }
+        const int size = column->size.load(std::memory_order_acquire);
+        bytes += column->codes.capacity() * sizeof(uint16_t) +
+            ((size + 255) / 256) * 256 * sizeof(std::string) +
+            size * (sizeof(std::string) + sizeof(uint16_t) + 2 *
+                    sizeof(void*));
+        for (int code = 0; (code < size); code++) {
+            bytes += column->value(code).capacity();
+        }
+    }
+    return bytes;
+}
+
+std::string
+Dictionary::encodedColumns(const CSV& csv) const {
+    const StrVec names = csv.getColumnNames();
+    std::string result, delim;
+    for (size_t col = 0; (col < columns.size()); col++) {
+        if (isEncoded(col)) {
+            result += delim + names.at(col);
+            delim   = ", ";
+        }
+    }
+    return result;
+}
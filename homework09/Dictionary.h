@@ -0,0 +1,217 @@
+#ifndef DICTIONARY_H
+#define DICTIONARY_H
+
+/*
+ * Copyright (C) Ethan Gutknecht 2021 (gutkneET@miamioh.edu)
+ *
+ * Dictionary encoding for columns of a CSV that have only a few distinct
+ * values, for example the country, timezone, and dst columns in
+ * airports.csv.
+ */
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <cstdint>
+#include <unordered_map>
+#include "CSV.h"
+
+class ZoneMap;
+class TrigramIndex;
+class TableStats;
+
+/**
+ * The dictionaries for the low-cardinality columns of a CSV. Each distinct
+ * value of an encoded column is stored once in the dictionary and each row
+ * stores a 16-bit code instead of the string. The strings in the rows of
+ * encoded columns are released, so their values must be accessed via the
+ * get() method. Comparing the codes (rather than strings) makes equality
+ * checks on these columns an integer comparison.
+ *
+ * Rows are identified by their index in the CSV. The codes and the strings
+ * in the rows are not synchronized: set() must be called only while scans
+ * are kept out (by holding the rows lock of the table exclusively). Values
+ * can be added to a dictionary while other threads look up codes.
+ */
+class Dictionary {
+public:
+    /**
+     * The code used for a row whose value is not in the dictionary (because
+     * the dictionary is full). The value of such rows is kept in the row.
+     */
+    static const uint16_t Raw = 0xFFFF;
+
+    /**
+     * Chooses the columns to be encoded and encodes them. A column is
+     * encoded only if each of its distinct values occurs in several rows
+     * on average.
+     *
+     * @param csv The CSV to be encoded. The strings in the encoded columns
+     * are released by this method.
+     * @param lazy If true, no columns are encoded now. Instead, each column
+     * is encoded via encodeColumn() once its values are loaded.
+     */
+    void encode(CSV& csv, bool lazy = false);
+
+    /**
+     * Encodes a column if it has few enough distinct values. The column is
+     * not read or changed by other threads while it is being encoded.
+     *
+     * @param csv The CSV whose column is to be encoded.
+     * @param col The zero-based index of the column.
+     */
+    void encodeColumn(CSV& csv, int col);
+
+    /**
+     * Encodes the values of the rows appended to a CSV (by copy into).
+     * Columns that were not encoded are encoded if they now have few
+     * enough distinct values. The caller must hold the lock on the CSV and
+     * keep scans out, as the codes may be moved in memory.
+     *
+     * @param csv The CSV to which rows were appended.
+     * @param firstRow The index of the first row appended.
+     */
+    void append(CSV& csv, size_t firstRow);
+
+    /**
+     * Checks if a column is dictionary encoded.
+     *
+     * @param col The zero-based index of the column.
+     */
+    bool isEncoded(int col) const {
+        return (col < (int) columns.size()) && (columns[col] != nullptr);
+    }
+
+    /**
+     * Returns the value in a given row and column of the CSV.
+     *
+     * @param row The row whose value is to be returned.
+     * @param rowIdx The index of the row in the CSV.
+     * @param col The zero-based index of the column.
+     */
+    const std::string& get(const CSVRow& row, size_t rowIdx, int col) const {
+        if (!isEncoded(col)) {
+            return row.at(col);
+        }
+        const uint16_t code = columns[col]->codes[rowIdx];
+        return (code == Raw ? row.at(col) : columns[col]->value(code));
+    }
+
+    /**
+     * Changes the value in a given row and column of the CSV. The caller
+     * must keep other threads from reading the row (see above).
+     *
+     * @param row The row to be updated.
+     * @param rowIdx The index of the row in the CSV.
+     * @param col The zero-based index of the column.
+     * @param value The new value for the column.
+     */
+    void set(CSVRow& row, size_t rowIdx, int col, const std::string& value);
+
+    /**
+     * Sets the zone maps of the CSV, which are widened by set() so that
+     * they include every value that is stored.
+     *
+     * @param zoneMap The zone maps of the CSV.
+     */
+    void track(ZoneMap& zoneMap) { zones = &zoneMap; }
+
+    /**
+     * Sets the trigram indexes of the CSV, to which set() adds the values
+     * that are stored.
+     *
+     * @param index The trigram indexes of the CSV.
+     */
+    void track(TrigramIndex& index) { trigrams = &index; }
+
+    /**
+     * Sets the statistics of the CSV, which set() tells of each change so
+     * that they are refreshed once they are out of date.
+     *
+     * @param tableStats The statistics of the CSV.
+     */
+    void track(TableStats& tableStats) { stats = &tableStats; }
+
+    /**
+     * Returns the code for a given row of an encoded column.
+     *
+     * @param rowIdx The index of the row in the CSV.
+     * @param col The zero-based index of an encoded column.
+     */
+    uint16_t code(size_t rowIdx, int col) const {
+        return columns[col]->codes[rowIdx];
+    }
+
+    /**
+     * Returns the code used for a given value in an encoded column.
+     *
+     * @param col The zero-based index of an encoded column.
+     * @param value The value to look up.
+     *
+     * @return The code for the value or -1 if the value is not in the
+     * dictionary.
+     */
+    int codeOf(int col, const std::string& value) const;
+
+    /** Returns the memory (in bytes) used by the dictionaries & codes */
+    size_t memoryUsed() const;
+
+    /** Returns the names of the encoded columns, separated by commas */
+    std::string encodedColumns(const CSV& csv) const;
+
+private:
+    /** Each column needs at least this many rows to be encoded */
+    static const size_t MinRows = 1000;
+
+    /** Each value must occur this many times (on average) to be encoded */
+    static const size_t MinRepeats = 4;
+
+    /** The dictionary & codes for an encoded column */
+    struct Column {
+        /** The code for the value in each row */
+        std::vector<uint16_t> codes;
+
+        /**
+         * The values in the dictionary. Values are stored in chunks (that
+         * are never moved) so values can be added while other threads
+         * are reading existing values.
+         */
+        std::unique_ptr<std::string[]> chunks[256];
+
+        /** The number of values in the dictionary */
+        std::atomic<int> size = {0};
+
+        /** Map to find the code for a value. Guarded by the mutex */
+        std::unordered_map<std::string, uint16_t> lookup;
+
+        /** The mutex to add values to the dictionary */
+        mutable std::mutex mutex;
+
+        /** Returns the value for a given code */
+        const std::string& value(uint16_t code) const {
+            return chunks[code >> 8][code & 0xFF];
+        }
+
+        /**
+         * Returns the code for a value, adding it to the dictionary if
+         * needed. Returns Raw if the dictionary is full.
+         */
+        uint16_t add(const std::string& value);
+    };
+
+    /** The dictionaries for each column (nullptr if not encoded) */
+    std::vector<std::unique_ptr<Column>> columns;
+
+    /** The zone maps of the CSV, if any, see track() */
+    ZoneMap* zones = nullptr;
+
+    /** The trigram indexes of the CSV, if any, see track() */
+    TrigramIndex* trigrams = nullptr;
+
+    /** The statistics of the CSV, if any, see track() */
+    TableStats* stats = nullptr;
+};
+
+#endif /* DICTIONARY_H */
@@ -0,0 +1,230 @@
+/*
+ * Copyright (C) Ethan Gutknecht 2021 (gutkneET@miamioh.edu)
+ *
+ * Implementation of the values (literals and arithmetic expressions) used
+ * in the set clause of update statements.
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include "Expression.h"
+#include "Helper.h"
+
+const std::string Expression::Operators = "+-*/()";
+
+/**
+ * A simple recursive descent parser to convert the tokens of a value into
+ * an expression tree. The grammar is:
+ *
+ *     expr    := term { ("+" | "-") term }
+ *     term    := unary { ("*" | "/") unary }
+ *     unary   := "-" unary | "(" expr ")" | column | number
+ */
+class ExpressionParser {
+public:
+    ExpressionParser(const StrVec& tokens, const std::vector<bool>& bound,
+        const std::function<int(const std::string&)>& resolve) :
+        tokens(tokens), bound(bound), resolve(resolve) {}
+
+    std::shared_ptr<const Expression> parseExpr() {
+        return parseList("+-", &ExpressionParser::parseTerm);
+    }
+
+    /** Returns true if all of the tokens have been consumed */
+    bool done() const { return pos == tokens.size(); }
+
+    /** Set if the expression refers to a column */
+    bool usesColumn = false;
+
+private:
+    // Helper method to parse operands separated by the given operators.
+    std::shared_ptr<const Expression> parseList(const std::string& ops,
+            std::shared_ptr<const Expression> (ExpressionParser::*next)()) {
+        std::shared_ptr<const Expression> node = (this->*next)();
+        while (peek().size() == 1 && ops.find(peek()) != std::string::npos) {
+            const char op = tokens[pos++][0];
+            node = binary(op, node, (this->*next)());
+        }
+        return node;
+    }
+
+    std::shared_ptr<const Expression> parseTerm() {
+        return parseList("*/", &ExpressionParser::parseUnary);
+    }
+
+    std::shared_ptr<const Expression> parseUnary() {
+        if (pos < tokens.size() && bound[pos]) {
+            return number(tokens[pos++]);  // A bound value is not a column.
+        }
+        if (peek() == "-") {
+            pos++;
+            // Negation is represented as 0 - value.
+            return binary('-', number("0"), parseUnary());
+        }
+        if (peek() == "(") {
+            pos++;
+            std::shared_ptr<const Expression> node = parseExpr();
+            if (peek() != ")") {
+                throw Exp("Missing ')' in set clause.");
+            }
+            pos++;
+            return node;
+        }
+        if (pos >= tokens.size()) {
+            throw Exp("Incomplete expression in set clause.");
+        }
+        const std::string& token = tokens[pos++];
+        const int col = resolve(token);
+        if (col != -1) {
+            std::shared_ptr<Expression> node(new Expression());
+            node->col  = col;
+            usesColumn = true;
+            return node;
+        }
+        return number(token);
+    }
+
+    // Helper method to create a node for a number.
+    std::shared_ptr<const Expression> number(const std::string& token) {
+        std::shared_ptr<Expression> node(new Expression());
+        char *end = nullptr;
+        node->num   = std::strtod(token.c_str(), &end);
+        node->value = token;
+        if (token.empty() || *end != '\0') {
+            throw Exp("Invalid value '" + token + "' in set clause.");
+        }
+        return node;
+    }
+
+    // Helper method to create a node for an operator.
+    std::shared_ptr<const Expression> binary(char op,
+            std::shared_ptr<const Expression> left,
+            std::shared_ptr<const Expression> right) {
+        std::shared_ptr<Expression> node(new Expression());
+        node->op    = op;
+        node->left  = std::move(left);
+        node->right = std::move(right);
+        return node;
+    }
+
+    // Returns the next token, unless it is a bound value (which is never
+    // an operator or a parenthesis).
+    const std::string& peek() const {
+        static const std::string NoToken;
+        return (pos < tokens.size() && !bound[pos] ? tokens[pos] : NoToken);
+    }
+
+    const StrVec& tokens;
+    const std::vector<bool>& bound;
+    const std::function<int(const std::string&)>& resolve;
+    size_t pos = 0;
+};
+
+Expression
+Expression::parse(const StrVec& sql, int startIdx, int endIdx,
+        const std::function<int(const std::string&)>& resolve,
+        const std::function<bool(int)>& isValue) {
+    if (startIdx >= endIdx) {
+        throw Exp("Missing value in set clause.");
+    }
+    const bool single = (endIdx - startIdx == 1);
+    if (single && isValue && isValue(startIdx)) {
+        return literal(sql[startIdx]);
+    }
+    // Operators (other than parentheses) are not special characters for
+    // the tokenizer. So split them into separate tokens. Bound values are
+    // not split.
+    StrVec tokens;
+    std::vector<bool> bound;
+    for (int i = startIdx; (i < endIdx); i++) {
+        if (isValue && isValue(i)) {
+            tokens.push_back(sql[i]);
+            bound.resize(tokens.size(), false);
+            bound.back() = true;
+            continue;
+        }
+        std::string operand;
+        for (const char c : sql[i]) {
+            if (Operators.find(c) == std::string::npos) {
+                operand.push_back(c);
+                continue;
+            }
+            if (!operand.empty()) {
+                tokens.push_back(operand);
+                operand.clear();
+            }
+            tokens.push_back(std::string(1, c));
+        }
+        if (!operand.empty()) {
+            tokens.push_back(operand);
+        }
+    }
+    bound.resize(tokens.size(), false);
+    ExpressionParser parser(tokens, bound, resolve);
+    try {
+        std::shared_ptr<const Expression> root = parser.parseExpr();
+        if (!parser.done()) {
+            throw Exp("Unexpected tokens in set clause.");
+        }
+        // A single token that is not an arithmetic expression using a
+        // column (for example "-1", "2021-06-01", or a column name) is a
+        // literal value.
+        if (!single || (parser.usesColumn && tokens.size() > 1)) {
+            return *root;
+        }
+    } catch (const Exp&) {
+        if (!single) {
+            throw;
+        }
+    }
+    return literal(sql[startIdx]);
+}
+
+Expression
+Expression::literal(const std::string& value) {
+    Expression expr;
+    expr.value = value;
+    return expr;
+}
+
+void
+Expression::eval(const std::function<const std::string&(int)>& getValue,
+        std::string& result) const {
+    if (isLiteral()) {
+        result = value;
+        return;
+    }
+    // Format numbers with enough digits, but without trailing zeros.
+    char buf[32];
+    std::snprintf(buf, sizeof(buf), "%.15g", compute(getValue));
+    result = buf;
+}
+
+double
+Expression::compute(
+        const std::function<const std::string&(int)>& getValue) const {
+    if (op == 0 && col == -1) {
+        return num;
+    }
+    if (op == 0) {
+        const std::string& colVal = getValue(col);
+        char *end = nullptr;
+        const double val = std::strtod(colVal.c_str(), &end);
+        if (colVal.empty() || *end != '\0') {
+            throw Exp("Non-numeric value '" + colVal + "' in set clause.");
+        }
+        return val;
+    }
+    const double lhs = left->compute(getValue), rhs = right->compute(getValue);
+    switch (op) {
+    case '+': return lhs + rhs;
+    case '-': return lhs - rhs;
+    case '*': return lhs * rhs;
+    default:
+        break;
+    }
+    if (rhs == 0) {
+        throw Exp("Division by zero in set clause.");
+    }
+    return lhs / rhs;
+}
@@ -0,0 +1,96 @@
+#ifndef EXPRESSION_H
+#define EXPRESSION_H
+
+/*
+ * Copyright (C) Ethan Gutknecht 2021 (gutkneET@miamioh.edu)
+ *
+ * The values in the set clause of an update statement. A value is either a
+ * literal or an arithmetic expression that refers to columns of the row
+ * being updated, for example:
+ *
+ *     update test.csv set raters = raters + 1, rating = rating * 2 ...
+ */
+
+#include <string>
+#include <memory>
+#include <functional>
+#include "CSV.h"
+
+/**
+ * A value in a set clause. Arithmetic expressions use +, -, *, / (with
+ * the usual precedence) and parentheses over numbers and numeric columns.
+ */
+class Expression {
+public:
+    /**
+     * The characters used as operators in arithmetic expressions, which
+     * the tokenizer does not split on (except for parentheses).
+     */
+    static const std::string Operators;
+
+    /**
+     * Compiles the tokens of a value in a set clause. A single token that
+     * does not refer to a column is used as a literal value, as before.
+     *
+     * @param sql The tokens of the query produced by CSV::tokenize method.
+     * @param startIdx The index of the first token of the value.
+     * @param endIdx The index just past the last token of the value.
+     * @param resolve The function to convert a column name to its index
+     * in the CSV. It returns -1 if the name is not a column.
+     * @param isValue The function that returns true if a token (given its
+     * index in sql) is a value bound to a parameter, which is used as a
+     * literal (or as a number in an arithmetic expression) as is. If not
+     * set, no tokens are bound values.
+     */
+    static Expression parse(const StrVec& sql, int startIdx, int endIdx,
+        const std::function<int(const std::string&)>& resolve,
+        const std::function<bool(int)>& isValue = nullptr);
+
+    /**
+     * Creates a literal value.
+     *
+     * @param value The value to be set.
+     */
+    static Expression literal(const std::string& value);
+
+    /**
+     * Computes the value for a row.
+     *
+     * @param getValue The function that returns the current value of a
+     * column in the row, given the zero-based index of the column.
+     * @param result The string to where the value is written. Reusing the
+     * same string for each row avoids allocating memory.
+     */
+    void eval(const std::function<const std::string&(int)>& getValue,
+        std::string& result) const;
+
+    /** Returns true if this value does not depend on the row */
+    bool isLiteral() const { return op == 0 && col == -1; }
+
+private:
+    Expression() {}
+
+    /** Computes the numeric value of this (sub) expression for a row */
+    double compute(
+        const std::function<const std::string&(int)>& getValue) const;
+
+    /** The operator (+, -, *, /) or 0 for a number, column, or literal */
+    char op = 0;
+
+    /** The zero-based index of the column, or -1 if this is not a column */
+    int col = -1;
+
+    /** The literal value. For numbers, the value is also in num */
+    std::string value;
+
+    /** The numeric value of a literal */
+    double num = 0;
+
+    /** The operands of an operator */
+    std::shared_ptr<const Expression> left, right;
+
+    // The recursive descent parser is implemented by this class.
+    friend class ExpressionParser;
+};
+
+#endif /* EXPRESSION_H */
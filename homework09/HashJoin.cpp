@@ -0,0 +1,109 @@
+/*
+ * Copyright (C) Ethan Gutknecht 2021 (gutkneET@miamioh.edu)
+ *
+ * Implementation of the build/probe hash join used by SQLAir.
+ */
+
+#include <future>
+#include <sstream>
+#include <algorithm>
+#include "HashJoin.h"
+
+/** Below this many probe rows a join is not worth splitting into threads */
+const size_t MinRowsPerPartition = 4096;
+
+void
+HashJoin::plan(bool buildLeft, const RowFilter& leftFilter,
+        const RowFilter& rightFilter) {
+    this->buildLeft = buildLeft;
+    filters[0] = leftFilter;
+    filters[1] = rightFilter;
+}
+
+int
+HashJoin::run(const StrVec& header, const std::vector<JoinCol>& outCols,
+        const JoinFilter& filter, std::ostream& os, int maxThr) {
+    // Build the hash table on the chosen table, with the rows that pass
+    // its filter.
+    const CSV& build = (buildLeft ? left : right);
+    const int buildKey = (buildLeft ? leftKey : rightKey);
+    const Dictionary& buildDict = (buildLeft ? leftDict : rightDict);
+    const RowFilter& buildFilter = filters[buildLeft ? 0 : 1];
+    std::unordered_map<std::string, std::vector<int>> table;
+    table.reserve(buildFilter ? 0 : build.size());
+    for (size_t i = 0; (i < build.size()); i++) {
+        if (!buildFilter || buildFilter(i)) {
+            table[buildDict.get(build[i], i, buildKey)].push_back(i);
+        }
+    }
+
+    // Split the probe-side table into contiguous partitions, one per thread.
+    const size_t probeRows = (buildLeft ? right.size() : left.size());
+    const size_t numParts = std::max<size_t>(1, std::min<size_t>(
+            std::max(maxThr, 1), probeRows / MinRowsPerPartition));
+    const size_t partSize = (probeRows + numParts - 1) / numParts;
+    std::vector<std::future<std::pair<int, std::string>>> parts;
+    for (size_t start = 0; (start < probeRows); start += partSize) {
+        const size_t end = std::min(start + partSize, probeRows);
+        parts.push_back(std::async(std::launch::async, [&, start, end]() {
+            std::ostringstream out;
+            const int rows = probe(table, buildLeft, outCols, filter,
+                                   start, end, out);
+            return std::make_pair(rows, out.str());
+        }));
+    }
+
+    // Stream each partition out, in order, as soon as it is done.
+    int numRows = 0;
+    for (auto& part : parts) {
+        const auto result = part.get();
+        if (result.first > 0 && numRows == 0) {
+            os << header << std::endl;
+        }
+        os << result.second;
+        numRows += result.first;
+    }
+    return numRows;
+}
+
+int
+HashJoin::probe(const std::unordered_map<std::string, std::vector<int>>& table,
+        bool buildLeft, const std::vector<JoinCol>& outCols,
+        const JoinFilter& filter, size_t start, size_t end,
+        std::ostream& os) const {
+    const CSV& probeCSV = (buildLeft ? right : left);
+    const CSV& buildCSV = (buildLeft ? left : right);
+    const int probeKey  = (buildLeft ? rightKey : leftKey);
+    const Dictionary& probeDict = (buildLeft ? rightDict : leftDict);
+    const RowFilter& probeFilter = filters[buildLeft ? 1 : 0];
+    int numRows = 0;
+    for (size_t i = start; (i < end); i++) {
+        if (probeFilter && !probeFilter(i)) {
+            continue;  // Not joined due to a condition on this table
+        }
+        const auto entry = table.find(probeDict.get(probeCSV[i], i, probeKey));
+        if (entry == table.end()) {
+            continue;  // No matching rows for this key
+        }
+        for (const int buildRow : entry->second) {
+            // Get the rows in the order they were specified in the query.
+            const CSVRow& lRow = (buildLeft ? buildCSV[buildRow] : probeCSV[i]);
+            const CSVRow& rRow = (buildLeft ? probeCSV[i] : buildCSV[buildRow]);
+            const size_t lIdx  = (buildLeft ? buildRow : i);
+            const size_t rIdx  = (buildLeft ? i : buildRow);
+            if (filter && !filter(lRow, rRow)) {
+                continue;
+            }
+            std::string delim = "";
+            for (const auto& col : outCols) {
+                os << delim << (col.first == 0 ?
+                    leftDict.get(lRow, lIdx, col.second) :
+                    rightDict.get(rRow, rIdx, col.second));
+                delim = "\t";
+            }
+            os << '\n';
+            numRows++;
+        }
+    }
+    return numRows;
+}
@@ -0,0 +1,141 @@
+#ifndef HASH_JOIN_H
+#define HASH_JOIN_H
+
+/*
+ * Copyright (C) Ethan Gutknecht 2021 (gutkneET@miamioh.edu)
+ *
+ * A build/probe hash join between two in-memory CSV tables. This class is
+ * used by SQLAir to process queries of the form:
+ *
+ *     select title, rating from movies.csv join ratings.csv
+ *         on movieid = movieid;
+ */
+
+#include <string>
+#include <vector>
+#include <utility>
+#include <unordered_map>
+#include <thread>
+#include <functional>
+#include <iostream>
+#include "CSV.h"
+#include "Dictionary.h"
+
+/**
+ * A column in the output of a join. The first value indicates the table
+ * (0 for the left/first table and 1 for the right/second table) and the
+ * second value is the zero-based index of the column in that table.
+ */
+using JoinCol = std::pair<int, int>;
+
+/**
+ * An optional filter that is applied to each pair of joined rows. The
+ * first parameter is always the row from the left table and the second one
+ * is the row from the right table.
+ */
+using JoinFilter = std::function<bool(const CSVRow&, const CSVRow&)>;
+
+/**
+ * A filter on the rows of one table in a join, with the conditions of the
+ * where clause that use only that table. The parameter is the index of the
+ * row in its table.
+ */
+using RowFilter = std::function<bool(size_t)>;
+
+/**
+ * A simple hash join. The hash table is built on the smaller of the two
+ * tables, unless the planner chooses the side (see plan()). The other
+ * table is then split into contiguous partitions that are probed in
+ * parallel by separate threads. Each partition is written to
+ * the output stream (in order) as soon as it is done, so the rows are
+ * streamed out while the other partitions are still being probed.
+ */
+class HashJoin {
+public:
+    /**
+     * The constructor merely saves the information about the two tables
+     * to be joined. The actual join is performed by the run() method.
+     *
+     * @param left The first table specified in the query.
+     * @param leftKey The index of the join column in the left table.
+     * @param right The second table specified in the query.
+     * @param rightKey The index of the join column in the right table.
+     * @param leftDict The dictionary used to get values from the left table.
+     * @param rightDict The dictionary used to get values from the right
+     * table.
+     */
+    HashJoin(const CSV& left, int leftKey, const CSV& right, int rightKey,
+             const Dictionary& leftDict, const Dictionary& rightDict) :
+        left(left), leftKey(leftKey), right(right), rightKey(rightKey),
+        leftDict(leftDict), rightDict(rightDict),
+        buildLeft(left.size() <= right.size()) {}
+
+    /**
+     * Sets the side on which the hash table is built and the filters on
+     * the rows of each table. Rows that do not pass the filter of their
+     * table are neither added to the hash table nor probed.
+     *
+     * @param buildLeft True to build the hash table on the left table.
+     * @param leftFilter The filter on the rows of the left table, if any.
+     * @param rightFilter The filter on the rows of the right table, if any.
+     */
+    void plan(bool buildLeft, const RowFilter& leftFilter,
+              const RowFilter& rightFilter);
+
+    /**
+     * Performs the join and prints the selected columns for each pair of
+     * matching rows. The column names (separated by tabs) are printed before
+     * the first row, consistent with a regular select statement.
+     *
+     * @param header The column names to be printed as the header.
+     * @param outCols The columns to be printed for each joined row.
+     * @param filter An optional filter (from a 'where' clause) that must be
+     * satisfied by a joined row for it to be printed.
+     * @param os The output stream to where the rows are to be written.
+     * @param maxThr The maximum number of threads to be used for probing.
+     *
+     * @return The number of joined rows written to the output stream.
+     */
+    int run(const StrVec& header, const std::vector<JoinCol>& outCols,
+            const JoinFilter& filter, std::ostream& os,
+            int maxThr = std::thread::hardware_concurrency());
+
+private:
+    /**
+     * Helper method called from a separate thread to probe a range of rows
+     * in the probe-side table and print the matching rows.
+     *
+     * @param table The hash table built on the build-side table.
+     * @param buildLeft Flag to indicate if the left table was the build side.
+     * @param outCols The columns to be printed for each joined row.
+     * @param filter An optional filter to be applied to joined rows.
+     * @param start The first row (in the probe table) to be probed.
+     * @param end The row after the last row to be probed.
+     * @param os The output stream to where the joined rows are written.
+     *
+     * @return The number of joined rows written.
+     */
+    int probe(const std::unordered_map<std::string, std::vector<int>>& table,
+            bool buildLeft, const std::vector<JoinCol>& outCols,
+            const JoinFilter& filter, size_t start, size_t end,
+            std::ostream& os) const;
+
+    /** The first (or left) table in the join */
+    const CSV& left;
+    /** The index of the join column in the left table */
+    const int leftKey;
+    /** The second (or right) table in the join */
+    const CSV& right;
+    /** The index of the join column in the right table */
+    const int rightKey;
+    /** The dictionary for the encoded columns in the left table */
+    const Dictionary& leftDict;
+    /** The dictionary for the encoded columns in the right table */
+    const Dictionary& rightDict;
+    /** True if the hash table is built on the left table */
+    bool buildLeft;
+    /** The filters on the rows of the left and right tables, if any */
+    RowFilter filters[2];
+};
+
+#endif /* HASH_JOIN_H */
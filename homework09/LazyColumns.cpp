@@ -0,0 +1,127 @@
+/*
+ * Copyright (C) Ethan Gutknecht 2021 (gutkneET@miamioh.edu)
+ *
+ * Implementation of lazy loading of the columns of a CSV file.
+ */
+
+#include <cstring>
+#include <sstream>
+#include "LazyColumns.h"
+#include "Helper.h"
+
+void
+LazyColumns::load(std::istream& is, CSV& csv) {
+    is.seekg(0, std::ios::end);
+    const std::streamoff size = is.tellg();
+    if (!is.good() || size < 0) {
+        throw Exp("The supplied stream was not good.");
+    }
+    if (size >= UINT32_MAX) {
+        throw Exp("The CSV is too large to be loaded lazily. Unset "
+                  "SQLAIR_LAZY_COLUMNS to load it.");
+    }
+    data.resize(size);
+    is.seekg(0);
+    is.read(&data[0], size);
+    // The CSV gets the column names from the header line.
+    const size_t headerEnd = std::min(data.find('\n'), data.size());
+    std::istringstream header(data.substr(0, headerEnd) + "\n");
+    csv.load(header);
+    numCols = numPending = csv.getColumnCount();
+    loaded.reset(new std::atomic<bool>[numCols]());
+    // Record the fields of each (non-empty) line. Each row gets empty
+    // strings for its values, which do not allocate any memory.
+    for (size_t begin = headerEnd + 1; (begin < data.size());) {
+        size_t end = std::min(data.find('\n', begin), data.size());
+        const size_t next = end + 1;
+        if (end > begin && data[end - 1] == '\r') {
+            end--;
+        }
+        if (end > begin) {
+            split(begin, end);
+            csv.emplace_back();
+            csv.back().resize(numCols);
+        }
+        begin = next;
+    }
+}
+
+void
+LazyColumns::split(uint32_t begin, uint32_t end) {
+    offsets.push_back(begin);
+    int fields = 1;
+    bool quoted = false;
+    for (uint32_t i = begin; (i < end); i++) {
+        if (data[i] == '"') {
+            quoted = !quoted;  // A doubled quote toggles this twice.
+        } else if (data[i] == ',' && !quoted) {
+            offsets.push_back(i + 1);
+            if (++fields > numCols) {
+                break;  // Extra fields are ignored.
+            }
+        }
+    }
+    // The end of the line ends the last field. Missing fields are empty.
+    while ((fields++ <= numCols)) {
+        offsets.push_back(end + 1);
+    }
+}
+
+void
+LazyColumns::field(size_t row, int col, std::string& value) const {
+    const uint32_t* const off = &offsets[row * (numCols + 1) + col];
+    if (off[1] <= off[0]) {
+        value.clear();  // A missing field.
+        return;
+    }
+    unquote(data.data() + off[0], off[1] - 1 - off[0], value);
+}
+
+void
+LazyColumns::unquote(const char* str, size_t len, std::string& value) {
+    if (std::memchr(str, '"', len) == nullptr) {
+        value.assign(str, len);
+        return;
+    }
+    // Remove the quotes around (parts of) the value. Within quotes, a
+    // doubled quote is a quote in the value.
+    value.clear();
+    bool quoted = false;
+    for (size_t i = 0; (i < len); i++) {
+        if (str[i] != '"') {
+            value += str[i];
+        } else if (quoted && i + 1 < len && str[i + 1] == '"') {
+            value += '"';
+            i++;
+        } else {
+            quoted = !quoted;
+        }
+    }
+}
+
+void
+LazyColumns::loadColumn(CSV& csv, Dictionary& dict, int col) {
+    if (isLoaded(col)) {
+        return;
+    }
+    std::lock_guard<std::mutex> guard(mutex);
+    if (isLoaded(col)) {
+        return;  // Another thread loaded the column meanwhile.
+    }
+    for (size_t row = 0; (row < csv.size()); row++) {
+        field(row, col, csv[row][col]);
+    }
+    dict.encodeColumn(csv, col);
+    loaded[col].store(true, std::memory_order_release);
+    if (--numPending == 0) {
+        // All the values are in the rows now. So free the file.
+        std::string().swap(data);
+        std::vector<uint32_t>().swap(offsets);
+    }
+}
+
+size_t
+LazyColumns::memoryUsed() const {
+    std::lock_guard<std::mutex> guard(mutex);
+    return data.capacity() + offsets.capacity() * sizeof(uint32_t);
+}
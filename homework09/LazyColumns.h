@@ -0,0 +1,113 @@
+#ifndef LAZY_COLUMNS_H
+#define LAZY_COLUMNS_H
+
+/*
+ * Copyright (C) Ethan Gutknecht 2021 (gutkneET@miamioh.edu)
+ *
+ * Lazy loading of the columns of a CSV file. Instead of splitting every
+ * line into strings up front, only the offsets of the fields in the file
+ * are recorded when it is loaded. The values of a column are copied into
+ * the rows (and the column is dictionary encoded, if it is worth it) when
+ * a query first uses the column. So loading a table with many columns
+ * costs in proportion to the columns that are actually queried. This mode
+ * is enabled by setting the SQLAIR_LAZY_COLUMNS environment variable.
+ */
+
+#include <mutex>
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <iostream>
+#include "CSV.h"
+#include "Dictionary.h"
+
+/** The fields of a CSV file whose columns are loaded on first use */
+class LazyColumns {
+public:
+    /**
+     * Reads a CSV file and records the offsets of its fields. The CSV gets
+     * its columns and a row (with empty values) for each line.
+     *
+     * @param is The stream from where the CSV data is read.
+     * @param csv The (empty) CSV into which the data is to be loaded.
+     *
+     * @exception Exp Thrown if the stream could not be read.
+     */
+    void load(std::istream& is, CSV& csv);
+
+    /**
+     * Checks if a column has been copied into the rows.
+     *
+     * @param col The zero-based index of the column.
+     */
+    bool isLoaded(int col) const {
+        return loaded[col].load(std::memory_order_acquire);
+    }
+
+    /**
+     * Copies the values of a column into the rows of the CSV and encodes
+     * the column (if it has few distinct values), unless this was already
+     * done. Other threads may be reading other columns of the CSV.
+     *
+     * @param csv The CSV that was loaded by load().
+     * @param dict The dictionary for the encoded columns of the CSV.
+     * @param col The zero-based index of the column.
+     */
+    void loadColumn(CSV& csv, Dictionary& dict, int col);
+
+    /** Returns the memory (in bytes) used by the file and the offsets */
+    size_t memoryUsed() const;
+
+    /**
+     * Returns the value of a field in a CSV file, without the quotes around
+     * (parts of) it. Within quotes, a doubled quote is a quote in the value.
+     *
+     * @param str The first character of the field.
+     * @param len The number of characters in the field.
+     * @param value The string to which the value is assigned.
+     */
+    static void unquote(const char* str, size_t len, std::string& value);
+
+private:
+    /**
+     * Records the offsets of the fields in a line of the file.
+     *
+     * @param begin The offset of the first character of the line.
+     * @param end The offset just past the last character of the line.
+     */
+    void split(uint32_t begin, uint32_t end);
+
+    /**
+     * Returns the value of a field, without quotes.
+     *
+     * @param row The index of the row.
+     * @param col The zero-based index of the column.
+     * @param value The string to which the value is assigned.
+     */
+    void field(size_t row, int col, std::string& value) const;
+
+    /** The contents of the file, until all the columns are loaded */
+    std::string data;
+
+    /**
+     * The offset where each field starts (numCols + 1 per row). A field
+     * ends just before the delimiter preceding the start of the next one.
+     */
+    std::vector<uint32_t> offsets;
+
+    /** The number of columns in the CSV */
+    int numCols = 0;
+
+    /** The number of columns still to be loaded */
+    int numPending = 0;
+
+    /** Flags to indicate the columns that have been loaded */
+    std::unique_ptr<std::atomic<bool>[]> loaded;
+
+    /** The mutex used to load columns */
+    mutable std::mutex mutex;
+};
+
+#endif /* LAZY_COLUMNS_H */
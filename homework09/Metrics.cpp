@@ -0,0 +1,256 @@
+/*
+ * Copyright (C) Ethan Gutknecht 2021 (gutkneET@miamioh.edu)
+ *
+ * Implementation of the metrics reported by the SQLAir web-server.
+ */
+
+#include <cmath>
+#include <algorithm>
+#include "Metrics.h"
+
+// Single-writer increment. Only the owning thread updates a shard, so an
+// atomic read-modify-write (with its bus lock) is not needed.
+template <typename T>
+void bump(std::atomic<T>& counter, T value) {
+    counter.store(counter.load(std::memory_order_relaxed) + value,
+                  std::memory_order_relaxed);
+}
+
+//-------------------------[  LatencyHistogram  ]--------------------------
+
+int
+LatencyHistogram::bucketOf(uint64_t value) {
+    if (value < (1u << SubBits)) {
+        return value;  // Small values have a bucket each.
+    }
+    int msb = 63;
+    while ((value >> msb) == 0) {
+        msb--;
+    }
+    const int shift = msb - (SubBits - 1);
+    return (shift + 1) * HalfCount + (int) (value >> shift) - HalfCount;
+}
+
+uint64_t
+LatencyHistogram::highestValueIn(int bucket) {
+    if (bucket < (1 << SubBits)) {
+        return bucket;
+    }
+    const int shift = bucket / HalfCount - 1;
+    const uint64_t sub = bucket % HalfCount + HalfCount;
+    return ((sub + 1) << shift) - 1;
+}
+
+void
+LatencyHistogram::record(uint64_t micros) {
+    bump(counts[bucketOf(micros)], uint64_t(1));
+    bump(sum, micros);
+}
+
+void
+LatencyHistogram::addTo(std::vector<uint64_t>& merged, uint64_t& total) const {
+    for (int i = 0; (i < NumBuckets); i++) {
+        merged[i] += counts[i].load(std::memory_order_relaxed);
+    }
+    total += sum.load(std::memory_order_relaxed);
+}
+
+uint64_t
+LatencyHistogram::valueAt(const std::vector<uint64_t>& counts,
+        double quantile) {
+    uint64_t total = 0;
+    for (const auto count : counts) {
+        total += count;
+    }
+    // The rank (1-based) of the value at the given quantile.
+    const uint64_t rank = std::max<uint64_t>(1, std::ceil(quantile * total));
+    uint64_t seen = 0;
+    for (int i = 0; (i < NumBuckets); i++) {
+        seen += counts[i];
+        if (seen >= rank) {
+            return highestValueIn(i);
+        }
+    }
+    return 0;
+}
+
+//-----------------------------[  Metrics  ]-------------------------------
+
+/**
+ * The shard used by a thread. When the thread finishes, the destructor
+ * returns the shard to the registry so another thread can reuse it.
+ */
+class ShardHandle {
+public:
+    ~ShardHandle() { release(); }
+
+    void release() {
+        if (registry != nullptr) {
+            std::lock_guard<std::mutex> guard(registry->mutex);
+            registry->freeShards.push_back(shard);
+        }
+        registry = nullptr;
+        shard    = nullptr;
+    }
+
+    std::shared_ptr<Metrics::Registry> registry;
+    Metrics::Shard* shard = nullptr;
+};
+
+/** The shard of each thread */
+thread_local ShardHandle threadShard;
+
+Metrics::Metrics() : registry(std::make_shared<Registry>()) {
+}
+
+Metrics::Shard&
+Metrics::shard() {
+    if (threadShard.registry == registry) {
+        return *threadShard.shard;  // The common case.
+    }
+    threadShard.release();
+    std::lock_guard<std::mutex> guard(registry->mutex);
+    if (registry->freeShards.empty()) {
+        registry->shards.emplace_back(new Shard());
+        registry->freeShards.push_back(registry->shards.back().get());
+    }
+    threadShard.registry = registry;
+    threadShard.shard    = registry->freeShards.back();
+    registry->freeShards.pop_back();
+    return *threadShard.shard;
+}
+
+void
+Metrics::add(Counter counter, long value) {
+    bump(shard().counters[counter], value);
+}
+
+void
+Metrics::request(int type, bool ok, uint64_t micros) {
+    Shard& myShard = shard();
+    bump(myShard.requests[type], 1L);
+    if (!ok) {
+        bump(myShard.errors[type], 1L);
+    }
+    myShard.latency[type].record(micros);
+}
+
+void
+Metrics::lockWait(const CSV& csv, double seconds) {
+    Shard& myShard = shard();
+    std::lock_guard<std::mutex> guard(myShard.lockWaitMutex);
+    myShard.lockWaits[&csv] += seconds;
+}
+
+size_t
+Metrics::memoryUsed(const CSV& csv) {
+    size_t bytes = sizeof(CSV) + csv.capacity() * sizeof(CSVRow);
+    for (const auto& row : csv) {
+        bytes += row.capacity() * sizeof(std::string);
+        for (const auto& val : row) {
+            // Short strings are stored inside the string object itself.
+            const char* data = val.data();
+            const char* obj  = reinterpret_cast<const char*>(&val);
+            if (data < obj || data >= obj + sizeof(val)) {
+                bytes += val.capacity() + 1;
+            }
+        }
+    }
+    return bytes;
+}
+
+// Helper method to escape a label value in the Prometheus text format.
+std::string escapeLabel(const std::string& value) {
+    std::string escaped;
+    for (const char c : value) {
+        if (c == '\\' || c == '"') {
+            escaped += '\\';
+        }
+        escaped += (c == '\n' ? std::string("\\n") : std::string(1, c));
+    }
+    return escaped;
+}
+
+void
+Metrics::print(std::ostream& os,
+        const std::vector<TableMetrics>& tables) {
+    // Combine the values from all the shards.
+    long counters[NumCounters] = {}, requests[NumTypes] = {},
+         errors[NumTypes] = {};
+    std::vector<std::vector<uint64_t>> latency(NumTypes,
+        std::vector<uint64_t>(LatencyHistogram::NumBuckets));
+    uint64_t latencySum[NumTypes] = {};
+    std::unordered_map<const CSV*, double> lockWaits;
+    {
+        std::lock_guard<std::mutex> guard(registry->mutex);
+        for (const auto& shard : registry->shards) {
+            for (int i = 0; (i < NumCounters); i++) {
+                counters[i] += shard->counters[i].load();
+            }
+            for (int i = 0; (i < NumTypes); i++) {
+                requests[i] += shard->requests[i].load();
+                errors[i]   += shard->errors[i].load();
+                shard->latency[i].addTo(latency[i], latencySum[i]);
+            }
+            std::lock_guard<std::mutex> waitGuard(shard->lockWaitMutex);
+            for (const auto& entry : shard->lockWaits) {
+                lockWaits[entry.first] += entry.second;
+            }
+        }
+    }
+
+    os << "# HELP sqlair_requests_total Statements processed.\n"
+       << "# TYPE sqlair_requests_total counter\n";
+    for (int i = 0; (i < NumTypes); i++) {
+        os << "sqlair_requests_total{type=\"" << StatementTypes[i] << "\"} "
+           << requests[i] << '\n';
+    }
+    os << "# HELP sqlair_request_errors_total Statements that failed.\n"
+       << "# TYPE sqlair_request_errors_total counter\n";
+    for (int i = 0; (i < NumTypes); i++) {
+        os << "sqlair_request_errors_total{type=\"" << StatementTypes[i]
+           << "\"} " << errors[i] << '\n';
+    }
+    os << "# HELP sqlair_request_latency_seconds Statement latency.\n"
+       << "# TYPE sqlair_request_latency_seconds summary\n";
+    for (int i = 0; (i < NumTypes); i++) {
+        if (requests[i] == 0) {
+            continue;  // Quantiles of an empty histogram are undefined.
+        }
+        const std::string name = "sqlair_request_latency_seconds";
+        const std::string type = "{type=\"" + StatementTypes[i] + "\"";
+        for (const std::string q : {"0.5", "0.99", "0.999"}) {
+            os << name << type << ",quantile=\"" << q << "\"} "
+               << LatencyHistogram::valueAt(latency[i], std::stod(q)) / 1e6
+               << '\n';
+        }
+        os << name << "_sum" << type << "} " << latencySum[i] / 1e6 << '\n'
+           << name << "_count" << type << "} " << requests[i] << '\n';
+    }
+
+    // The server-wide counters & gauges in the same order as Counter.
+    const StrVec names = {"connections_active", "connections_queued",
+        "bytes_received_total", "bytes_sent_total", "table_cache_hits_total",
+        "table_cache_misses_total", "result_cache_hits_total",
+        "result_cache_misses_total", "requests_rejected_total"};
+    for (int i = 0; (i < NumCounters); i++) {
+        const bool gauge = (i == ConnActive || i == ConnQueued);
+        os << "# TYPE sqlair_" << names[i] << (gauge ? " gauge" : " counter")
+           << "\nsqlair_" << names[i] << ' ' << counters[i] << '\n';
+    }
+
+    // Per-table metrics.
+    os << "# HELP sqlair_lock_wait_seconds_total Time waiting for locks.\n"
+       << "# TYPE sqlair_lock_wait_seconds_total counter\n";
+    for (const auto& table : tables) {
+        os << "sqlair_lock_wait_seconds_total{table=\""
+           << escapeLabel(table.name) << "\"} " << lockWaits[table.csv]
+           << '\n';
+    }
+    os << "# HELP sqlair_table_memory_bytes Estimated memory used by data.\n"
+       << "# TYPE sqlair_table_memory_bytes gauge\n";
+    for (const auto& table : tables) {
+        os << "sqlair_table_memory_bytes{table=\"" << escapeLabel(table.name)
+           << "\"} " << table.bytes << '\n';
+    }
+}
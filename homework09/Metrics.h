@@ -0,0 +1,208 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+/*
+ * Copyright (C) Ethan Gutknecht 2021 (gutkneET@miamioh.edu)
+ *
+ * Server metrics that are reported in Prometheus text format by the
+ * "/metrics" endpoint of the SQLAir web-server.
+ */
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <unordered_map>
+#include <iostream>
+#include "CSV.h"
+
+/** The statement types for which requests and latencies are tracked */
+const StrVec StatementTypes = {"select", "update", "insert", "delete", "use",
+    "save", "exit", "join", "explain", "begin", "commit", "rollback",
+    "describe", "create", "copy", "declare", "fetch", "close", "analyze",
+    "other"};
+
+/** A table loaded in memory whose metrics are reported */
+struct TableMetrics {
+    /** The name of the CSV file or URL */
+    std::string name;
+    /** The data in the table (used only as a key, it is not read) */
+    const CSV* csv;
+    /** Memory used by the table, including dictionaries & indexes */
+    size_t bytes;
+};
+
+/**
+ * A log-linear histogram (similar to an HDR histogram) of latencies in
+ * microseconds. Each power of 2 is split into 16 equal sub-buckets, so
+ * recorded values are within about 6% of their actual value. A histogram
+ * is only updated by one thread, but can be read by other threads.
+ */
+class LatencyHistogram {
+public:
+    /** The number of bits used to select sub-buckets */
+    static const int SubBits = 5;
+    /** The number of sub-buckets in each power of 2 */
+    static const int HalfCount = 1 << (SubBits - 1);
+    /** The total number of buckets needed for 64-bit values */
+    static const int NumBuckets = (64 - SubBits + 2) * HalfCount;
+
+    /**
+     * Records a value in this histogram. Only the thread that owns this
+     * histogram may call this method.
+     *
+     * @param micros The value to be recorded.
+     */
+    void record(uint64_t micros);
+
+    /**
+     * Adds the counts in this histogram to a given merged histogram.
+     *
+     * @param counts The counts of the merged histogram. The vector must
+     * have NumBuckets entries.
+     * @param sum The sum of recorded values is added to this variable.
+     */
+    void addTo(std::vector<uint64_t>& counts, uint64_t& sum) const;
+
+    /**
+     * Returns the value at a given quantile of a merged histogram.
+     *
+     * @param counts The counts of the merged histogram.
+     * @param quantile The quantile (between 0 and 1) to be returned.
+     *
+     * @return The largest value in the bucket containing the quantile.
+     */
+    static uint64_t valueAt(const std::vector<uint64_t>& counts,
+        double quantile);
+
+    /** Returns the bucket in which a given value is recorded */
+    static int bucketOf(uint64_t value);
+
+    /** Returns the largest value recorded in a given bucket */
+    static uint64_t highestValueIn(int bucket);
+
+private:
+    /** The number of values recorded in each bucket */
+    std::atomic<uint64_t> counts[NumBuckets] = {};
+    /** The sum of values recorded in this histogram */
+    std::atomic<uint64_t> sum = {0};
+};
+
+/**
+ * The metrics collected by the SQLAir server. To avoid contention between
+ * threads, each thread records its values in a separate shard that only it
+ * updates. The shards are combined when the metrics are printed. Shards of
+ * threads that finish are reused by new threads, so their values are
+ * retained.
+ */
+class Metrics {
+public:
+    /** The different server-wide counters and gauges */
+    enum Counter { ConnActive, ConnQueued, BytesIn, BytesOut, CacheHits,
+                   CacheMisses, ResultHits, ResultMisses, Rejected,
+                   NumCounters };
+
+    /** The number of entries in StatementTypes */
+    static const int NumTypes = 20;
+
+    /** Creates metrics with no shards */
+    Metrics();
+
+    /**
+     * Adds a value to one of the counters or gauges.
+     *
+     * @param counter The counter to be updated.
+     * @param value The value to be added (negative for gauges).
+     */
+    void add(Counter counter, long value = 1);
+
+    /**
+     * Records the processing of a statement.
+     *
+     * @param type The index of the statement type in StatementTypes.
+     * @param ok Flag to indicate if the statement was successful.
+     * @param micros The time (in microseconds) to process the statement.
+     */
+    void request(int type, bool ok, uint64_t micros);
+
+    /**
+     * Adds the time spent waiting for the lock of a CSV. The CSV objects
+     * are mapped to their names only when the metrics are printed.
+     *
+     * @param csv The CSV whose lock the thread waited for.
+     * @param seconds The time spent waiting.
+     */
+    void lockWait(const CSV& csv, double seconds);
+
+    /**
+     * Prints the combined metrics from all the shards in Prometheus text
+     * format.
+     *
+     * @param os The output stream to where the metrics are written.
+     * @param tables The tables currently loaded in memory. These are used to
+     * report lock wait times and memory used per table.
+     */
+    void print(std::ostream& os,
+        const std::vector<TableMetrics>& tables);
+
+    /**
+     * Estimates the memory (in bytes) used by the data in a CSV.
+     *
+     * @param csv The CSV whose memory usage is to be estimated.
+     */
+    static size_t memoryUsed(const CSV& csv);
+
+    /**
+     * A convenience class to record the time spent waiting for the lock
+     * of a CSV in its scope.
+     */
+    class LockTimer {
+    public:
+        LockTimer(Metrics& metrics, const CSV& csv) : metrics(metrics),
+            csv(csv), start(std::chrono::steady_clock::now()) {}
+        ~LockTimer() {
+            const std::chrono::duration<double> elapsed =
+                std::chrono::steady_clock::now() - start;
+            metrics.lockWait(csv, elapsed.count());
+        }
+    private:
+        Metrics& metrics;
+        const CSV& csv;
+        const std::chrono::steady_clock::time_point start;
+    };
+
+private:
+    /** The values recorded by one thread */
+    struct Shard {
+        std::atomic<long> counters[NumCounters] = {};
+        std::atomic<long> requests[NumTypes] = {}, errors[NumTypes] = {};
+        LatencyHistogram latency[NumTypes];
+        // The lock is only contended when the metrics are printed.
+        std::mutex lockWaitMutex;
+        std::unordered_map<const CSV*, double> lockWaits;
+    };
+
+    /** The shards of all the threads and the ones available for reuse */
+    struct Registry {
+        std::mutex mutex;
+        std::vector<std::unique_ptr<Shard>> shards;
+        std::vector<Shard*> freeShards;
+    };
+
+    /** Returns the shard for the calling thread, creating it if needed */
+    Shard& shard();
+
+    /**
+     * The registry is shared with the threads, so that a thread can return
+     * its shard even if it finishes after this object is destroyed.
+     */
+    std::shared_ptr<Registry> registry;
+
+    // The class that returns the shard of a thread when the thread ends.
+    friend class ShardHandle;
+};
+
+#endif /* METRICS_H */
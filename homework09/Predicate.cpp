@@ -0,0 +1,386 @@
+/*
+ * Copyright (C) Ethan Gutknecht 2021 (gutkneET@miamioh.edu)
+ *
+ * Implementation of the predicate tree used for where clauses.
+ */
+
+#include <cstdlib>
+#include <algorithm>
+#include "Predicate.h"
+#include "Helper.h"
+#include "Arena.h"
+
+/** The comparison operators that can be used in a where clause */
+const StrVec Conditions = {"=", "<>", "!=", "<", ">", "<=", ">=", "like"};
+
+/** Strings used for parentheses that were split from a single token */
+const std::string OpenParen = "(", CloseParen = ")", NoToken;
+
+/** The tokens in a where clause. These point to the strings in the query */
+using TokenList = ArenaVec<const std::string*>;
+
+/**
+ * A simple recursive descent parser to convert tokens in a where clause
+ * into a predicate tree. The grammar is:
+ *
+ *     or      := and { "or" and }
+ *     and     := unary { "and" unary }
+ *     unary   := "not" unary | "(" or ")" | col cond value
+ */
+class PredicateParser {
+public:
+    PredicateParser(const TokenList& tokens, const ColResolver& resolve) :
+        tokens(tokens), resolve(resolve) {}
+
+    std::unique_ptr<Predicate> parseOr() {
+        return parseList(Predicate::Or, "or", &PredicateParser::parseAnd);
+    }
+
+    /** Returns true if all of the tokens have been consumed */
+    bool done() const { return pos == tokens.size(); }
+
+private:
+    // Helper method to parse a list of nodes separated by a keyword.
+    std::unique_ptr<Predicate> parseList(Predicate::Kind kind,
+            const std::string& keyword,
+            std::unique_ptr<Predicate> (PredicateParser::*parseNext)()) {
+        std::unique_ptr<Predicate> first = (this->*parseNext)();
+        if (peek() != keyword) {
+            return first;
+        }
+        std::unique_ptr<Predicate> node(new Predicate(kind));
+        node->children.push_back(std::move(first));
+        while (peek() == keyword) {
+            pos++;
+            node->children.push_back((this->*parseNext)());
+        }
+        return node;
+    }
+
+    std::unique_ptr<Predicate> parseAnd() {
+        return parseList(Predicate::And, "and", &PredicateParser::parseUnary);
+    }
+
+    std::unique_ptr<Predicate> parseUnary() {
+        if (peek() == "not") {
+            pos++;
+            std::unique_ptr<Predicate> node(new Predicate(Predicate::Not));
+            node->children.push_back(parseUnary());
+            return node;
+        }
+        if (peek() == "(") {
+            pos++;
+            std::unique_ptr<Predicate> node = parseOr();
+            if (next() != ")") {
+                throw Exp("Missing ')' in where clause.");
+            }
+            return node;
+        }
+        // Must be a simple comparison of the form: col cond value
+        const std::string &col = next(), &cond = next(), &value = next();
+        if (Helper::find(Conditions, cond) == -1) {
+            throw Exp("Invalid condition '" + cond + "' in where clause.");
+        }
+        std::unique_ptr<Predicate> node = Predicate::compare(-1, cond, value);
+        node->col     = resolve(col);
+        node->colName = col;
+        return node;
+    }
+
+    const std::string& peek() const {
+        return (pos < tokens.size() ? *tokens[pos] : NoToken);
+    }
+
+    const std::string& next() {
+        if (pos >= tokens.size()) {
+            throw Exp("Incomplete where clause.");
+        }
+        return *tokens[pos++];
+    }
+
+    const TokenList& tokens;
+    const ColResolver& resolve;
+    size_t pos = 0;
+};
+
+std::unique_ptr<Predicate>
+Predicate::parse(const StrVec& sql, int startIdx, int endIdx,
+        const ColResolver& resolve, const std::function<bool(int)>& isValue) {
+    // The tokenizer combines consecutive special characters into a single
+    // token, e.g., "((". So we split parentheses into separate tokens.
+    // The list is only needed while parsing, so it is placed in the arena.
+    Arena::Scope scope;
+    TokenList tokens{ArenaAllocator<const std::string*>(scope.arena)};
+    tokens.reserve(endIdx - startIdx);
+    for (int i = startIdx; (i < endIdx); i++) {
+        if (!sql[i].empty() && !(isValue && isValue(i)) &&
+            sql[i].find_first_not_of("()") == std::string::npos) {
+            for (const char c : sql[i]) {
+                tokens.push_back(c == '(' ? &OpenParen : &CloseParen);
+            }
+        } else {
+            tokens.push_back(&sql[i]);
+        }
+    }
+    if (tokens.empty()) {
+        throw Exp("Empty where clause.");
+    }
+    PredicateParser parser(tokens, resolve);
+    std::unique_ptr<Predicate> root = parser.parseOr();
+    if (!parser.done()) {
+        throw Exp("Unexpected tokens at the end of where clause.");
+    }
+    root->optimize();
+    return root;
+}
+
+std::unique_ptr<Predicate>
+Predicate::compare(int colIdx, const std::string& cond,
+        const std::string& value) {
+    std::unique_ptr<Predicate> node(new Predicate(Compare));
+    node->col   = {0, colIdx};
+    node->cond  = (cond == "!=" ? "<>" : cond);
+    node->value = value;
+    // Check and convert the value to a number for range comparisons.
+    char *end = nullptr;
+    node->num   = std::strtod(value.c_str(), &end);
+    node->isNum = !value.empty() && (*end == '\0');
+    node->optimize();
+    return node;
+}
+
+void
+Predicate::optimize() {
+    if (kind == Compare) {
+        // Estimates without any statistics: equality is most selective,
+        // numeric ranges are a bit more expensive, and like (a substring
+        // search) is the most expensive.
+        if (cond == "=") {
+            sel = 0.1;
+            cst = 1;
+        } else if (cond == "<>") {
+            sel = 0.9;
+            cst = 1;
+        } else if (cond == "like") {
+            sel = 0.25;
+            cst = 4 + value.size() / 4.0;
+        } else {
+            sel = 1.0 / 3;
+            cst = (isNum ? 2 : 1.5);
+        }
+        return;
+    }
+    for (auto& child : children) {
+        child->optimize();
+    }
+    combine();
+}
+
+void
+Predicate::combine() {
+    if (kind == Not) {
+        sel = 1 - children.front()->sel;
+        cst = children.front()->cst;
+        return;
+    }
+    // Order children by the expected cost of reaching a decision. For "and"
+    // a child that is false ends evaluation, for "or" a child that is true.
+    const bool isAnd = (kind == And);
+    auto rank = [isAnd](const std::unique_ptr<Predicate>& p) {
+        const double stop = (isAnd ? 1 - p->sel : p->sel);
+        return p->cst / std::max(stop, 1e-6);
+    };
+    std::stable_sort(children.begin(), children.end(),
+        [&rank](const std::unique_ptr<Predicate>& p1,
+                const std::unique_ptr<Predicate>& p2) {
+            return rank(p1) < rank(p2);
+        });
+    // Estimate the cost (with short-circuiting) & selectivity of this node.
+    double reach = 1;
+    sel = (isAnd ? 1 : 0);
+    cst = 0;
+    for (const auto& child : children) {
+        cst   += reach * child->cst;
+        reach *= (isAnd ? child->sel : 1 - child->sel);
+        sel    = (isAnd ? sel * child->sel : 1 - (1 - sel) * (1 - child->sel));
+    }
+}
+
+void
+Predicate::useStats(const SelEstimator& estimate) {
+    if (kind == Compare) {
+        const double estimated = estimate(*this);
+        sel = (estimated >= 0 ? estimated : sel);
+        return;
+    }
+    for (auto& child : children) {
+        child->useStats(estimate);
+    }
+    combine();
+}
+
+int
+Predicate::tables() const {
+    if (kind == Compare) {
+        return 1 << col.first;
+    }
+    int used = 0;
+    for (const auto& child : children) {
+        used |= child->tables();
+    }
+    return used;
+}
+
+std::unique_ptr<Predicate>
+Predicate::extract(std::unique_ptr<Predicate>& where, int tbl) {
+    if (where == nullptr) {
+        return nullptr;
+    } else if (where->tables() == (1 << tbl)) {
+        return std::move(where);
+    } else if (where->kind != And) {
+        return nullptr;
+    }
+    std::unique_ptr<Predicate> taken(new Predicate(And));
+    auto& children = where->children;
+    for (auto child = children.begin(); (child != children.end());) {
+        if ((*child)->tables() == (1 << tbl)) {
+            taken->children.push_back(std::move(*child));
+            child = children.erase(child);
+        } else {
+            child++;
+        }
+    }
+    // An and node with a single condition is replaced by the condition.
+    if (children.size() == 1) {
+        where = std::move(children.front());
+    } else {
+        where->combine();
+    }
+    if (taken->children.size() <= 1) {
+        return (taken->children.empty() ? nullptr :
+                std::move(taken->children.front()));
+    }
+    taken->combine();
+    return taken;
+}
+
+std::string
+Predicate::toString() const {
+    if (kind == Compare) {
+        const std::string name = (colName.empty() ?
+            "#" + std::to_string(col.second) : colName);
+        return name + " " + cond + " '" + value + "'";
+    } else if (kind == Not) {
+        return "not " + children.front()->toString();
+    }
+    std::string str, delim;
+    for (const auto& child : children) {
+        str  += delim + child->toString();
+        delim = (kind == And ? " and " : " or ");
+    }
+    return "(" + str + ")";
+}
+
+int
+Predicate::compareTo(const std::string& colVal) const {
+    if (isNum) {
+        char *end = nullptr;
+        const double colNum = std::strtod(colVal.c_str(), &end);
+        if (!colVal.empty() && *end == '\0') {
+            return (colNum < num ? -1 : (colNum > num ? 1 : 0));
+        }
+    }
+    return colVal.compare(value);
+}
+
+void
+Predicate::bind(int tbl, const CSV& csv, const Dictionary& dictionary) const {
+    for (const auto& child : children) {
+        child->bind(tbl, csv, dictionary);
+    }
+    if (kind == Compare && col.first == tbl) {
+        const bool encoded = dictionary.isEncoded(col.second);
+        table = &csv;
+        dict  = (encoded ? &dictionary : nullptr);
+        code  = (encoded ? dictionary.codeOf(col.second, value) : -1);
+    }
+}
+
+bool
+Predicate::eval(const CSVRow& row, const CSVRow& other) const {
+    switch (kind) {
+    case And:
+        for (const auto& child : children) {
+            if (!child->eval(row, other)) {
+                return false;
+            }
+        }
+        return true;
+    case Or:
+        for (const auto& child : children) {
+            if (child->eval(row, other)) {
+                return true;
+            }
+        }
+        return false;
+    case Not:
+        return !children.front()->eval(row, other);
+    default:
+        break;
+    }
+    // Comparisons have the same semantics as SQLAirBase::matches, with
+    // additional support for range comparisons.
+    const CSVRow& colRow = (col.first == 0 ? row : other);
+    if (dict != nullptr) {
+        // Encoded column. Use the code for equality checks when possible.
+        const size_t rowIdx = &colRow - table->data();
+        const uint16_t rowCode = dict->code(rowIdx, col.second);
+        if (rowCode != Dictionary::Raw && (cond == "=" || cond == "<>")) {
+            return (rowCode == code) == (cond == "=");
+        }
+        return compareValue(dict->get(colRow, rowIdx, col.second));
+    }
+    return compareValue(colRow.at(col.second));
+}
+
+bool
+Predicate::eval(const std::function<const std::string&(int)>& getValue) const {
+    switch (kind) {
+    case And:
+        for (const auto& child : children) {
+            if (!child->eval(getValue)) {
+                return false;
+            }
+        }
+        return true;
+    case Or:
+        for (const auto& child : children) {
+            if (child->eval(getValue)) {
+                return true;
+            }
+        }
+        return false;
+    case Not:
+        return !children.front()->eval(getValue);
+    default:
+        return compareValue(getValue(col.second));
+    }
+}
+
+bool
+Predicate::compareValue(const std::string& colVal) const {
+    if (cond == "=") {
+        return colVal == value;
+    } else if (cond == "<>") {
+        return colVal != value;
+    } else if (cond == "like") {
+        return colVal.find(value) != std::string::npos;
+    } else if (cond == "<") {
+        return compareTo(colVal) < 0;
+    } else if (cond == ">") {
+        return compareTo(colVal) > 0;
+    } else if (cond == "<=") {
+        return compareTo(colVal) <= 0;
+    }
+    return compareTo(colVal) >= 0;
+}
@@ -0,0 +1,271 @@
+#ifndef PREDICATE_H
+#define PREDICATE_H
+
+/*
+ * Copyright (C) Ethan Gutknecht 2021 (gutkneET@miamioh.edu)
+ *
+ * A predicate tree that is compiled from the 'where' clause of a query.
+ * The where clause can combine conditions with and, or, not, and
+ * parentheses, for example:
+ *
+ *     where (year = 2006 or year > 2015) and not title like 'The'
+ */
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <utility>
+#include <functional>
+#include "CSV.h"
+#include "Dictionary.h"
+
+/**
+ * Function that is used to map a column name in a where clause to the
+ * table (0 or 1, for joins) and the zero-based index of the column in that
+ * table. The function must throw an exception if the column is invalid.
+ */
+using ColResolver = std::function<std::pair<int, int>(const std::string&)>;
+
+class Predicate;
+
+/**
+ * Function that is used to estimate the selectivity of a comparison from
+ * the statistics of its table (see TableStats.h). The function returns a
+ * negative value if there are no statistics for the comparison.
+ */
+using SelEstimator = std::function<double(const Predicate&)>;
+
+/**
+ * A node in a predicate tree. A node is either a comparison (such as
+ * "year = 2006") or a logical operation (and, or, not) on its child nodes.
+ *
+ * After parsing, the children of each and/or node are reordered so that
+ * cheap and selective conditions are checked first. Combined with
+ * short-circuit evaluation this minimizes the work done for each row.
+ */
+class Predicate {
+public:
+    /** The different types of nodes in the predicate tree */
+    enum Kind { And, Or, Not, Compare };
+
+    /**
+     * Compiles the tokens of a where clause into a predicate tree.
+     *
+     * @param sql The tokens of the query produced by CSV::tokenize method.
+     * @param startIdx Index of the first token after the "where" keyword.
+     * @param endIdx Index of the token after the last token in the clause.
+     * @param resolve The function used to map column names to columns.
+     * @param isValue The function that returns true if a token (given its
+     * index in sql) is a value bound to a parameter, which is used as is
+     * (e.g., a value "(" is not a parenthesis). If not set, no tokens are
+     * bound values.
+     *
+     * @return The root of the predicate tree.
+     *
+     * @exception Exp This method throws an exception if the clause is
+     * not valid.
+     */
+    static std::unique_ptr<Predicate> parse(const StrVec& sql, int startIdx,
+        int endIdx, const ColResolver& resolve,
+        const std::function<bool(int)>& isValue = nullptr);
+
+    /**
+     * Creates a simple comparison predicate. This is a convenience method
+     * to create a predicate from the 3 values returned by the
+     * Helper::getWhereClause method.
+     *
+     * @param colIdx The index of the column to be checked.
+     * @param cond The condition, e.g., "=", "<>", "like", or "<".
+     * @param value The value to be compared against.
+     */
+    static std::unique_ptr<Predicate> compare(int colIdx,
+        const std::string& cond, const std::string& value);
+
+    /**
+     * Checks if a row satisfies this predicate.
+     *
+     * @param row The row to be checked.
+     * @param other The row from the second table (only used for joins). For
+     * regular queries the same row is passed for both parameters.
+     *
+     * @return This method returns true if the condition is met.
+     */
+    bool eval(const CSVRow& row, const CSVRow& other) const;
+
+    /**
+     * Convenience method to check if a single row satisfies this predicate.
+     *
+     * @param row The row to be checked.
+     *
+     * @return This method returns true if the condition is met.
+     */
+    bool eval(const CSVRow& row) const { return eval(row, row); }
+
+    /**
+     * Evaluates this predicate on a row of a single table, using a function
+     * to obtain the values of columns. This is used for rows whose values
+     * are not (yet) stored in the CSV, such as rows changed by a
+     * transaction. Dictionary codes are not used by this method.
+     *
+     * @param getValue The function that returns the value of a column,
+     * given the zero-based index of the column.
+     */
+    bool eval(const std::function<const std::string&(int)>& getValue) const;
+
+    /**
+     * Prepares the comparisons on a table to use the dictionary (if any)
+     * of the table. Equality checks on encoded columns then compare codes
+     * instead of strings. This method must be called before the rows of
+     * the table are evaluated and again if the dictionary could have
+     * changed (for example, when re-checking rows for a wait query).
+     *
+     * @param tbl The table (0 or 1, for joins) being bound.
+     * @param csv The CSV with the rows that will be evaluated.
+     * @param dict The dictionary for the CSV.
+     */
+    void bind(int tbl, const CSV& csv, const Dictionary& dict) const;
+
+    /**
+     * Estimates the selectivity of the comparisons in the tree using the
+     * statistics of their tables, and then reorders the children of and/or
+     * nodes based on the new estimates.
+     *
+     * @param estimate The function that estimates the selectivity of a
+     * comparison. Comparisons without statistics keep their estimates.
+     */
+    void useStats(const SelEstimator& estimate);
+
+    /**
+     * Returns the tables used by the comparisons in the tree, as a bit
+     * mask (bit 0 for the left/first table and bit 1 for the right one).
+     */
+    int tables() const;
+
+    /**
+     * Removes the conditions that use only one table from a where clause
+     * of a join, so that they can be checked on the rows of that table
+     * before they are joined. The conditions are the whole where clause or
+     * the ones and-ed in it.
+     *
+     * @param where The where clause, which is set to nullptr if all of it
+     * is removed.
+     * @param tbl The table (0 or 1) whose conditions are removed.
+     *
+     * @return The conditions removed (and-ed together) or nullptr if none.
+     */
+    static std::unique_ptr<Predicate> extract(
+        std::unique_ptr<Predicate>& where, int tbl);
+
+    /**
+     * The estimated fraction of rows that satisfy this predicate. The
+     * estimate is based on the type of conditions in the tree, or on the
+     * statistics of the tables (see useStats()).
+     */
+    double selectivity() const { return sel; }
+
+    /**
+     * The estimated relative cost of evaluating this predicate on a row.
+     */
+    double cost() const { return cst; }
+
+    /**
+     * Returns a human-readable version of this predicate, with explicit
+     * parentheses and in the order in which conditions are evaluated. This
+     * method is used to print the plan for explain queries.
+     */
+    std::string toString() const;
+
+    /** The type of this node */
+    Kind kind;
+
+    /** The table (for joins) and index of the column for comparisons */
+    std::pair<int, int> col = {0, -1};
+
+    /** The column name from the where clause (if any) for comparisons */
+    std::string colName;
+
+    /** The condition (e.g., "=" or "like") for comparisons */
+    std::string cond;
+
+    /** The value to compare against for comparisons */
+    std::string value;
+
+    /** The child nodes for and, or, and not nodes */
+    std::vector<std::unique_ptr<Predicate>> children;
+
+private:
+    /**
+     * The constructor is private. Use the parse() or compare() methods to
+     * create predicates.
+     *
+     * @param kind The type of node being created.
+     */
+    explicit Predicate(Kind kind) : kind(kind) {}
+
+    /**
+     * Helper method to estimate the selectivity and cost of this node and
+     * reorder the children of and/or nodes. And nodes check the conditions
+     * most likely to fail first while or nodes check the conditions most
+     * likely to succeed first, both weighted by cost.
+     */
+    void optimize();
+
+    /**
+     * Helper method to estimate the selectivity and cost of an and/or/not
+     * node from the estimates of its children (reordering the children of
+     * and/or nodes).
+     */
+    void combine();
+
+    /**
+     * Helper method to compare the numeric values of a column with the
+     * value in this node. Non-numeric values are compared as strings.
+     *
+     * @param colVal The value in the column.
+     *
+     * @return A negative, zero, or positive value if colVal is less than,
+     * equal to, or greater than the value in this node.
+     */
+    int compareTo(const std::string& colVal) const;
+
+    /**
+     * Helper method to check the condition in this node on a value.
+     *
+     * @param colVal The value in the column.
+     *
+     * @return This method returns true if the condition is met.
+     */
+    bool compareValue(const std::string& colVal) const;
+
+    /** Flag to indicate the value in this node is a number */
+    bool isNum = false;
+
+    /** The numeric value in this node, if isNum is true */
+    double num = 0;
+
+    /** The estimated selectivity of this node */
+    double sel = 1;
+
+    /** The estimated cost of this node */
+    double cst = 0;
+
+    /** The CSV whose rows are being evaluated, set by bind() */
+    mutable const CSV* table = nullptr;
+
+    /** The dictionary of an encoded column, set by bind() */
+    mutable const Dictionary* dict = nullptr;
+
+    /** The dictionary code for the value in this node, set by bind() */
+    mutable int code = -1;
+
+    // The recursive descent parser is implemented by this class.
+    friend class PredicateParser;
+
+    // Zone maps check comparisons with numbers to skip blocks of rows.
+    friend class ZoneMap;
+
+    // Statistics estimate the selectivity of comparisons.
+    friend class TableStats;
+};
+
+#endif /* PREDICATE_H */
@@ -0,0 +1,79 @@
+/*
+ * Copyright (C) Ethan Gutknecht 2021 (gutkneET@miamioh.edu)
+ *
+ * Implementation of the statistics collected for explain queries.
+ */
+
+#include <time.h>
+#include <iomanip>
+#include <algorithm>
+#include "QueryStats.h"
+
+thread_local QueryStats* QueryStats::currentStats = nullptr;
+
+/** The names of the phases, in the order they are listed in Phase */
+const StrVec PhaseNames = {"tokenize", "load", "lock wait", "scan", "format"};
+
+QueryStats::QueryStats(bool analyze) : analyze(analyze), prev(currentStats) {
+    currentStats = this;
+}
+
+QueryStats::~QueryStats() {
+    currentStats = prev;
+}
+
+double
+QueryStats::cpuTime() {
+    timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return ts.tv_sec * 1e3 + ts.tv_nsec / 1e6;
+}
+
+QueryStats::Timer::Timer(Phase phase) : stats(currentStats), phase(phase) {
+    if (stats != nullptr) {
+        wallStart = std::chrono::steady_clock::now();
+        cpuStart  = cpuTime();
+    }
+}
+
+QueryStats::Timer::~Timer() {
+    if (stats != nullptr) {
+        const std::chrono::duration<double, std::milli> elapsed =
+            std::chrono::steady_clock::now() - wallStart;
+        stats->wall[phase] += elapsed.count();
+        stats->cpu[phase]  += cpuTime() - cpuStart;
+    }
+}
+
+void
+QueryStats::print(std::ostream& os) const {
+    os << "Plan:\n";
+    for (const auto& step : plan) {
+        os << "  " << step << '\n';
+    }
+    if (!analyze) {
+        return;
+    }
+    os << "Rows scanned: " << rowsScanned << '\n'
+       << "Rows emitted: " << rowsEmitted << '\n'
+       << "Bytes produced: " << bytes << '\n';
+    // The rows are formatted while scanning. So report the scan time
+    // without the formatting time.
+    double phaseWall[NumPhases], phaseCPU[NumPhases], totWall = 0, totCPU = 0;
+    for (int i = 0; (i < NumPhases); i++) {
+        const bool nested = (i == Scan);
+        phaseWall[i] = std::max(0.0, wall[i] - (nested ? wall[Format] : 0));
+        phaseCPU[i]  = std::max(0.0, cpu[i]  - (nested ? cpu[Format]  : 0));
+        totWall     += phaseWall[i];
+        totCPU      += phaseCPU[i];
+    }
+    os << std::left << std::setw(12) << "Phase" << std::right
+       << std::setw(12) << "Wall (ms)" << std::setw(12) << "CPU (ms)\n"
+       << std::fixed << std::setprecision(3);
+    for (int i = 0; (i <= NumPhases); i++) {
+        os << std::left << std::setw(12)
+           << (i < NumPhases ? PhaseNames[i] : "total") << std::right
+           << std::setw(12) << (i < NumPhases ? phaseWall[i] : totWall)
+           << std::setw(11) << (i < NumPhases ? phaseCPU[i] : totCPU) << '\n';
+    }
+}
@@ -0,0 +1,120 @@
+#ifndef QUERY_STATS_H
+#define QUERY_STATS_H
+
+/*
+ * Copyright (C) Ethan Gutknecht 2021 (gutkneET@miamioh.edu)
+ *
+ * Statistics collected while processing "explain" and "explain analyze"
+ * queries, for example:
+ *
+ *     explain analyze select title from test.csv where year = 2006;
+ */
+
+#include <string>
+#include <chrono>
+#include <iostream>
+#include "CSV.h"
+
+/**
+ * The plan and per-phase timings of a single query. Creating a QueryStats
+ * object makes it the current statistics for the calling thread, so the
+ * query processing methods can record information (via current()) without
+ * having to pass it around. When no explain query is running, current()
+ * is nullptr and the Timer objects below do not read any clocks.
+ */
+class QueryStats {
+public:
+    /** The different phases of processing a query */
+    enum Phase { Tokenize, Load, LockWait, Scan, Format, NumPhases };
+
+    /**
+     * Creates statistics for a query and makes it the current statistics
+     * for the calling thread.
+     *
+     * @param analyze If true the query is run. Otherwise only the plan
+     * for the query is reported.
+     */
+    explicit QueryStats(bool analyze);
+
+    /** Restores the previous statistics (if any) for the calling thread */
+    ~QueryStats();
+
+    /**
+     * Returns the statistics being collected by the calling thread.
+     *
+     * @return The current statistics or nullptr if an explain query is not
+     * being processed.
+     */
+    static QueryStats* current() { return currentStats; }
+
+    /**
+     * Convenience method to check if the calling thread is processing an
+     * explain query that should not actually be run.
+     */
+    static bool planOnly() {
+        return (currentStats != nullptr) && !currentStats->analyze;
+    }
+
+    /**
+     * Adds a line to the plan of the query. Each step of the plan is
+     * added as a separate line.
+     *
+     * @param step The description of the step, e.g., "Seq scan on test.csv".
+     */
+    void addPlan(const std::string& step) { plan.push_back(step); }
+
+    /**
+     * Prints the plan and, for explain analyze, the rows, bytes, and the
+     * wall and CPU time spent in each phase. The scan times exclude the
+     * time spent formatting the rows.
+     *
+     * @param os The output stream to where the statistics are written.
+     */
+    void print(std::ostream& os) const;
+
+    /**
+     * A timer that adds the time (in its scope) to a phase of the current
+     * statistics. Wall time is measured using a steady clock while CPU time
+     * is the time used by the calling thread.
+     */
+    class Timer {
+    public:
+        explicit Timer(Phase phase);
+        ~Timer();
+    private:
+        QueryStats* const stats;
+        const Phase phase;
+        std::chrono::steady_clock::time_point wallStart;
+        double cpuStart = 0;
+    };
+
+    /** Flag to indicate if the query is actually run */
+    const bool analyze;
+
+    /** The number of rows examined by the query */
+    long rowsScanned = 0;
+
+    /** The number of rows printed (or updated) by the query */
+    long rowsEmitted = 0;
+
+    /** The number of bytes of output produced by the query */
+    long bytes = 0;
+
+private:
+    /** The CPU time (in milliseconds) used by the calling thread */
+    static double cpuTime();
+
+    /** The steps in the plan, in the order in which they are performed */
+    StrVec plan;
+
+    /** The wall and CPU time (in milliseconds) spent in each phase */
+    double wall[NumPhases] = {}, cpu[NumPhases] = {};
+
+    /** The statistics that were current when this object was created */
+    QueryStats* const prev;
+
+    /** The statistics being collected by each thread */
+    static thread_local QueryStats* currentStats;
+};
+
+#endif /* QUERY_STATS_H */
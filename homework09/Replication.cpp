@@ -0,0 +1,285 @@
+/*
+ * Copyright (C) Ethan Gutknecht 2021 (gutkneET@miamioh.edu)
+ *
+ * Implementation of the change log of a primary and of read replicas.
+ */
+
+#include <thread>
+#include <cstdlib>
+#include <sstream>
+#include "Replication.h"
+#include "Helper.h"
+
+using namespace boost::asio;
+using namespace boost::asio::ip;
+
+// Definitions for the constants used by reference.
+const size_t ChangeLog::MaxRecords;
+const int Replica::HeartbeatMillis;
+
+//-----------------------------[  ChangeRecord  ]--------------------------
+
+void
+ChangeRecord::encode(std::string& out) const {
+    WireWriter writer(out);
+    writer.u64(position);
+    writer.u64(time);
+    writer.u32(cells.size());
+    for (const auto& cell : cells) {
+        writer.str(cell.table);
+        writer.u32(cell.row);
+        writer.u16(cell.col);
+        writer.str(cell.value);
+    }
+}
+
+void
+ChangeRecord::decode(WireReader& in) {
+    position = in.u64();
+    time     = in.u64();
+    cells.resize(in.u32());
+    for (auto& cell : cells) {
+        cell.table = in.str();
+        cell.row   = in.u32();
+        cell.col   = in.u16();
+        cell.value = in.str();
+    }
+}
+
+uint64_t
+ChangeRecord::now() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+//------------------------------[  ChangeLog  ]----------------------------
+
+uint64_t
+ChangeLog::position() const {
+    std::lock_guard<std::mutex> guard(mutex);
+    return last;
+}
+
+void
+ChangeLog::append(std::vector<ChangeRecord::Cell>& cells) {
+    std::shared_ptr<ChangeRecord> record = std::make_shared<ChangeRecord>();
+    record->time  = ChangeRecord::now();
+    record->cells = std::move(cells);
+    {
+        std::lock_guard<std::mutex> guard(mutex);
+        record->position = ++last;
+        records.push_back(record);
+        if (records.size() > MaxRecords) {
+            records.pop_front();
+        }
+    }
+    added.notify_all();
+}
+
+uint64_t
+ChangeLog::subscribe(uint64_t after) {
+    std::lock_guard<std::mutex> guard(mutex);
+    enabled.store(true, std::memory_order_release);
+    if (after == UINT64_MAX) {
+        return last;
+    }
+    const uint64_t first = (records.empty() ? last + 1 :
+                            records.front()->position);
+    if (after > last || after + 1 < first) {
+        throw Exp("Position " + std::to_string(after) + " is not in the "
+                  "change log. Restart the follower to copy the tables "
+                  "again.");
+    }
+    return after;
+}
+
+uint64_t
+ChangeLog::read(uint64_t after,
+        std::vector<std::shared_ptr<const ChangeRecord>>& records,
+        std::chrono::milliseconds timeout) {
+    std::unique_lock<std::mutex> lock(mutex);
+    added.wait_for(lock, timeout, [this, after] { return last > after; });
+    if (last == after) {
+        return ChangeRecord::now();
+    }
+    // The records are numbered consecutively from the first one kept.
+    const uint64_t first = this->records.front()->position;
+    if (after + 1 < first) {
+        throw Exp("The follower fell behind by more than " +
+                  std::to_string(MaxRecords) + " changes.");
+    }
+    records.insert(records.end(), this->records.begin() + (after + 1 - first),
+                   this->records.end());
+    return ChangeRecord::now();
+}
+
+//-------------------------------[  Replica  ]-----------------------------
+
+Replica::Replica(const std::string& primary) : asOf(ChangeRecord::now()) {
+    const size_t colon = primary.rfind(':');
+    if (colon == std::string::npos) {
+        throw Exp("Invalid primary " + primary + " (expected host:port)");
+    }
+    host = primary.substr(0, colon);
+    port = primary.substr(colon + 1);
+}
+
+std::unique_ptr<Replica>
+Replica::fromEnv() {
+    const char* const env = std::getenv("SQLAIR_PRIMARY");
+    if (env == nullptr) {
+        return nullptr;  // Not a follower.
+    }
+    return std::unique_ptr<Replica>(new Replica(Helper::trim(env)));
+}
+
+std::unique_lock<std::mutex>
+Replica::snapshot(const std::string& table, CSV& csv) {
+    std::unique_lock<std::mutex> lock(mutex);
+    // The snapshot must be taken after the position at which the changes
+    // are being received, so that no changes are missed.
+    waitSubscribed(lock);
+    io_service service;
+    tcp::socket sock(service);
+    boost::system::error_code ec;
+    tcp::resolver resolver(service);
+    connect(sock, resolver.resolve(host, port, ec), ec);
+    if (ec) {
+        throw Exp("Unable to connect to the primary at " + host + ":" + port);
+    }
+    FrameStream stream(sock);
+    std::string payload;
+    WireWriter(payload).str(table);
+    stream.write(Wire::Snapshot, 1, payload);
+    stream.flush();
+    std::vector<CSVRow> rows;
+    for (Wire::Frame reply; stream.read(reply);) {
+        WireReader in(reply.payload);
+        if (reply.type == Wire::Batch) {
+            ColumnBatch batch;
+            batch.decode(in);
+            for (size_t row = 0; (row < batch.rows); row++) {
+                rows.emplace_back();
+                for (const auto& column : batch.columns) {
+                    rows.back().push_back(column.text(row));
+                }
+            }
+        } else if (reply.type == Wire::Columns) {
+            const uint64_t position = in.u64();
+            // The CSV gets its columns from a header line.
+            std::string header;
+            for (int cols = in.u16(); (cols > 0); cols--) {
+                header += (header.empty() ? "\"" : ",\"") + in.str() + "\"";
+            }
+            std::istringstream is(header + "\n");
+            csv.load(is);
+            csv.reserve(rows.size());
+            for (auto& row : rows) {
+                csv.push_back(std::move(row));
+            }
+            // If the table was copied earlier, that copy is used.
+            tables.emplace(table, position);
+            return lock;
+        } else if (reply.type == Wire::Error) {
+            throw Exp(in.str());
+        } else {
+            throw Exp("Unexpected message from the primary.");
+        }
+    }
+    throw Exp("Connection closed by the primary.");
+}
+
+void
+Replica::waitSubscribed(std::unique_lock<std::mutex>& lock) {
+    if (!subscribedCond.wait_for(lock, std::chrono::seconds(5),
+                                 [this] { return subscribed; })) {
+        throw Exp("Not receiving changes from the primary at " + host + ":" +
+                  port);
+    }
+}
+
+void
+Replica::follow(const std::function<void(const ChangeRecord&)>& apply) {
+    // Each error is reported once, until the follower subscribes again.
+    bool started = false;
+    std::string reported;
+    for (;; std::this_thread::sleep_for(std::chrono::seconds(1))) {
+        try {
+            io_service service;
+            tcp::socket sock(service);
+            tcp::resolver resolver(service);
+            connect(sock, resolver.resolve(host, port));
+            FrameStream stream(sock);
+            // Start after the last change applied, if any.
+            std::string payload;
+            WireWriter(payload).u64(started ? applied.load() : UINT64_MAX);
+            stream.write(Wire::Subscribe, 1, payload);
+            stream.flush();
+            ChangeRecord record, changes;
+            for (Wire::Frame frame; stream.read(frame);) {
+                WireReader in(frame.payload);
+                if (frame.type == Wire::Error) {
+                    throw Exp(in.str());
+                }
+                std::lock_guard<std::mutex> guard(mutex);
+                if (frame.type == Wire::Change) {
+                    record.decode(in);
+                    // Apply only the changes made after a table was copied.
+                    changes.cells.clear();
+                    for (auto& cell : record.cells) {
+                        const auto table = tables.find(cell.table);
+                        if (table != tables.end() &&
+                            table->second < record.position) {
+                            changes.cells.push_back(std::move(cell));
+                        }
+                    }
+                    if (!changes.cells.empty()) {
+                        changes.position = record.position;
+                        changes.time     = record.time;
+                        apply(changes);
+                    }
+                } else if (frame.type == Wire::Heartbeat) {
+                    record.position = in.u64();
+                    record.time     = in.u64();
+                } else {
+                    throw Exp("Unexpected message from the primary.");
+                }
+                applied = record.position;
+                asOf    = record.time;
+                if (!subscribed) {
+                    subscribed = started = true;
+                    reported.clear();
+                    std::cout << "Following the primary at " << host << ":"
+                              << port << std::endl;
+                    subscribedCond.notify_all();
+                }
+            }
+            throw Exp("Connection closed by the primary.");
+        } catch (const std::exception& exp) {
+            if (reported != exp.what()) {
+                reported = exp.what();
+                std::cerr << "Not receiving changes from the primary at "
+                          << host << ":" << port << ": " << reported
+                          << std::endl;
+            }
+            std::lock_guard<std::mutex> guard(mutex);
+            subscribed = false;
+        }
+    }
+}
+
+double
+Replica::lag() const {
+    const uint64_t now = ChangeRecord::now(), time = asOf;
+    return (now > time ? (now - time) / 1e6 : 0);
+}
+
+void
+Replica::printMetrics(std::ostream& os) const {
+    os << "# HELP sqlair_replication_position Last change log record "
+          "applied.\n# TYPE sqlair_replication_position gauge\n"
+       << "sqlair_replication_position " << applied << '\n'
+       << "# HELP sqlair_replication_lag_seconds Age of the data in this "
+          "replica.\n# TYPE sqlair_replication_lag_seconds gauge\n"
+       << "sqlair_replication_lag_seconds " << lag() << '\n';
+}
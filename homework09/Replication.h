@@ -0,0 +1,227 @@
+#ifndef REPLICATION_H
+#define REPLICATION_H
+
+/*
+ * Copyright (C) Ethan Gutknecht 2021 (gutkneET@miamioh.edu)
+ *
+ * Read replicas of a SQLAir process. The primary process keeps a log of
+ * the changes made by updates (and commits). A follower process copies
+ * each table from the primary (a snapshot) when it is first used and then
+ * applies the changes from the log in the order they were made. So the
+ * follower can run selects on its own, adding read capacity. Updates must
+ * be sent to the primary. A follower is configured via an environment
+ * variable with the binary protocol port (SQLAIR_BINARY_PORT) of the
+ * primary, which must serve the binary protocol:
+ *
+ *     SQLAIR_BINARY_PORT=5001 ./homework09 5000 &
+ *     SQLAIR_PRIMARY=localhost:5001 ./homework09 6000 &
+ *     SQLAIR_PRIMARY=localhost:5001 ./homework09 7000 &
+ *
+ * The lag of a follower (how old its data may be) is reported in its
+ * metrics and in the X-Replication-Lag header of its responses. The lag is
+ * based on the clocks of both processes, so they must be in sync.
+ */
+
+#include <deque>
+#include <mutex>
+#include <memory>
+#include <string>
+#include <vector>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <functional>
+#include <unordered_map>
+#include <condition_variable>
+#include "CSV.h"
+#include "WireProtocol.h"
+
+/** The changes made by one update statement or commit on the primary */
+struct ChangeRecord {
+    /** A new value for a column in a row */
+    struct Cell {
+        std::string table;
+        uint32_t row;
+        uint16_t col;
+        std::string value;
+    };
+
+    /** The position of this record in the change log (starts at 1) */
+    uint64_t position = 0;
+
+    /** The time of the change, in microseconds since the epoch */
+    uint64_t time = 0;
+
+    /** The values changed, grouped by table */
+    std::vector<Cell> cells;
+
+    /**
+     * Appends the record to the payload of a Change message, in the form:
+     * uint64 position, uint64 time, uint32 count, and count x (string
+     * table, uint32 row, uint16 column, string value).
+     */
+    void encode(std::string& out) const;
+
+    /** Reads a record from the payload of a Change message */
+    void decode(WireReader& in);
+
+    /** Returns the current time, in microseconds since the epoch */
+    static uint64_t now();
+};
+
+/**
+ * The recent changes on the primary, in the order they were made. The
+ * log is empty until the first follower subscribes, so that a process
+ * without followers does not pay for it. Only the last MaxRecords records
+ * are kept.
+ */
+class ChangeLog {
+public:
+    /** The number of records kept for followers that fall behind */
+    static const size_t MaxRecords = 65536;
+
+    /** Returns true once a follower has subscribed to the log */
+    bool active() const { return enabled.load(std::memory_order_acquire); }
+
+    /** Returns the position of the last record added to the log */
+    uint64_t position() const;
+
+    /**
+     * Adds the changes made by an update or a commit to the log. The
+     * caller must hold the locks on the tables changed, so that the
+     * records of each table are in the order the changes were made.
+     *
+     * @param cells The values changed. The vector is moved into the log.
+     */
+    void append(std::vector<ChangeRecord::Cell>& cells);
+
+    /**
+     * Starts the log (if needed) for a new follower.
+     *
+     * @param after The position of the last record that the follower has
+     * or 2^64 - 1 to start from the latest record.
+     *
+     * @return The position of the last record the follower has.
+     *
+     * @exception Exp Thrown if records after the position are no longer
+     * (or not yet) in the log.
+     */
+    uint64_t subscribe(uint64_t after);
+
+    /**
+     * Waits (up to a given time) for records after a given position.
+     *
+     * @param after The position of the last record that the caller has.
+     * @param records The vector to which the records are added.
+     * @param timeout The maximum time to wait for a new record.
+     *
+     * @return The time (in microseconds since the epoch) when the log was
+     * checked. There are no other records up to this time.
+     *
+     * @exception Exp Thrown if records after the position were removed.
+     */
+    uint64_t read(uint64_t after,
+        std::vector<std::shared_ptr<const ChangeRecord>>& records,
+        std::chrono::milliseconds timeout);
+
+private:
+    /** Set when the first follower subscribes */
+    std::atomic<bool> enabled = {false};
+
+    /** The records in the log */
+    std::deque<std::shared_ptr<const ChangeRecord>> records;
+
+    /** The position of the last record added to the log */
+    uint64_t last = 0;
+
+    /** The mutex to guard the above data */
+    mutable std::mutex mutex;
+
+    /** Notified when records are added */
+    std::condition_variable added;
+};
+
+/**
+ * A follower's view of the primary. It copies tables from the primary and
+ * applies the changes from the primary's log to them.
+ */
+class Replica {
+public:
+    /** Heartbeats are sent by the primary when it has no changes to send */
+    static const int HeartbeatMillis = 100;
+
+    /**
+     * Creates a replica of a primary.
+     *
+     * @param primary The host:port of the binary protocol of the primary.
+     */
+    explicit Replica(const std::string& primary);
+
+    /**
+     * Returns a replica of the primary in the SQLAIR_PRIMARY environment
+     * variable (host:port) or nullptr if the variable is not set.
+     */
+    static std::unique_ptr<Replica> fromEnv();
+
+    /**
+     * Copies a table from the primary. The changes to the table after the
+     * snapshot are applied once the table is added to the other tables,
+     * so the returned lock must be held until then.
+     *
+     * @param table The name of the table on the primary.
+     * @param csv The CSV into which the rows are loaded.
+     *
+     * @return The lock that stops changes from being applied.
+     * @exception Exp Thrown on errors or if the follower has not been able
+     * to subscribe to the primary's log.
+     */
+    std::unique_lock<std::mutex> snapshot(const std::string& table,
+        CSV& csv);
+
+    /**
+     * Applies the changes from the primary's log forever. If the
+     * connection to the primary fails, it is retried every second.
+     *
+     * @param apply The function that applies the changes in a record to
+     * the tables. It is called only with the changes to tables that have
+     * been copied, and that were made after they were copied.
+     */
+    void follow(const std::function<void(const ChangeRecord&)>& apply);
+
+    /** Prints the position and lag of this replica in Prometheus format */
+    void printMetrics(std::ostream& os) const;
+
+    /**
+     * Returns how old (in seconds) the data in this replica may be, i.e.,
+     * the time since the last change (or heartbeat) that was applied.
+     */
+    double lag() const;
+
+private:
+    /** Waits (for a while) until this follower is subscribed to the log */
+    void waitSubscribed(std::unique_lock<std::mutex>& lock);
+
+    /** The host and port of the primary */
+    std::string host, port;
+
+    /** The position of the last record applied */
+    std::atomic<uint64_t> applied = {0};
+
+    /** The time on the primary up to which all changes are applied */
+    std::atomic<uint64_t> asOf;
+
+    /** True while the follower is receiving changes from the primary */
+    bool subscribed = false;
+
+    /** The position of the snapshot of each table copied */
+    std::unordered_map<std::string, uint64_t> tables;
+
+    /** The mutex to guard the above data and to apply changes */
+    std::mutex mutex;
+
+    /** Notified when the follower subscribes to the log */
+    std::condition_variable subscribedCond;
+};
+
+#endif /* REPLICATION_H */
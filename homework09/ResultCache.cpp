@@ -0,0 +1,76 @@
+/*
+ * Copyright (C) Ethan Gutknecht 2021 (gutkneET@miamioh.edu)
+ *
+ * Implementation of the cache of query results.
+ */
+
+#include <iterator>
+#include "ResultCache.h"
+
+// Definition for the constant used by reference.
+const size_t ResultCache::MaxSeen;
+
+std::shared_ptr<const std::string>
+ResultCache::get(const std::string& key, uint64_t version) {
+    std::lock_guard<std::mutex> guard(mutex);
+    const auto found = index.find(key);
+    if (found == index.end()) {
+        return nullptr;
+    }
+    if (found->second->version != version) {
+        erase(found->second);  // The table has changed since.
+        return nullptr;
+    }
+    // Move the entry to the front as it is the most recently used one.
+    entries.splice(entries.begin(), entries, found->second);
+    return entries.front().result;
+}
+
+void
+ResultCache::put(const std::string& key, uint64_t version, const char* data,
+        size_t size) {
+    if (size > maxEntryBytes) {
+        return;  // Too big to be worth caching.
+    }
+    // Copy the result before locking to keep the critical section short.
+    std::shared_ptr<const std::string> result =
+        std::make_shared<const std::string>(data, size);
+    std::lock_guard<std::mutex> guard(mutex);
+    const auto found = index.find(key);
+    if (found != index.end()) {
+        erase(found->second);  // Another thread may have added it.
+    }
+    entries.push_front({key, version, std::move(result)});
+    index[key]  = entries.begin();
+    totalBytes += size;
+    while (totalBytes > maxBytes) {
+        erase(std::prev(entries.end()));
+    }
+}
+
+bool
+ResultCache::admit(const std::string& key) {
+    const size_t hash = std::hash<std::string>()(key);
+    std::lock_guard<std::mutex> guard(mutex);
+    if (seen.erase(hash) == 1) {
+        return true;
+    }
+    if (seen.size() >= MaxSeen) {
+        seen.clear();  // Forget old keys, to bound the memory used.
+    }
+    seen.insert(hash);
+    return false;
+}
+
+size_t
+ResultCache::bytes() const {
+    std::lock_guard<std::mutex> guard(mutex);
+    return totalBytes;
+}
+
+void
+ResultCache::erase(std::list<Entry>::iterator entry) {
+    totalBytes -= entry->result->size();
+    index.erase(entry->key);
+    entries.erase(entry);
+}
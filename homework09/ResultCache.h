@@ -0,0 +1,107 @@
+#ifndef RESULT_CACHE_H
+#define RESULT_CACHE_H
+
+/*
+ * Copyright (C) Ethan Gutknecht 2021 (gutkneET@miamioh.edu)
+ *
+ * A bounded cache of the results of select queries. Dashboards repeatedly
+ * run the same queries on tables that rarely change. Such queries are
+ * served from this cache, without scanning the table or formatting rows.
+ */
+
+#include <list>
+#include <mutex>
+#include <string>
+#include <memory>
+#include <cstdint>
+#include <unordered_map>
+#include <unordered_set>
+
+/**
+ * A least-recently-used cache of query results. Each result is stored with
+ * the version of the table it was computed from. A result is used only if
+ * the table still has the same version, i.e., it has not been changed by
+ * updates or commits since the result was computed.
+ */
+class ResultCache {
+public:
+    /**
+     * Creates an empty cache.
+     *
+     * @param maxBytes The maximum total size of the cached results.
+     * @param maxEntryBytes Results larger than this are not cached.
+     */
+    explicit ResultCache(size_t maxBytes = 16 << 20,
+        size_t maxEntryBytes = 1 << 20) : maxBytes(maxBytes),
+        maxEntryBytes(maxEntryBytes) {}
+
+    /**
+     * Returns a cached result.
+     *
+     * @param key The key for the query (and the table it uses).
+     * @param version The current version of the table.
+     *
+     * @return The result or nullptr if the result is not in the cache or
+     * was computed from an older version of the table.
+     */
+    std::shared_ptr<const std::string> get(const std::string& key,
+        uint64_t version);
+
+    /**
+     * Adds a result to the cache, removing the least recently used results
+     * if the cache is full.
+     *
+     * @param key The key for the query (and the table it uses).
+     * @param version The version of the table the result was computed from.
+     * @param data The result of the query.
+     * @param size The number of bytes in the result.
+     */
+    void put(const std::string& key, uint64_t version, const char* data,
+        size_t size);
+
+    /**
+     * Checks if the result of a query (that is not in the cache) should be
+     * added to the cache. To avoid the cost of caching queries that are run
+     * just once, a result is cached only when its query is seen again.
+     *
+     * @param key The key for the query (and the table it uses).
+     */
+    bool admit(const std::string& key);
+
+    /** Returns the total size (in bytes) of the cached results */
+    size_t bytes() const;
+
+private:
+    /** A cached result */
+    struct Entry {
+        std::string key;
+        uint64_t version;
+        std::shared_ptr<const std::string> result;
+    };
+
+    /** Removes an entry from the cache. The caller must hold the mutex */
+    void erase(std::list<Entry>::iterator entry);
+
+    /** The limits on the total size of results and the size of a result */
+    const size_t maxBytes, maxEntryBytes;
+
+    /** The entries, with the most recently used one at the front */
+    std::list<Entry> entries;
+
+    /** The entries in the list, with their keys as the key */
+    std::unordered_map<std::string, std::list<Entry>::iterator> index;
+
+    /** Hashes of recent keys that were not in the cache, see admit() */
+    std::unordered_set<size_t> seen;
+
+    /** The maximum number of entries in seen before it is cleared */
+    static const size_t MaxSeen = 4096;
+
+    /** The total size of the results in the cache */
+    size_t totalBytes = 0;
+
+    /** The mutex to guard the above data */
+    mutable std::mutex mutex;
+};
+
+#endif /* RESULT_CACHE_H */
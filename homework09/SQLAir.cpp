@@ -11,8 +11,15 @@
 #include <fstream>
 #include <tuple>
 #include <algorithm>
+#include <sstream>
+#include <iomanip>
+#include <chrono>
+#include <strings.h>
+#include <sys/socket.h>
 #include "SQLAir.h"
-#include "HTTPFile.h"
+#include "HashJoin.h"
+#include "QueryStats.h"
+#include "Session.h"
 
 /**
  * A fixed HTTP response header that is used by the runServer method below.
@@ -24,88 +31,765 @@ const std::string HTTPRespHeader = "HTTP/1.1 200 OK\r\n"
     "Content-Type: text/plain\r\n"
     "Content-Length: ";
 
-int SQLAir::selectQueryHelper(CSV& csv, bool mustWait, StrVec colNames, 
-        const int whereColIdx, const std::string& cond, 
-        const std::string& value, std::ostream& os) {
+// Definitions for the constants used by reference.
+const int SQLAir::SessionTimeout;
+const int SQLAir::CursorTimeout;
+const size_t SQLAir::MaxCursors;
+const int SQLAir::StatsRefreshSecs;
+const int SQLAir::RequestTimeout;
+
+// Top-level method to process queries. Statements that are specific to
+// this class are handled here and the rest are passed to the base class.
+bool
+SQLAir::process(const std::string& sql, std::ostream& os) {
+    const auto startTime = std::chrono::steady_clock::now();
+    StrVec tokens;
+    bool mustWait;
+    int cmd;
+    std::tie(tokens, mustWait, cmd) = preprocess(sql);
+    return run(sql, tokens, mustWait, os, startTime);
+}
+
+// Run a query that has already been tokenized (by process or when it was
+// prepared), with the timeout of a wait query, if any.
+bool
+SQLAir::run(const std::string& sql, const StrVec& tokens, bool mustWait,
+        std::ostream& os, std::chrono::steady_clock::time_point startTime,
+        bool canPark) {
+    // A wait query may end with "timeout <seconds>", which is not a part
+    // of the query that is run.
+    const size_t numTokens = tokens.size();
+    if (mustWait && numTokens > 2 && tokens[numTokens - 2] == "timeout") {
+        double seconds = -1;
+        if (!(std::istringstream(tokens.back()) >> seconds) || seconds < 0) {
+            throw Exp("Invalid wait timeout " + tokens.back() +
+                      " (expected the number of seconds)");
+        }
+        const auto timeout = std::chrono::duration_cast<
+            std::chrono::steady_clock::duration>(
+                std::chrono::duration<double>(seconds));
+        WaitList::Options options(startTime + timeout, canPark);
+        const StrVec query(tokens.begin(), tokens.end() - 2);
+        return runStatement(sql, query, mustWait, os, startTime);
+    }
+    WaitList::Options options(WaitList::Clock::time_point::max(), canPark);
+    return runStatement(sql, tokens, mustWait, os, startTime);
+}
+
+// Run a statement and record it in the metrics.
+bool
+SQLAir::runStatement(const std::string& sql, const StrVec& tokens,
+        bool mustWait, std::ostream& os,
+        std::chrono::steady_clock::time_point startTime) {
+    const bool isJoin = !tokens.empty() && tokens.front() == "select" &&
+        Helper::find(tokens, "join") != -1;
+    // Determine the type of statement to be recorded in the metrics.
+    int type = Helper::find(StatementTypes, isJoin ? "join" :
+                            (tokens.empty() ? "" : tokens.front()));
+    type = (type == -1 ? Metrics::NumTypes - 1 : type);
+    try {
+        bool more = true;
+        const std::string& stmt = (tokens.empty() ? "" : tokens.front());
+        if (Session::current().txn != nullptr && (mustWait || isJoin)) {
+            throw Exp(std::string(mustWait ? "wait" : "join") +
+                      " is not supported in a transaction.");
+        }
+        if (stmt == "declare" || stmt == "fetch" || stmt == "close") {
+            cursorQuery(tokens, mustWait, os);
+        } else if (coordinator != nullptr && !tokens.empty() &&
+                   stmt != "exit" && streamedFile(tokens).empty()) {
+            // The data is in the shards (unless the query scans a file via
+            // stream()). So they run the query.
+            if (isJoin) {
+                throw Exp("join is not supported with shards.");
+            }
+            coordinator->process(tokens, mustWait, os);
+        } else if (stmt == "begin" || stmt == "commit" ||
+                   stmt == "rollback") {
+            transactionQuery(stmt, os);
+        } else if (stmt == "create") {
+            createIndexQuery(tokens, os);
+        } else if (stmt == "copy") {
+            copyQuery(tokens, os);
+        } else if (stmt == "analyze") {
+            analyzeQuery(tokens, os);
+        } else if (stmt == "explain") {
+            explainQuery(sql, tokens, mustWait, os);
+        } else if (stmt == "describe") {
+            // Print the columns of a table, like the header of a select.
+            os << loadAndGet(tokens.size() > 1 ? tokens[1] : "")
+                .getColumnNames() << std::endl;
+        } else if (isJoin) {
+            validateAndProcessJoin(tokens, mustWait, os);
+        } else if (!dispatch(tokens, mustWait, os)) {
+            // Everything else is handled by the base class.
+            more = SQLAirBase::process(sql, os);
+        }
+        metrics.request(type, true, elapsedMicros(startTime));
+        return more;
+    } catch (const WaitList::Parked&) {
+        throw;  // Recorded once the parked query is done.
+    } catch (...) {
+        metrics.request(type, false, elapsedMicros(startTime));
+        throw;
+    }
+}
+
+// Run the common statements using the tokens from preprocess() rather than
+// having the base class tokenize the query a second time.
+bool
+SQLAir::dispatch(const StrVec& tokens, bool mustWait, std::ostream& os) {
+    const std::string& stmt = (tokens.empty() ? "" : tokens.front());
+    if (stmt == "select") {
+        validateAndProcessSelect(tokens, mustWait, os);
+    } else if (stmt == "update") {
+        validateAndProcessUpdate(tokens, mustWait, os);
+    } else if (stmt == "insert") {
+        validateAndProcessInsert(tokens, mustWait, os);
+    } else if (stmt == "delete") {
+        validateAndProcessDelete(tokens, mustWait, os);
+    } else if (stmt == "use") {
+        validateAndProcessUse(tokens, mustWait, os);
+    } else if (stmt == "save") {
+        validateAndProcessSave(tokens, mustWait, os);
+    } else {
+        return false;
+    }
+    return true;
+}
+
+// Convenience method to return the time (in microseconds) since startTime.
+uint64_t
+SQLAir::elapsedMicros(std::chrono::steady_clock::time_point startTime) {
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - startTime).count();
+}
+
+// Run a query prefixed with "explain" or "explain analyze" and report
+// its plan and statistics instead of the results.
+void
+SQLAir::explainQuery(const std::string& sql, const StrVec& tokens,
+        bool mustWait, std::ostream& os) {
+    const bool analyze = (tokens.size() > 1 && tokens[1] == "analyze");
+    // Skip over the explain (and analyze) keywords in the original query
+    size_t pos = 0;
+    for (int i = 0; (i < (analyze ? 2 : 1) && pos != std::string::npos); i++) {
+        pos = sql.find_first_not_of(" \t\r\n", pos);
+        pos = sql.find_first_of(" \t\r\n", pos);
+    }
+    if (mustWait || pos == std::string::npos) {
+        throw Exp("Expected a select or update query after explain.");
+    }
+    QueryStats stats(analyze);
+    // The query is tokenized again, so no tokens are bound values.
+    BoundValues bound(nullptr);
+    StrVec query;
+    int cmd;
+    {
+        QueryStats::Timer timer(QueryStats::Tokenize);
+        std::tie(query, mustWait, cmd) = preprocess(sql.substr(pos));
+    }
+    // Similar to other databases, the results of the query are not printed.
+    std::ostringstream results;
+    if (cmd == 0 && Helper::find(query, "join") != -1) {
+        validateAndProcessJoin(query, mustWait, results);
+    } else if (cmd == 0) {
+        validateAndProcessSelect(query, mustWait, results);
+    } else if (cmd == 1) {
+        validateAndProcessUpdate(query, mustWait, results);
+    } else {
+        throw Exp("Expected a select or update query after explain.");
+    }
+    stats.bytes = results.str().size();
+    stats.addPlan(std::string("Queue priority: ") +
+        AdmissionQueue::PriorityNames[queryPriority(query, mustWait)]);
+    stats.print(os);
+}
+
+// Add the steps to scan a CSV (with an optional filter) to the query plan.
+void
+SQLAir::explainScan(const std::string& name, const CSV& csv,
+        const Predicate* where) {
+    QueryStats* const stats = QueryStats::current();
+    if (stats == nullptr) {
+        return;  // Not an explain query
+    }
+    stats->addPlan("Seq scan on " + name + " (" + std::to_string(csv.size()) +
+                   " rows)");
+    const std::string encoded = getDictionary(csv).encodedColumns(csv);
+    if (!encoded.empty()) {
+        stats->addPlan("  Dictionary encoded: " + encoded);
+    }
+    if (where != nullptr) {
+        std::ostringstream filter;
+        filter << "  Filter: " << where->toString() << " (est. selectivity "
+               << std::fixed << std::setprecision(2) << where->selectivity()
+               << ")";
+        stats->addPlan(filter.str());
+    }
+}
+
+// Validate a select query, compile its where clause, and run it.
+void
+SQLAir::validateAndProcessSelect(const StrVec& sql, bool mustWait,
+        std::ostream& os) {
+    const std::string path = streamedFile(sql);
+    if (!path.empty()) {
+        streamSelect(path, sql, mustWait, os);
+        return;
+    }
+    const StrVec colNames = Helper::getSelectColNames(sql);
+    const std::string name = Helper::getCSVInfo(sql, "from");
+    CSV& csv = loadAndGet(name);
+    loadColumns(csv, sql);
+    checkColNames(csv, colNames);
+    auto where = getWhere(csv, sql);
+    explainScan(name, csv, where.get());
+    if (QueryStats::planOnly()) {
+        return;  // Only the plan is needed for explain queries
+    }
+    if (!mustWait && QueryStats::current() == nullptr &&
+        Session::current().txn == nullptr && BatchSink::current() == nullptr) {
+        // Repeated queries are served from the cache.
+        cachedSelect(csv, sql, colNames, where.get(), os);
+        return;
+    }
+    selectQuery(csv, mustWait, colNames, where.get(), os);
+    // Keep the where clause to validate the transaction (if any) at commit.
+    Transaction::Table* const txn = txnTable(csv);
+    if (txn != nullptr) {
+        txn->keep(std::move(where));
+    }
+}
+
+// Validate an update query, compile its where clause, and run it.
+void
+SQLAir::validateAndProcessUpdate(const StrVec& sql, bool mustWait,
+        std::ostream& os) {
+    const std::string name = Helper::getCSVInfo(sql, "update");
+    CSV& csv = loadAndGet(name);
+    loadColumns(csv, sql);
+    const int setIdx = Helper::find(sql, "set");
+    if (setIdx == -1) {
+        throw Exp("Expected 'set' in update statement.");
+    }
+    // Extract the column = value pairs until the where clause (if any).
+    // A value extends until the next column = (the tokenizer drops the
+    // commas) and may be an expression, e.g., "raters = raters + 1".
+    const int size = sql.size();
+    const auto resolve = [&csv](const std::string& col) {
+        return csv.getColumnIndex(col);
+    };
+    // Values bound to parameters are never keywords (see BoundValues).
+    const auto is = [&sql](int i, const std::string& word) {
+        return sql[i] == word && !BoundValues::contains(i);
+    };
+    StrVec colNames;
+    std::vector<Expression> values;
+    int idx = setIdx + 1;
+    while ((idx < size && !is(idx, "where"))) {
+        if (idx + 2 >= size || !is(idx + 1, "=")) {
+            throw Exp("Invalid set clause in update statement.");
+        }
+        int end = idx + 3;
+        while ((end < size && !is(end, "where") &&
+                (end + 1 >= size || !is(end + 1, "=")))) {
+            end++;
+        }
+        colNames.push_back(sql[idx]);
+        values.push_back(Expression::parse(sql, idx + 2, end, resolve,
+                                           BoundValues::contains));
+        idx = end;
+    }
+    checkColNames(csv, colNames, false, false);
+    auto where = getWhere(csv, sql, idx);
+    explainScan(name, csv, where.get());
+    if (QueryStats::planOnly()) {
+        return;  // Only the plan is needed for explain queries
+    }
+    if (replica != nullptr) {
+        throw Exp("update is not supported on a read replica. Send it to "
+                  "the primary.");
+    }
+    updateQuery(csv, mustWait, colNames, values, where.get(), os);
+    // Keep the where clause to validate the transaction (if any) at commit.
+    Transaction::Table* const txn = txnTable(csv);
+    if (txn != nullptr) {
+        txn->keep(std::move(where));
+    }
+}
+
+// Compile the optional where clause in a query into a predicate tree.
+std::unique_ptr<Predicate>
+SQLAir::getWhere(const CSV& csv, const StrVec& sql, const int startIdx) const {
+    int whereIdx = Helper::find(sql, "where", startIdx);
+    // Values bound to parameters are never keywords (see BoundValues).
+    while (whereIdx != -1 && BoundValues::contains(whereIdx)) {
+        whereIdx = Helper::find(sql, "where", whereIdx + 1);
+    }
+    if (whereIdx == -1) {
+        return nullptr;  // No where clause in this query.
+    }
+    auto where = Predicate::parse(sql, whereIdx + 1, sql.size(),
+        [&csv](const std::string& col) {
+            const int colIdx = csv.getColumnIndex(col);
+            if (colIdx == -1) {
+                throw Exp("Column " + col + " not found in CSV");
+            }
+            return std::make_pair(0, colIdx);
+        }, BoundValues::contains);
+    // The conditions are ordered using the statistics, if the table has
+    // been analyzed (which stream() scans cannot be).
+    const Catalog::Table* const table = catalog.find(csv);
+    if (table != nullptr) {
+        where->useStats([table](const Predicate& cmp) {
+            return table->stats->selectivity(cmp);
+        });
+    }
+    return where;
+}
+
+// Return the file in a "from stream ( file )" clause, if any.
+std::string
+SQLAir::streamedFile(const StrVec& sql) {
+    const int fromIdx = Helper::find(sql, "from");
+    if (fromIdx == -1 || fromIdx + 4 >= (int) sql.size() ||
+        sql[fromIdx + 1] != "stream" || sql[fromIdx + 2] != "(" ||
+        sql[fromIdx + 4] != ")") {
+        return "";
+    }
+    return sql[fromIdx + 3];
+}
+
+// Scan a CSV file in blocks and print the rows that match a where clause.
+// The values are read from the file only if the query uses them.
+void
+SQLAir::streamSelect(const std::string& path, const StrVec& sql,
+        bool mustWait, std::ostream& os) {
+    if (mustWait) {
+        throw Exp("wait is not supported for stream() scans.");
+    }
+    if (path.find("http://") == 0) {
+        throw Exp("stream() supports only local files.");
+    }
+    StreamScan scan(path);
+    const CSV& csv = scan.columns();
+    StrVec colNames = Helper::getSelectColNames(sql);
+    checkColNames(csv, colNames);
+    if (colNames.size() == 1 && colNames.front() == "*") {
+        colNames = csv.getColumnNames();
+    }
+    const auto where = getWhere(csv, sql);
+    QueryStats* const stats = QueryStats::current();
+    if (stats != nullptr) {
+        stats->addPlan("Stream scan on " + path + " (blocks of " +
+                       std::to_string(StreamScan::BlockSize >> 10) + " KB)");
+        if (where != nullptr) {
+            stats->addPlan("  Filter: " + where->toString());
+        }
+    }
+    if (QueryStats::planOnly()) {
+        return;  // Only the plan is needed for explain queries
+    }
+    QueryStats::Timer timer(QueryStats::Scan);
+    BatchSink* const sink = (stats == nullptr ? BatchSink::current() :
+                             nullptr);
+    std::vector<int> colIdxs;
+    for (const auto& colName : colNames) {
+        colIdxs.push_back(csv.getColumnIndex(colName));
+    }
+    const std::function<const std::string&(int)> getValue =
+        [&scan](int col) -> const std::string& { return scan.value(col); };
+    int numSelects = 0;
+    while ((scan.next())) {
+        if (where != nullptr && !where->eval(getValue)) {
+            continue;
+        }
+        if (numSelects++ == 0 && sink != nullptr) {
+            sink->start(colNames);
+        } else if (numSelects == 1) {
+            os << colNames << std::endl;
+        }
+        std::string delim = "";
+        for (const int colIdx : colIdxs) {
+            if (sink != nullptr) {
+                sink->add(scan.value(colIdx));
+            } else {
+                os << delim << scan.value(colIdx);
+                delim = "\t";
+            }
+        }
+        if (sink != nullptr) {
+            sink->endRow();
+        } else {
+            os << '\n';
+        }
+    }
+    if (stats != nullptr) {
+        stats->rowsScanned += scan.rowsScanned();
+        stats->rowsEmitted  = numSelects;
+    }
+    os << numSelects << " row(s) selected.\n";
+}
+
+int SQLAir::selectQueryHelper(CSV& csv, bool mustWait,
+        const StrVec& colNames, const Predicate* where, std::ostream& os) {
     // number of rows that were selected.
     int numSelects = 0;
-    
+    const auto rowsLock = readRows(csv);
+    QueryStats::Timer timer(QueryStats::Scan);
+    const Dictionary& dict = getDictionary(csv);
+    if (where != nullptr) {
+        where->bind(0, csv, dict);
+    }
+    // In a transaction, rows are read as seen by the transaction.
+    Transaction::Table* const txn = txnTable(csv);
+    // Zone maps and trigram indexes let the scan skip rows that cannot
+    // match. They do not include the changes buffered in a transaction.
+    ZoneMap* const zones = (where != nullptr && txn == nullptr ?
+                            &getZones(csv) : nullptr);
+    if (zones != nullptr && zones->missing(*where)) {
+        const auto lock = lockTable(csv);
+        zones->build(csv, dict, *where);
+    }
+    ScanPlan plan(csv.size(), where, zones,
+                  (txn == nullptr ? &getTrigrams(csv) : nullptr));
+    // Binary protocol clients get the rows in batches instead of as text
+    // (but explain queries do not return any rows).
+    BatchSink* const sink = (QueryStats::current() == nullptr ?
+                             BatchSink::current() : nullptr);
+    // The column indexes are only needed for this scan, so use the arena.
+    Arena::Scope scope;
+    ArenaVec<int> colIdxs{ArenaAllocator<int>(scope.arena)};
+    colIdxs.reserve(colNames.size());
+    for (const auto& colName : colNames) {
+        colIdxs.push_back(csv.getColumnIndex(colName));
+    }
+
     // Print each row that matches an optional condition.
-    for (const auto& row : csv) {        
+    for (size_t rowIdx = plan.next(0); (rowIdx < csv.size());
+         rowIdx = plan.next(rowIdx + 1)) {
+        const CSVRow& row = csv[rowIdx];
         // Determine if this row matches "where" clause condition, if any
-        const bool isMatch = (whereColIdx == -1) ? true :
-                matches(row.at(whereColIdx), cond, value);
+        const bool isMatch = (txn != nullptr ? txn->matches(rowIdx, where) :
+                              (where == nullptr) || where->eval(row));
         if (isMatch) {
+            QueryStats::Timer fmtTimer(QueryStats::Format);
             // Since there is a match, print the first 
             // header lines.
-            if (numSelects == 0) {
+            if (numSelects == 0 && sink != nullptr) {
+                sink->start(colNames);
+            } else if (numSelects == 0) {
                 // First print the column names.
                 os << colNames << std::endl;
             }
             std::string delim = "";
-            for (const auto& colName : colNames) {
-                os << delim << row.at(csv.getColumnIndex(colName));
-                delim = "\t";
+            for (const int colIdx : colIdxs) {
+                const std::string& val = (txn != nullptr ?
+                    txn->get(rowIdx, colIdx) : dict.get(row, rowIdx, colIdx));
+                if (sink != nullptr) {
+                    sink->add(val);
+                } else {
+                    os << delim << val;
+                    delim = "\t";
+                }
+            }
+            if (sink != nullptr) {
+                sink->endRow();
+            } else {
+                os << std::endl;
             }
-            os << std::endl;
             numSelects++;
         }
     }
+    if (QueryStats::current() != nullptr) {
+        QueryStats::current()->rowsScanned += csv.size() - plan.skipped();
+        for (const auto& step : plan.describe()) {
+            QueryStats::current()->addPlan(step);
+        }
+    }
     return numSelects;
 }
 
+// Run a select using the result cache. The key includes the CSV, as the
+// table name is optional in queries.
+void
+SQLAir::cachedSelect(CSV& csv, const StrVec& sql, const StrVec& colNames,
+        const Predicate* where, std::ostream& os) {
+    std::string key = std::to_string(reinterpret_cast<uintptr_t>(&csv));
+    for (const auto& token : sql) {
+        key += '\x1f';  // A separator that does not occur in queries.
+        key += token;
+    }
+    const TableVersions& rowVersions = getVersions(csv);
+    const uint64_t version = rowVersions.table();
+    const bool stable = !rowVersions.writing();
+    const auto cached = resultCache.get(key, version);
+    if (cached != nullptr) {
+        metrics.add(Metrics::ResultHits);
+        os.write(cached->data(), cached->size());
+        return;
+    }
+    metrics.add(Metrics::ResultMisses);
+    if (!resultCache.admit(key)) {
+        // Not worth caching (yet). So write the results directly.
+        selectQuery(csv, false, colNames, where, os);
+        return;
+    }
+    OutputBuffer result;
+    selectQuery(csv, false, colNames, where, result);
+    // Cache the result only if the table did not change during the scan.
+    if (stable && !rowVersions.writing() && rowVersions.table() == version) {
+        resultCache.put(key, version, result.data(), result.size());
+    }
+    os.write(result.data(), result.size());
+}
+
 // API method to perform operations associated with a "select" statement
 // to print columns that match an optional condition.
-void SQLAir::selectQuery(CSV& csv, bool mustWait, StrVec colNames, 
-        const int whereColIdx, const std::string& cond, 
-        const std::string& value, std::ostream& os) {    
+void SQLAir::selectQuery(CSV& csv, bool mustWait, StrVec colNames,
+        const int whereColIdx, const std::string& cond,
+        const std::string& value, std::ostream& os) {
+    // Convert the condition, if any, to a predicate for further processing
+    const auto where = (whereColIdx == -1 ? nullptr :
+                        Predicate::compare(whereColIdx, cond, value));
+    selectQuery(csv, mustWait, colNames, where.get(), os);
+}
+
+// Select rows that match a predicate compiled from the where clause.
+void SQLAir::selectQuery(CSV& csv, bool mustWait, const StrVec& selectCols,
+        const Predicate* where, std::ostream& os) {
     // Get how many rows are selected. If the CSV file is being
     // manipulated already it will continue in the loop
     // until it is able to access it without causing a 
     // race condition.
     
-    if (colNames.size() == 1 && colNames.front() == "*") {
-        // With a wildcard column name, we print all of the columns in CSV
-        colNames = csv.getColumnNames();
-    }
-    
-    int rowsSelected = selectQueryHelper(csv, mustWait, colNames, 
-            whereColIdx, cond, value, os);
-    
-    
+    // With a wildcard column name, we print all of the columns in CSV
+    const bool all = (selectCols.size() == 1 && selectCols.front() == "*");
+    const StrVec allCols = (all ? csv.getColumnNames() : StrVec());
+    const StrVec& colNames = (all ? allCols : selectCols);
+
+    // A wait query tries again each time the table changes, until it
+    // finds some rows.
+    WaitList& waiters = getWaiters(csv);
+    uint64_t generation = waiters.generation();
+    int rowsSelected = selectQueryHelper(csv, mustWait, colNames, where, os);
     while (mustWait && rowsSelected == 0) {
-        // Critical section starts
-        std::unique_lock<std::mutex> uniqueLock(csv.csvMutex);
-        
-        thrCond.wait(uniqueLock);
-        // Critical section ends
-        
-        // Try to find how many rows would be selected.
-        rowsSelected = selectQueryHelper(csv, mustWait, colNames, 
-            whereColIdx, cond, value, os);
+        waiters.wait(generation);
+        generation = waiters.generation();
+        rowsSelected = selectQueryHelper(csv, mustWait, colNames, where, os);
     }
     
     // Print results.
+    if (QueryStats::current() != nullptr) {
+        QueryStats::current()->rowsEmitted = rowsSelected;
+    }
     os << rowsSelected << " row(s) selected.\n";
 }
 
+// Validate a "select ... from a join b on x = y" query and run a hash join
+void
+SQLAir::validateAndProcessJoin(const StrVec& sql, bool mustWait,
+        std::ostream& os) {
+    if (mustWait) {
+        throw Exp("wait is not supported for join queries.");
+    }
+    // Check the overall structure of the query.
+    const int fromIdx = Helper::find(sql, "from");
+    const int joinIdx = Helper::find(sql, "join");
+    const int onIdx   = joinIdx + 2;
+    if (fromIdx < 2 || joinIdx != fromIdx + 2 ||
+        onIdx + 3 >= (int) sql.size() || sql[onIdx] != "on" ||
+        sql[onIdx + 2] != "=") {
+        throw Exp("Join must be of the form: select cols from a.csv join "
+                  "b.csv on col1 = col2");
+    }
+    // Load the two CSVs being joined.
+    const StrVec names = {sql[fromIdx + 1], sql[joinIdx + 1]};
+    CSV& left  = loadAndGet(names[0]);
+    CSV& right = loadAndGet(names[1]);
+    loadColumns(left, sql, names[0]);
+    loadColumns(right, sql, names[1]);
+    // The tables are locked in a fixed order to avoid deadlocks with
+    // commits, which lock them exclusively.
+    const bool leftFirst = std::less<const CSV*>()(&left, &right);
+    const auto leftRows = readRows(leftFirst ? left : right);
+    std::shared_lock<std::shared_timed_mutex> rightRows;
+    if (&right != &left) {
+        // A table may be joined with itself.
+        rightRows = readRows(leftFirst ? right : left);
+    }
+
+    // Determine the join columns. The first one must be from the left table.
+    JoinCol lKey = getJoinColumn(sql[onIdx + 1], names, left, right);
+    JoinCol rKey = getJoinColumn(sql[onIdx + 3], names, left, right);
+    if (lKey.first == rKey.first) {
+        // Unqualified names are looked up in the left table first.
+        rKey = getJoinColumn(names[1] + "." + sql[onIdx + 3], names, left,
+                             right);
+    }
+    if (lKey.first != 0) {
+        std::swap(lKey, rKey);
+    }
+
+    // Determine the columns to be printed.
+    StrVec header(sql.begin() + 1, sql.begin() + fromIdx);
+    std::vector<JoinCol> outCols;
+    if (header.size() == 1 && header.front() == "*") {
+        header = left.getColumnNames();
+        const StrVec rightNames = right.getColumnNames();
+        header.insert(header.end(), rightNames.begin(), rightNames.end());
+        for (int i = 0; (i < (int) header.size()); i++) {
+            outCols.push_back(i < left.getColumnCount() ?
+                JoinCol(0, i) : JoinCol(1, i - left.getColumnCount()));
+        }
+    } else {
+        for (const auto& col : header) {
+            outCols.push_back(getJoinColumn(col, names, left, right));
+        }
+    }
+
+    // Setup an optional filter based on the where clause, if any. The
+    // conditions that use only one table are checked on the rows of that
+    // table before they are joined.
+    const CSV* const tables[2] = {&left, &right};
+    std::unique_ptr<Predicate> where, pushed[2];
+    const int whereIdx = onIdx + 4;
+    if (whereIdx < (int) sql.size()) {
+        if (sql[whereIdx] != "where") {
+            throw Exp("Invalid where clause in join query.");
+        }
+        where = Predicate::parse(sql, whereIdx + 1, sql.size(),
+            [&](const std::string& col) {
+                return getJoinColumn(col, names, left, right);
+            });
+        where->useStats([&](const Predicate& cmp) {
+            return getStats(*tables[cmp.col.first]).selectivity(cmp);
+        });
+        for (int tbl = 0; (tbl < 2); tbl++) {
+            pushed[tbl] = Predicate::extract(where, tbl);
+        }
+    }
+    RowFilter rowFilters[2];
+    for (int tbl = 0; (tbl < 2); tbl++) {
+        const Predicate* const cond = pushed[tbl].get();
+        const CSV* const csv = tables[tbl];
+        if (cond != nullptr) {
+            cond->bind(tbl, *csv, getDictionary(*csv));
+            rowFilters[tbl] = [cond, csv](size_t rowIdx) {
+                return cond->eval((*csv)[rowIdx]);
+            };
+        }
+    }
+    JoinFilter filter;
+    if (where != nullptr) {
+        where->bind(0, left, getDictionary(left));
+        where->bind(1, right, getDictionary(right));
+        const Predicate* const cond = where.get();
+        filter = [cond](const CSVRow& l, const CSVRow& r) {
+            return cond->eval(l, r);
+        };
+    }
+
+    // Build the hash table on the table with fewer rows left after its
+    // filter, as estimated (via the statistics, if the table was analyzed).
+    double estRows[2];
+    for (int tbl = 0; (tbl < 2); tbl++) {
+        estRows[tbl] = tables[tbl]->size() * (pushed[tbl] == nullptr ? 1 :
+                                              pushed[tbl]->selectivity());
+    }
+    const bool buildLeft = (estRows[0] <= estRows[1]);
+
+    // Add the steps of the join to the plan for explain queries.
+    QueryStats* const stats = QueryStats::current();
+    if (stats != nullptr) {
+        // With statistics on the join columns, each row is assumed to match
+        // the rows with the same key in the table with more distinct keys.
+        const double lKeys = getStats(left).distinct(lKey.second);
+        const double rKeys = getStats(right).distinct(rKey.second);
+        std::string estimate;
+        if (lKeys > 0 && rKeys > 0) {
+            const double joined = estRows[0] * estRows[1] /
+                std::max(lKeys, rKeys) *
+                (where == nullptr ? 1 : where->selectivity());
+            estimate = " (est. " + std::to_string(std::llround(joined)) +
+                " rows)";
+        }
+        stats->addPlan("Hash join on " + sql[onIdx + 1] + " = " +
+                       sql[onIdx + 3] + estimate);
+        for (const bool build : {true, false}) {
+            const int tbl = (build == buildLeft ? 0 : 1);
+            stats->addPlan((build ? "  Build: " : "  Probe: ") + names[tbl] +
+                " (" + std::to_string(tables[tbl]->size()) + " rows)");
+            if (pushed[tbl] != nullptr) {
+                std::ostringstream cond;
+                cond << "    Filter: " << pushed[tbl]->toString()
+                     << " (est. selectivity " << std::fixed
+                     << std::setprecision(2) << pushed[tbl]->selectivity()
+                     << ")";
+                stats->addPlan(cond.str());
+            }
+        }
+        if (where != nullptr) {
+            stats->addPlan("  Filter: " + where->toString());
+        }
+        if (!stats->analyze) {
+            return;  // Only the plan is needed for explain queries
+        }
+        stats->rowsScanned = left.size() + right.size();
+    }
+
+    // Have the hash join do the rest of the work. The rows are formatted
+    // by the threads doing the probing, so it is all timed as a scan.
+    HashJoin join(left, lKey.second, right, rKey.second,
+                  getDictionary(left), getDictionary(right));
+    join.plan(buildLeft, rowFilters[0], rowFilters[1]);
+    QueryStats::Timer timer(QueryStats::Scan);
+    const int rows = join.run(header, outCols, filter, os);
+    if (stats != nullptr) {
+        stats->rowsEmitted = rows;
+    }
+    os << rows << " row(s) selected.\n";
+}
+
+// Map a (optionally table-qualified) column name to a table & column index
+std::pair<int, int>
+SQLAir::getJoinColumn(const std::string& col, const StrVec& names,
+        const CSV& left, const CSV& right) const {
+    // Check if the column name is prefixed with one of the table names.
+    for (int tbl = 0; (tbl < 2); tbl++) {
+        const std::string prefix = names[tbl] + ".";
+        if (col.find(prefix) == 0) {
+            const CSV& csv = (tbl == 0 ? left : right);
+            const int idx  = csv.getColumnIndex(col.substr(prefix.size()));
+            if (idx == -1) {
+                throw Exp("Column " + col + " not found in CSV");
+            }
+            return {tbl, idx};
+        }
+    }
+    // Unqualified names are looked up in the left table first.
+    const int lIdx = left.getColumnIndex(col), rIdx = right.getColumnIndex(col);
+    if (lIdx == -1 && rIdx == -1) {
+        throw Exp("Column " + col + " not found in CSV");
+    }
+    return (lIdx != -1 ? JoinCol(0, lIdx) : JoinCol(1, rIdx));
+}
+
 
 int
-SQLAir::updateQueryHelper(CSV& csv,  bool mustWait, StrVec colNames, 
-        StrVec values, const int whereColIdx, const std::string& cond, 
-        const std::string& value, std::ostream& os)  {    
+SQLAir::updateQueryHelper(CSV& csv, const StrVec& colNames,
+        const std::vector<Expression>& values, const Predicate* where) {
     /*
      * I did this for my own understanding. A more detailed description of
      * this is in the header file.
      * 
      * Example Input:
-     * update test.csv set rating=2.5, raters=2 where movieid = 12345;
+     * update test.csv set rating=2.5, raters=raters+1 where movieid = 12345;
      * 
      * colNames         {"rating", "raters"}
-     * values           {"2.5", "2"}
-     * whereColIndx     27
-     * cond             =
-     * value            12345
+     * values           {"2.5", raters + 1}
+     * where            movieid = 12345
      *
      * How is the data base (3D array) set up and how do we access everything?
      * csv[0] = {title, desc, etc}
@@ -115,26 +799,99 @@ SQLAir::updateQueryHelper(CSV& csv,  bool mustWait, StrVec colNames,
      */
     
     int rowCounter = 0;
+    // In a transaction, the changes are buffered until commit. Otherwise,
+    // the changes are made while holding the lock on the CSV and keeping
+    // scans out (as they would otherwise read values being changed).
+    Transaction::Table* const txn = txnTable(csv);
+    std::shared_lock<std::shared_timed_mutex> rowsLock;
+    std::unique_lock<std::shared_timed_mutex> writeLock;
+    std::unique_lock<std::mutex> lock;
+    if (txn == nullptr) {
+        writeLock = writeRows(csv);
+        lock = lockTable(csv);
+    } else {
+        rowsLock = readRows(csv);
+    }
+    TableVersions::Writer writer(getVersions(csv), txn == nullptr);
+    QueryStats::Timer timer(QueryStats::Scan);
+    Dictionary& dict = getDictionary(csv);
+    if (where != nullptr) {
+        where->bind(0, csv, dict);
+    }
+    // Zone maps and trigram indexes let the scan skip rows that cannot
+    // match. They do not include the changes buffered in a transaction.
+    ZoneMap* const zones = (where != nullptr && txn == nullptr ?
+                            &getZones(csv) : nullptr);
+    if (zones != nullptr) {
+        zones->build(csv, dict, *where);
+    }
+    ScanPlan plan(csv.size(), where, zones,
+                  (txn == nullptr ? &getTrigrams(csv) : nullptr));
+    std::vector<int> colIdxs;
+    for (const auto& colName : colNames) {
+        colIdxs.push_back(csv.getColumnIndex(colName));
+    }
+    // Read replicas get the changes (made while holding the lock) in order.
+    const bool logChanges = (txn == nullptr && changeLog.active());
+    const std::string table = (logChanges ? tableName(csv) : "");
+    std::vector<ChangeRecord::Cell> changes;
     
-    // Update each row that matches an optional condition.
-    for (auto& row : csv) {
-        // In the row, update values for each column specified by the user
-        // First see if the column specified isn't a '*', then see if the 
-        // Column matches the where statement.
-        
-        if ((whereColIdx > -1 && 
-                SQLAirBase::matches(row.at(whereColIdx), cond, value)) || 
-                (whereColIdx == -1)) {
-            for (size_t i = 0; (i < colNames.size()); i++) {
-                // Get the index number of the column the user want's to update
-                const int colIdx = csv.getColumnIndex(colNames.at(i));
-                // Update the corresponding column-value in the current row
-                row.at(colIdx) = values.at(i);
+    // Find each row that matches an optional condition and compute all its
+    // new values (from the current values of the row). Nothing is changed
+    // until all the values are computed, so that an error (such as a
+    // division by zero) in any row leaves the table unchanged. No other
+    // update can change the rows in between, as the locks are held until
+    // all rows are updated.
+    std::vector<size_t> rowIdxs;
+    StrVec newValues;
+    for (size_t rowIdx = plan.next(0); (rowIdx < csv.size());
+         rowIdx = plan.next(rowIdx + 1)) {
+        const CSVRow& row = csv[rowIdx];
+        if (txn != nullptr ? txn->matches(rowIdx, where) :
+            (where == nullptr) || where->eval(row)) {
+            for (size_t i = 0; (i < values.size()); i++) {
+                newValues.emplace_back();
+                values[i].eval([&](int col) -> const std::string& {
+                        return (txn != nullptr ? txn->get(rowIdx, col) :
+                                dict.get(row, rowIdx, col));
+                    }, newValues.back());
             }
-            rowCounter++;
+            rowIdxs.push_back(rowIdx);
         }
     }
+    // In each matching row, update values for each column specified by the
+    // user.
+    for (size_t r = 0; (r < rowIdxs.size()); r++) {
+        const size_t rowIdx = rowIdxs[r];
+        const std::string* const rowValues = &newValues[r * values.size()];
+        for (size_t i = 0; (i < colIdxs.size()); i++) {
+            // Update the corresponding column-value in the current row
+            if (txn != nullptr) {
+                txn->set(rowIdx, colIdxs[i], rowValues[i]);
+            } else {
+                dict.set(csv[rowIdx], rowIdx, colIdxs[i], rowValues[i]);
+            }
+        }
+        if (txn == nullptr) {
+            writer.bump(rowIdx);
+        }
+        for (size_t i = 0; (logChanges && i < colIdxs.size()); i++) {
+            changes.push_back({table, static_cast<uint32_t>(rowIdx),
+                static_cast<uint16_t>(colIdxs[i]), rowValues[i]});
+        }
+        rowCounter++;
+    }
+    if (!changes.empty()) {
+        changeLog.append(changes);
+    }
     
+    if (QueryStats::current() != nullptr) {
+        QueryStats::current()->rowsScanned += csv.size() - plan.skipped();
+        for (const auto& step : plan.describe()) {
+            QueryStats::current()->addPlan(step);
+        }
+    }
+
     // Return how many rows were updated
     // so the unique locks can perform without race conditions.
     return rowCounter;
@@ -142,41 +899,48 @@ SQLAir::updateQueryHelper(CSV& csv,  bool mustWait, StrVec colNames,
 
 
 void
-SQLAir::updateQuery(CSV& csv,  bool mustWait, StrVec colNames, StrVec values, 
-        const int whereColIdx, const std::string& cond, 
+SQLAir::updateQuery(CSV& csv,  bool mustWait, StrVec colNames, StrVec values,
+        const int whereColIdx, const std::string& cond,
         const std::string& value, std::ostream& os)  {
-    // This method and helper method is VERY similar to the 
+    // Convert the condition, if any, to a predicate for further processing
+    const auto where = (whereColIdx == -1 ? nullptr :
+                        Predicate::compare(whereColIdx, cond, value));
+    std::vector<Expression> literals;
+    for (const auto& val : values) {
+        literals.push_back(Expression::literal(val));
+    }
+    updateQuery(csv, mustWait, colNames, literals, where.get(), os);
+}
+
+// Update rows that match a predicate compiled from the where clause.
+void
+SQLAir::updateQuery(CSV& csv, bool mustWait, const StrVec& colNames,
+        const std::vector<Expression>& values, const Predicate* where,
+        std::ostream& os) {
+    // This method and helper method is VERY similar to the
     // selectQuery method. It will try to update the the rows
     // if the CSV file is being manipulated it will
     // continue trying in the loop until it can access it.
     
-    int rowsUpdated = 0;
-
-    if (mustWait) {
-        while (mustWait) {
-            rowsUpdated = updateQueryHelper(csv,  mustWait, 
-                    colNames, values, whereColIdx, cond, value, os);
-
-            // Continue trying to update the rows until 
-            // the response is > 0
-            if (rowsUpdated == 0) {
-                // Critical section start
-                std::unique_lock<std::mutex> uniqueLock(csv.csvMutex);
-                csv.csvCondVar.wait(uniqueLock);
-                // Critical section end
-            } else {
-                // If the rows got updated, notify the unique locks
-                csv.csvCondVar.notify_all();
-                break;
-            }
-        }
-    } else if (!mustWait) {
-        rowsUpdated = updateQueryHelper(csv,  mustWait, 
-                colNames, values, whereColIdx, cond, value, os);
-        csv.csvCondVar.notify_all();
+    WaitList& waiters = getWaiters(csv);
+    uint64_t generation = waiters.generation();
+    int rowsUpdated = updateQueryHelper(csv, colNames, values, where);
+    // Continue trying to update the rows (each time the table changes)
+    // until the response is > 0
+    while (mustWait && rowsUpdated == 0) {
+        waiters.wait(generation);
+        generation = waiters.generation();
+        rowsUpdated = updateQueryHelper(csv, colNames, values, where);
+    }
+    if (rowsUpdated > 0 && txnTable(csv) == nullptr) {
+        // Let the waiting queries check the changes.
+        waiters.wake();
     }
     
     // Print out the glorious results.
+    if (QueryStats::current() != nullptr) {
+        QueryStats::current()->rowsEmitted = rowsUpdated;
+    }
     os << rowsUpdated << " row(s) updated." << std::endl;
 }
 
@@ -198,25 +962,79 @@ SQLAir::deleteQuery(CSV& csv, bool mustWait, const int whereColIdx,
 // Convenience helper method to return the CSV object for a given
 // file or URL.
 CSV& SQLAir::loadAndGet(std::string fileOrURL) {
-    // Check if the specified fileOrURL is already loaded in a thread-safe
-    // manner to avoid race conditions on the unordered_map
-    {
-        std::lock_guard<std::mutex> guard(recentCSVMutex);
-        // Use recent CSV if parameter was empty string.
-        fileOrURL = (fileOrURL.empty() ? recentCSV : fileOrURL);
-        // Update the most recently used CSV for the next round
+    QueryStats::Timer timer(QueryStats::Load);
+    // Use recent CSV if parameter was empty string.
+    fileOrURL = (fileOrURL.empty() ? getRecentCSV() : fileOrURL);
+    // Check if the specified fileOrURL is already loaded. The catalog is
+    // read without locks, so queries do not wait for each other here.
+    Catalog::Table* table = catalog.find(fileOrURL);
+    if (table != nullptr) {
+        metrics.add(Metrics::CacheHits);
+    } else {
+        metrics.add(Metrics::CacheMisses);
+        table = &load(fileOrURL);
+    }
+    // Update the most recently used CSV for the next round. The shared
+    // value is written only when it changes, as all threads read it.
+    std::string& recentCSV = Session::current().recentCSV;
+    if (recentCSV != fileOrURL) {
         recentCSV = fileOrURL;
-        if (inMemoryCSV.find(fileOrURL) != inMemoryCSV.end()) {
-            // Requested CSV is already in memory. Just return it.
-            return inMemoryCSV.at(fileOrURL);
-        }
     }
-    // When control drops here, we need to load the CSV into memory.
+    if (recentTable.load(std::memory_order_relaxed) != table) {
+        recentTable.store(table, std::memory_order_release);
+    }
+    return table->csv;
+}
+
+// Load a CSV that is not in the catalog and add it to the catalog.
+Catalog::Table&
+SQLAir::load(const std::string& fileOrURL) {
     // Loading or I/O is being done outside critical sections
-    CSV csv;   // Load data into this csv
+    std::unique_ptr<Catalog::Table> table(new Catalog::Table());
+    table->name = fileOrURL;
+    CSV& csv = table->csv;   // Load data into this csv
+    // A read replica copies the table from its primary. Changes to the
+    // table are not applied until it is added to the catalog below.
+    std::unique_lock<std::mutex> following;
+    if (replica != nullptr) {
+        following = replica->snapshot(fileOrURL, csv);
+    } else if (lazyColumns && shard.count == 0 &&
+               fileOrURL.find("http://") != 0) {
+        // Only the offsets of the fields are recorded. The columns are
+        // loaded as queries use them, see loadColumns.
+        std::ifstream data(fileOrURL, std::ios::binary);
+        table->lazy.reset(new LazyColumns());
+        table->lazy->load(data, csv);
+    } else {
+        readCSV(csv, fileOrURL);
+    }
+    // A shard keeps only the rows that it owns.
+    shard.filter(csv);
+    
+    // Dictionary encode low-cardinality columns before the CSV is shared.
+    table->dict.reset(new Dictionary());
+    table->dict->encode(csv, table->lazy != nullptr);
+    table->versions.reset(new TableVersions(csv.size()));
+    table->zones.reset(new ZoneMap(csv.getColumnCount()));
+    table->dict->track(*table->zones);
+    table->trigrams.reset(new TrigramIndex(csv.getColumnCount()));
+    table->dict->track(*table->trigrams);
+    table->waiters.reset(new WaitList());
+    table->stats.reset(new TableStats());
+    table->dict->track(*table->stats);
+
+    // We get to this line of code only if the above if-else to load the
+    // CSV did not throw any exceptions. In this case we have a valid CSV
+    // to add to the catalog. If another thread loaded the same CSV
+    // meanwhile, we use that one.
+    return catalog.add(std::move(table));
+}
+
+// Read the rows of a file or an URL with the CSV loader.
+void
+SQLAir::readCSV(CSV& csv, const std::string& fileOrURL) {
     if (fileOrURL.find("http://") == 0) {
         // This is an URL. We have to get the stream from a web-server
-        // Implement this feature.
         std::string host, port, path;
         std::tie(host, port, path) = Helper::breakDownURL(fileOrURL);
         // Use helper method to load the data from a given URL. The method
@@ -228,27 +1046,559 @@ CSV& SQLAir::loadAndGet(std::string fileOrURL) {
         // This method may throw exceptions on errors.
         csv.load(data);
     }
-    
-    // We get to this line of code only if the above if-else to load the
-    // CSV did not throw any exceptions. In this case we have a valid CSV
-    // to add to our inMemoryCSV list. We need to do that in a thread-safe
-    // manner.
-    std::lock_guard<std::mutex> guard(recentCSVMutex);
-    // Move (instead of copy) the CSV data into our in-memory CSVs
-    inMemoryCSV[fileOrURL].move(csv);
-    // Return a reference to the in-memory CSV (not temporary one)
-    return inMemoryCSV.at(fileOrURL);
+}
+
+// Load the columns of a lazily loaded CSV that are named in a query.
+void
+SQLAir::loadColumns(CSV& csv, const StrVec& tokens, const std::string& name) {
+    Catalog::Table& table = catalog.of(csv);
+    if (table.lazy == nullptr) {
+        return;  // All the columns were loaded with the CSV.
+    }
+    QueryStats::Timer timer(QueryStats::Load);
+    const StrVec colNames = csv.getColumnNames();
+    const std::string prefix = (name.empty() ? "" : name + ".");
+    for (const auto& token : tokens) {
+        // The operands of an expression may be in one token, such as
+        // "raters-1". So the parts of a token (split as Expression does)
+        // are also checked.
+        StrVec parts = {token};
+        for (size_t start = 0, end; (start < token.size()); start = end + 1) {
+            end = std::min(token.find_first_of(Expression::Operators, start),
+                           token.size());
+            if (end > start && (start > 0 || end < token.size())) {
+                parts.push_back(token.substr(start, end - start));
+            }
+        }
+        for (size_t col = 0; (col < colNames.size()); col++) {
+            const bool used = std::any_of(parts.begin(), parts.end(),
+                [&](const std::string& part) {
+                    return part == "*" || part == colNames[col] ||
+                        (!prefix.empty() && part == prefix + colNames[col]);
+                });
+            if (used) {
+                table.lazy->loadColumn(csv, *table.dict, col);
+            }
+        }
+    }
+}
+
+// Return the recent CSV of the session (or of any query, if the session
+// has not used a table yet).
+std::string
+SQLAir::getRecentCSV() const {
+    const std::string& recentCSV = Session::current().recentCSV;
+    if (!recentCSV.empty()) {
+        return recentCSV;
+    }
+    const Catalog::Table* const table = recentTable.load(
+        std::memory_order_acquire);
+    return (table != nullptr ? table->name : "");
+}
+
+// Return the dictionary for a CSV that was loaded by loadAndGet.
+Dictionary&
+SQLAir::getDictionary(const CSV& csv) {
+    return *catalog.of(csv).dict;
+}
+
+// Return the row versions for a CSV that was loaded by loadAndGet.
+TableVersions&
+SQLAir::getVersions(const CSV& csv) {
+    return *catalog.of(csv).versions;
+}
+
+// Return the zone maps for a CSV that was loaded by loadAndGet.
+ZoneMap&
+SQLAir::getZones(const CSV& csv) {
+    return *catalog.of(csv).zones;
+}
+
+// Return the trigram indexes for a CSV that was loaded by loadAndGet.
+TrigramIndex&
+SQLAir::getTrigrams(const CSV& csv) {
+    return *catalog.of(csv).trigrams;
+}
+
+// Return the statistics for a CSV that was loaded by loadAndGet.
+TableStats&
+SQLAir::getStats(const CSV& csv) {
+    return *catalog.of(csv).stats;
+}
+
+// Return the wait queries waiting for a CSV loaded by loadAndGet.
+WaitList&
+SQLAir::getWaiters(const CSV& csv) {
+    return *catalog.of(csv).waiters;
+}
+
+// Return a shared lock on the rows of a CSV that was loaded by loadAndGet.
+std::shared_lock<std::shared_timed_mutex>
+SQLAir::readRows(const CSV& csv) {
+    if (Catalog::Locked::holds(csv)) {
+        return {};  // Held for the statements of a batch.
+    }
+    QueryStats::Timer timer(QueryStats::LockWait);
+    return std::shared_lock<std::shared_timed_mutex>(
+        catalog.of(csv).rowsMutex);
+}
+
+// Return an exclusive lock on the rows of a CSV that was loaded by
+// loadAndGet, unless it is held for the statements of a batch.
+std::unique_lock<std::shared_timed_mutex>
+SQLAir::writeRows(const CSV& csv) {
+    if (Catalog::Locked::holds(csv)) {
+        return {};
+    }
+    QueryStats::Timer timer(QueryStats::LockWait);
+    Metrics::LockTimer lockTimer(metrics, csv);
+    return std::unique_lock<std::shared_timed_mutex>(
+        catalog.of(csv).rowsMutex);
+}
+
+// Return the lock on a CSV, unless it is held for the statements of a batch.
+std::unique_lock<std::mutex>
+SQLAir::lockTable(CSV& csv) {
+    if (Catalog::Locked::holds(csv)) {
+        return {};
+    }
+    QueryStats::Timer timer(QueryStats::LockWait);
+    Metrics::LockTimer lockTimer(metrics, csv);
+    return std::unique_lock<std::mutex>(csv.csvMutex);
+}
+
+// Return the name of a CSV that was loaded by loadAndGet.
+std::string
+SQLAir::tableName(const CSV& csv) {
+    return catalog.of(csv).name;
+}
+
+// Return the current session's transaction state for a CSV, if any.
+Transaction::Table*
+SQLAir::txnTable(CSV& csv) {
+    Transaction* const txn = Session::current().txn.get();
+    if (txn == nullptr) {
+        return nullptr;
+    }
+    return &txn->use(csv, getDictionary(csv), getVersions(csv));
+}
+
+// Create a trigram index with "create trigram index on a.csv (col)".
+void
+SQLAir::createIndexQuery(const StrVec& sql, std::ostream& os) {
+    if (sql.size() != 8 || sql[1] != "trigram" || sql[2] != "index" ||
+        sql[3] != "on" || sql[5] != "(" || sql[7] != ")") {
+        throw Exp("Index must be of the form: create trigram index on a.csv "
+                  "(col)");
+    }
+    CSV& csv = loadAndGet(sql[4]);
+    const int col = csv.getColumnIndex(sql[6]);
+    if (col == -1) {
+        throw Exp("Column " + sql[6] + " not found in CSV");
+    }
+    loadColumns(csv, {sql[6]});
+    size_t trigrams;
+    {
+        // The values must not change while the index is built.
+        Metrics::LockTimer lockTimer(metrics, csv);
+        std::lock_guard<std::mutex> guard(csv.csvMutex);
+        trigrams = getTrigrams(csv).create(csv, getDictionary(csv), col);
+    }
+    os << "Trigram index on " << sql[6] << " has " << trigrams
+       << " trigrams.\n";
+}
+
+// Append the rows of a file to a table with "copy into a.csv from 'b.csv'".
+void
+SQLAir::copyQuery(const StrVec& sql, std::ostream& os) {
+    if (sql.size() != 5 || sql[1] != "into" || sql[3] != "from") {
+        throw Exp("Copy must be of the form: copy into a.csv from 'b.csv'");
+    }
+    if (shard.count > 0 || replica != nullptr || changeLog.active()) {
+        throw Exp("copy into is not supported with shards or read "
+                  "replicas.");
+    }
+    if (Session::current().txn != nullptr) {
+        throw Exp("copy into is not supported in a transaction.");
+    }
+    const auto startTime = std::chrono::steady_clock::now();
+    CSV& csv = loadAndGet(sql[2]);
+    loadColumns(csv, {"*"});
+    // Parse the rows before taking any locks.
+    CSV rows;
+    readCSV(rows, sql[4]);
+    const StrVec colNames = rows.getColumnNames();
+    std::vector<int> colIdxs;
+    for (const auto& colName : colNames) {
+        colIdxs.push_back(csv.getColumnIndex(colName));
+        if (colIdxs.back() == -1) {
+            throw Exp("Column " + colName + " not found in " + sql[2]);
+        }
+    }
+    const bool sameCols = (colNames == csv.getColumnNames());
+    Catalog::Table& table = catalog.of(csv);
+    {
+        // Appending may move the rows in memory. So scans (and updates,
+        // via the lock on the CSV) are kept out until it is done.
+        QueryStats::Timer timer(QueryStats::LockWait);
+        Metrics::LockTimer lockTimer(metrics, csv);
+        std::unique_lock<std::shared_timed_mutex> rowsLock(table.rowsMutex);
+        std::lock_guard<std::mutex> guard(csv.csvMutex);
+        // A follower may have subscribed to the change log (which it does
+        // while holding the lock on a table) since the check above. The
+        // appended rows would then never reach it.
+        if (changeLog.active()) {
+            throw Exp("copy into is not supported with shards or read "
+                      "replicas.");
+        }
+        const size_t firstRow = csv.size();
+        csv.reserve(firstRow + rows.size());
+        for (auto& row : rows) {
+            if (sameCols) {
+                csv.push_back(std::move(row));
+                continue;
+            }
+            // Missing columns are left empty.
+            CSVRow reordered;
+            reordered.resize(csv.getColumnCount());
+            for (size_t col = 0; (col < row.size() && col < colIdxs.size());
+                 col++) {
+                reordered[colIdxs[col]] = std::move(row[col]);
+            }
+            csv.push_back(std::move(reordered));
+        }
+        // Encode and index the new rows in bulk, rather than row by row.
+        table.dict->append(csv, firstRow);
+        table.versions->grow(csv.size());
+        TableVersions::Writer writer(*table.versions);
+        for (size_t rowIdx = firstRow; (rowIdx < csv.size()); rowIdx++) {
+            writer.bump(rowIdx);
+        }
+        table.zones->extend(csv, *table.dict, firstRow);
+        table.trigrams->extend(csv, *table.dict, firstRow);
+        table.stats->changed(rows.size());
+    }
+    if (!rows.empty()) {
+        table.waiters->wake();
+    }
+    const double secs = std::max(elapsedMicros(startTime), uint64_t(1)) / 1e6;
+    std::ostringstream took;
+    took << std::fixed << std::setprecision(3) << secs;
+    os << rows.size() << " row(s) copied into " << sql[2] << " in "
+       << took.str() << " seconds (" << uint64_t(rows.size() / secs)
+       << " rows/sec).\n";
+}
+
+// Collect the statistics on a table with "analyze a.csv".
+void
+SQLAir::analyzeQuery(const StrVec& sql, std::ostream& os) {
+    if (sql.size() != 2) {
+        throw Exp("Analyze must be of the form: analyze a.csv");
+    }
+    CSV& csv = loadAndGet(sql[1]);
+    loadColumns(csv, {"*"});
+    TableStats& stats = getStats(csv);
+    size_t numRows;
+    {
+        const auto rowsLock = readRows(csv);
+        QueryStats::Timer timer(QueryStats::Scan);
+        stats.analyze(csv, getDictionary(csv));
+        numRows = csv.size();
+    }
+    // Summarize the statistics of each column.
+    os << "column\tdistinct\tmost_common\trange\n";
+    const StrVec colNames = csv.getColumnNames();
+    for (size_t col = 0; (col < colNames.size()); col++) {
+        const ColumnStats colStats = stats.column(col);
+        os << colNames[col] << '\t' << std::llround(colStats.distinct)
+           << '\t';
+        if (!colStats.mcvs.empty()) {
+            os << colStats.mcvs.front().first << " (" << std::fixed
+               << std::setprecision(1) << colStats.mcvs.front().second * 100
+               << "%)";
+        }
+        os << '\t';
+        if (!colStats.bounds.empty()) {
+            os << colStats.bounds.front() << " .. " << colStats.bounds.back();
+        }
+        os << '\n';
+    }
+    os << numRows << " row(s) of " << sql[1] << " analyzed.\n";
+}
+
+// Process the statements that declare, fetch from, or close a cursor.
+void
+SQLAir::cursorQuery(const StrVec& sql, bool mustWait, std::ostream& os) {
+    if (mustWait) {
+        throw Exp("wait is not supported for cursors.");
+    }
+    if (coordinator != nullptr) {
+        throw Exp("Cursors are not supported with shards.");
+    }
+    Session& session = Session::current();
+    if (session.txn != nullptr) {
+        throw Exp("Cursors are not supported in a transaction.");
+    }
+    // Close the cursors that have been idle for too long.
+    const auto now = std::chrono::steady_clock::now();
+    for (auto entry = session.cursors.begin();
+         (entry != session.cursors.end());) {
+        if (now - entry->second->lastUsed >
+            std::chrono::seconds(CursorTimeout)) {
+            entry = session.cursors.erase(entry);
+        } else {
+            entry++;
+        }
+    }
+    if (sql.front() == "declare") {
+        declareQuery(sql, os);
+    } else if (sql.front() == "fetch") {
+        fetchQuery(sql, os);
+    } else if (sql.size() != 2) {
+        throw Exp("Close must be of the form: close c");
+    } else if (session.cursors.erase(sql[1]) == 0) {
+        throw Exp("Cursor " + sql[1] + " not found");
+    } else {
+        os << "Cursor " << sql[1] << " closed.\n";
+    }
+}
+
+// Declare a cursor with "declare c cursor for select ...".
+void
+SQLAir::declareQuery(const StrVec& sql, std::ostream& os) {
+    if (sql.size() < 5 || sql[2] != "cursor" || sql[3] != "for" ||
+        sql[4] != "select") {
+        throw Exp("Declare must be of the form: declare c cursor for "
+                  "select ...");
+    }
+    const StrVec query(sql.begin() + 4, sql.end());
+    if (Helper::find(query, "join") != -1 || !streamedFile(query).empty()) {
+        throw Exp("A cursor must select from a single table.");
+    }
+    auto& cursors = Session::current().cursors;
+    const std::string& name = sql[1];
+    if (cursors.count(name) != 0) {
+        throw Exp("Cursor " + name + " already exists.");
+    }
+    if (cursors.size() >= MaxCursors) {
+        throw Exp("Too many cursors (at most " + std::to_string(MaxCursors) +
+                  "). Close one first.");
+    }
+    StrVec colNames = Helper::getSelectColNames(query);
+    CSV& csv = loadAndGet(Helper::getCSVInfo(query, "from"));
+    loadColumns(csv, query);
+    checkColNames(csv, colNames);
+    if (colNames.size() == 1 && colNames.front() == "*") {
+        colNames = csv.getColumnNames();
+    }
+    auto where = getWhere(csv, query);
+    // The snapshot is taken while holding the lock, when no change to the
+    // table is in progress.
+    const auto rowsLock = readRows(csv);
+    const auto lock = lockTable(csv);
+    const Dictionary& dict = getDictionary(csv);
+    ZoneMap* zones = nullptr;
+    if (where != nullptr) {
+        where->bind(0, csv, dict);
+        zones = &getZones(csv);
+        zones->build(csv, dict, *where);
+    }
+    cursors[name].reset(new Cursor(name, tableName(csv), csv, colNames,
+        std::move(where), zones, &getTrigrams(csv), getVersions(csv).table()));
+    os << "Cursor " << name << " declared.\n";
+}
+
+// Return the next rows of a cursor with "fetch n from c".
+void
+SQLAir::fetchQuery(const StrVec& sql, std::ostream& os) {
+    if (sql.size() != 4 || sql[2] != "from") {
+        throw Exp("Fetch must be of the form: fetch 100 from c");
+    }
+    long count = 0;
+    if (!(std::istringstream(sql[1]) >> count) || count <= 0) {
+        throw Exp("Invalid fetch count " + sql[1] +
+                  " (expected a number > 0)");
+    }
+    auto& cursors = Session::current().cursors;
+    const auto entry = cursors.find(sql[3]);
+    if (entry == cursors.end()) {
+        throw Exp("Cursor " + sql[3] + " not found");
+    }
+    Cursor& cursor = *entry->second;
+    cursor.lastUsed = std::chrono::steady_clock::now();
+    CSV& csv = cursor.csv;
+    StrVec values;
+    bool atEnd = false;
+    try {
+        const auto rowsLock = readRows(csv);
+        const auto lock = lockTable(csv);
+        QueryStats::Timer timer(QueryStats::Scan);
+        const Dictionary& dict = getDictionary(csv);
+        const TableVersions& versions = getVersions(csv);
+        if (cursor.where != nullptr) {
+            cursor.where->bind(0, csv, dict);
+        }
+        for (long numRows = 0; (numRows < count); numRows++) {
+            const size_t rowIdx = cursor.next(versions);
+            if (rowIdx >= cursor.size()) {
+                break;
+            }
+            const CSVRow& row = csv[rowIdx];
+            for (const int colIdx : cursor.colIdxs) {
+                values.push_back(dict.get(row, rowIdx, colIdx));
+            }
+        }
+        atEnd = cursor.atEnd();
+    } catch (const std::exception&) {
+        cursors.erase(entry);  // An out of date cursor is of no further use.
+        throw;
+    }
+    // The rows are written out after releasing the locks, as binary
+    // protocol clients get them via their sockets.
+    QueryStats::Timer timer(QueryStats::Format);
+    BatchSink* const sink = BatchSink::current();
+    const size_t numCols = cursor.colIdxs.size();
+    const size_t numFetched = values.size() / numCols;
+    if (numFetched > 0 && sink != nullptr) {
+        sink->start(cursor.colNames);
+    } else if (numFetched > 0) {
+        os << cursor.colNames << std::endl;
+    }
+    for (size_t i = 0; (i < values.size()); i++) {
+        const bool rowEnd = ((i + 1) % numCols == 0);
+        if (sink != nullptr) {
+            sink->add(values[i]);
+            if (rowEnd) {
+                sink->endRow();
+            }
+        } else {
+            os << values[i] << (rowEnd ? '\n' : '\t');
+        }
+    }
+    os << numFetched << " row(s) fetched.";
+    if (atEnd) {
+        os << " No more rows in cursor " << cursor.name << ".";
+    }
+    os << '\n';
+}
+
+// Process the statements that begin, commit, or rollback a transaction.
+void
+SQLAir::transactionQuery(const std::string& stmt, std::ostream& os) {
+    Session& session = Session::current();
+    if (stmt == "begin") {
+        if (session.txn != nullptr) {
+            throw Exp("A transaction is already in progress.");
+        }
+        session.txn.reset(new Transaction());
+        os << "Transaction started.\n";
+        return;
+    }
+    if (session.txn == nullptr) {
+        throw Exp("No transaction in progress.");
+    }
+    // The transaction ends here, whether it commits or not.
+    const std::unique_ptr<Transaction> txn = std::move(session.txn);
+    if (stmt == "rollback") {
+        os << "Transaction rolled back.\n";
+        return;
+    }
+    // Lock the tables (in a fixed order to avoid deadlocks with other
+    // commits) just to validate and apply the changes.
+    std::vector<CSV*> tables;
+    for (const auto& tbl : txn->tables()) {
+        tables.push_back(&tbl->csv);
+    }
+    std::sort(tables.begin(), tables.end());
+    std::vector<std::unique_lock<std::shared_timed_mutex>> writeLocks;
+    for (CSV* csv : tables) {
+        writeLocks.push_back(writeRows(*csv));
+    }
+    std::vector<std::unique_lock<std::mutex>> locks;
+    for (CSV* csv : tables) {
+        locks.push_back(lockTable(*csv));
+    }
+    if (!txn->validate()) {
+        throw Exp("Transaction aborted due to a conflicting change by "
+                  "another session.");
+    }
+    const int rowsUpdated = txn->apply();
+    logCommit(*txn);
+    locks.clear();
+    writeLocks.clear();
+    // Let waiting queries check the changes.
+    for (CSV* csv : tables) {
+        getWaiters(*csv).wake();
+    }
+    os << "Transaction committed. " << rowsUpdated << " row(s) updated.\n";
+}
+
+// Add the writes of a committed transaction to the change log as one
+// record, so that read replicas apply all of them together.
+void
+SQLAir::logCommit(const Transaction& txn) {
+    if (!changeLog.active()) {
+        return;  // No read replicas.
+    }
+    std::vector<ChangeRecord::Cell> changes;
+    for (const auto& tbl : txn.tables()) {
+        const std::string table = tableName(tbl->csv);
+        for (const auto& write : tbl->getWrites()) {
+            for (const auto& colVal : write.second) {
+                changes.push_back({table, static_cast<uint32_t>(write.first),
+                    static_cast<uint16_t>(colVal.first), colVal.second});
+            }
+        }
+    }
+    if (!changes.empty()) {
+        changeLog.append(changes);
+    }
 }
 
 // Save the currently loaded CSV file to a local file.
 void 
 SQLAir::saveQuery(std::ostream& os) {
+    if (shard.count > 0) {
+        throw Exp("save is not supported on a shard, as it does not have "
+                  "all the rows.");
+    }
+    if (replica != nullptr) {
+        throw Exp("save is not supported on a read replica. Send it to the "
+                  "primary.");
+    }
+    const std::string recentCSV = getRecentCSV();
     if (recentCSV.empty() || recentCSV.find("http://") == 0) {
         throw Exp("Saving CSV to an URL using POST is not implemented");
     }
-    // Create a local file and have the CSV write itself.
+    Catalog::Table* const table = catalog.find(recentCSV);
+    if (table == nullptr) {
+        throw Exp("Table " + recentCSV + " is not loaded.");
+    }
+    CSV& csv = table->csv;
+    loadColumns(csv, {"*"});
+    // Write the values (quoted, as CSV::save does) to a local file. The
+    // values of dictionary encoded columns are read via the dictionary,
+    // as the rows are not changed while other threads read them.
     std::ofstream csvData(recentCSV);
-    inMemoryCSV.at(recentCSV).save(csvData);
+    const auto rowsLock = readRows(csv);
+    const Dictionary& dict = getDictionary(csv);
+    const StrVec colNames = csv.getColumnNames();
+    std::string delim;
+    for (const auto& colName : colNames) {
+        csvData << delim << '"' << colName << '"';
+        delim = ",";
+    }
+    csvData << '\n';
+    for (size_t rowIdx = 0; (rowIdx < csv.size()); rowIdx++) {
+        for (size_t col = 0; (col < colNames.size()); col++) {
+            csvData << (col > 0 ? ",\"" : "\"")
+                    << dict.get(csv[rowIdx], rowIdx, col) << '"';
+        }
+        csvData << '\n';
+    }
+    if (!csvData) {
+        throw Exp("Unable to write " + recentCSV);
+    }
     os << recentCSV << " saved.\n";
 }
 
@@ -262,55 +1612,773 @@ using namespace boost::asio::ip;
 // HTTP request from a web-client
 void
 SQLAir::clientThread(TcpStreamPtr client) {
+    // A client that is slow to send its request (or never does) is dropped
+    // after a while, rather than keeping this thread forever.
+    client->expires_after(std::chrono::seconds(RequestTimeout));
     // Extract the SQL query from the first line for processing
-    std::string req;
-    *client >> req >> req;
+    std::string line, method, req;
+    std::getline(*client, line);
+    std::istringstream(line) >> method >> req;
+    long bytesIn = line.size() + 1;
     // Skip over all the HTTP request headers. Without this loop the 
     // web-server will not operate correctly with all the web-browsers
+    const std::string etagHeader = "if-none-match:";
+    const std::string lengthHeader = "content-length:";
+    std::string ifNoneMatch;
+    size_t bodySize = 0;
     for (std::string hdr; (std::getline(*client, hdr) && !hdr.empty() &&
-            hdr != "\r");) {}
-    
+            hdr != "\r");) {
+        bytesIn += hdr.size() + 1;
+        // Note the entity tag of a file that the browser has cached.
+        if (strncasecmp(hdr.c_str(), etagHeader.c_str(),
+                        etagHeader.size()) == 0) {
+            ifNoneMatch = Helper::trim(hdr.substr(etagHeader.size()), "\r");
+        } else if (strncasecmp(hdr.c_str(), lengthHeader.c_str(),
+                               lengthHeader.size()) == 0) {
+            bodySize = std::strtoul(hdr.c_str() + lengthHeader.size(),
+                                    nullptr, 10);
+        }
+    }
     // URL-decode the request to translate special/encoded characters
     req = Helper::url_decode(req);
+    if (method == "POST") {
+        // The statements (such as a large batch) may be sent in the body
+        // of a POST request instead, with just the session in the URL.
+        if (bodySize > MaxBodySize) {
+            OutputBuffer& os = OutputBuffer::forThread();
+            os << "Error: The request is too large (over " << MaxBodySize
+               << " bytes).\n";
+            sendResponse(*client, os);
+            return;
+        }
+        std::string body(bodySize, '\0');
+        client->read(&body[0], bodySize);
+        bytesIn += client->gcount();
+        body.resize(client->gcount());
+        if (!*client) {
+            return;  // The client went away or timed out.
+        }
+        const size_t paramsPos = req.find('?');
+        req = req.substr(0, paramsPos) + "?query=" + body +
+            (paramsPos == std::string::npos ? "" :
+             "&" + req.substr(paramsPos + 1));
+    }
+    metrics.add(Metrics::BytesIn, bytesIn);
+    if (!*client) {
+        return;  // The client went away or timed out.
+    }
+    // Queries may run for longer than the time to read the request.
+    client->expires_at(std::chrono::steady_clock::time_point::max());
+    // A web-client may send a session ID to use a session (for example,
+    // for a transaction) across requests.
+    std::shared_ptr<Session> session;
+    const std::string sessionParam = "&session=";
+    const size_t sessionPos = req.rfind(sessionParam);
+    if (sessionPos != std::string::npos) {
+        session = getSession(req.substr(sessionPos + sessionParam.size()));
+        req.erase(sessionPos);
+    }
     // Check and do the necessary processing based on type of request
     const std::string prefix = "/sql-air?query=";
-    if (req.find(prefix) != 0) {
-        // This is request for a data file. So send the data file out.
-        *client << http::file("./" + req);
+    if (req == "/metrics") {
+        // Report the metrics in Prometheus text format.
+        OutputBuffer& os = OutputBuffer::forThread();
+        printMetrics(os);
+        sendResponse(*client, os);
+    } else if (req.find(prefix) != 0) {
+        // This is request for a data file. So send the data file out
+        // directly to the socket (ignoring any query string).
+        client->flush();
+        const std::string path = "./" + req.substr(0, req.find('?'));
+        metrics.add(Metrics::BytesOut, staticFiles.send(
+            client->socket().native_handle(), path, ifNoneMatch));
     } else {
         // This is a sql-air query. Let's have the helper method do the 
         // processing for us
-        std::ostringstream os;
+        const StrVec stmts = splitBatch(req.substr(prefix.size()));
+        if (stmts.size() > 1) {
+            batchRequest(client, session, stmts);
+            return;
+        }
+        const std::string sql = (stmts.empty() ? "" : stmts.front());
+        StrVec tokens;
+        bool mustWait = false;
         try {
-            std::string sql = Helper::trim(req.substr(prefix.size()));
-            if (sql.back() == ';') {
-                sql.pop_back();  // Remove trailing semicolon.
-            }
-            process(sql, os);
+            int cmd;
+            std::tie(tokens, mustWait, cmd) = preprocess(sql);
         } catch (const std::exception &exp) {
+            OutputBuffer& os = OutputBuffer::forThread();
             os << "Error: " << exp.what() << std::endl;
+            sendResponse(*client, os);
+            return;
+        }
+        // Let cheaper requests that are waiting run first.
+        const auto startTime = std::chrono::steady_clock::now();
+        admit(queryPriority(tokens, mustWait), client, [this, client,
+                session, sql, tokens, mustWait, startTime] {
+            queryResponse(client, session, sql, tokens, mustWait, startTime);
+        });
+    }
+}
+
+// Run a sql-air query from a web-client and send the results back.
+void
+SQLAir::queryResponse(TcpStreamPtr client, std::shared_ptr<Session> session,
+        const std::string& sql, const StrVec& tokens, bool mustWait,
+        std::chrono::steady_clock::time_point startTime) {
+    OutputBuffer& buffer = OutputBuffer::forThread();
+    // The results of a stream() scan may not fit in memory. So they are
+    // sent as they are found, and the end of the response is marked by
+    // closing the connection (instead of a Content-Length).
+    const bool streaming = !streamedFile(tokens).empty();
+    std::ostream& os = (streaming ? static_cast<std::ostream&>(*client) :
+                        buffer);
+    if (streaming) {
+        *client << HTTPRespHeader.substr(0, HTTPRespHeader.find(
+                       "Content-Length")) << "\r\n";
+    }
+    // Without a session ID, the query uses a session just for itself.
+    Session oneShot;
+    Session::Use use(session != nullptr ? *session : oneShot);
+    try {
+        run(sql, tokens, mustWait, os, startTime, !streaming);
+    } catch (const WaitList::Parked& parked) {
+        // Run the query again (from the start) once the table changes. The
+        // response is sent then, so this thread is free meanwhile.
+        parked.list->park(parked.generation, parked.deadline, [this,
+                client, session, sql, tokens, mustWait, startTime] {
+            admit(AdmissionQueue::Wait, client, [this, client, session, sql,
+                                                 tokens, mustWait, startTime] {
+                queryResponse(client, session, sql, tokens, mustWait,
+                              startTime);
+            }, true);
+        });
+        return;
+    } catch (const std::exception &exp) {
+        os << "Error: " << exp.what() << std::endl;
+    }
+    // Send HTTP response back to the client.
+    if (!streaming) {
+        sendResponse(*client, buffer);
+    }
+}
+
+// Split the text of a request into its statements, at the semicolons that
+// are not in quoted values.
+StrVec
+SQLAir::splitBatch(const std::string& sql) {
+    StrVec stmts;
+    char quote = '\0';
+    size_t start = 0;
+    for (size_t i = 0; (i <= sql.size()); i++) {
+        if (i < sql.size() && quote != '\0') {
+            quote = (sql[i] == quote ? '\0' : quote);
+        } else if (i < sql.size() && (sql[i] == '\'' || sql[i] == '"')) {
+            quote = sql[i];
+        } else if (i == sql.size() || sql[i] == ';') {
+            const std::string stmt = Helper::trim(sql.substr(start,
+                                                             i - start));
+            if (!stmt.empty()) {
+                stmts.push_back(stmt);
+            }
+            start = i + 1;
+        }
+    }
+    return stmts;
+}
+
+// Tokenize the statements of a batch and queue them to be run together.
+void
+SQLAir::batchRequest(TcpStreamPtr client, std::shared_ptr<Session> session,
+        const StrVec& stmts) {
+    std::vector<PreparedStatement> batch(stmts.size());
+    // The batch is queued at the lowest priority of its statements.
+    auto priority = AdmissionQueue::Interactive;
+    try {
+        for (size_t i = 0; (i < stmts.size()); i++) {
+            int cmd;
+            batch[i].sql = stmts[i];
+            std::tie(batch[i].tokens, batch[i].mustWait, cmd) =
+                preprocess(stmts[i]);
+            // A wait query would have to wait in the worker running the
+            // batch (as the statements after it must not run before it).
+            if (batch[i].mustWait) {
+                throw Exp("wait queries are not supported in a batch.");
+            }
+            priority = std::max(priority, queryPriority(batch[i].tokens,
+                                                        false));
+        }
+    } catch (const std::exception &exp) {
+        // None of the statements are run if any of them is invalid.
+        OutputBuffer& os = OutputBuffer::forThread();
+        os << "Error: " << exp.what() << std::endl;
+        sendResponse(*client, os);
+        return;
+    }
+    const auto task = [this, client, session, batch] {
+        OutputBuffer& os = OutputBuffer::forThread();
+        // Without a session ID, the batch uses a session just for itself.
+        Session oneShot;
+        Session::Use use(session != nullptr ? *session : oneShot);
+        runBatch(batch, os);
+        sendResponse(*client, os);
+    };
+    admit(priority, client, task);
+}
+
+// Run the statements of a batch in order, writing their results one after
+// another. An error in one statement does not stop the others.
+void
+SQLAir::runBatch(const std::vector<PreparedStatement>& batch,
+        std::ostream& os) {
+    size_t end = 0;
+    for (size_t start = 0; (start < batch.size()); start = end) {
+        // Consecutive statements on the same table are run while holding
+        // the locks on the table, which are then taken just once.
+        const std::string table = batchTable(batch[start]);
+        for (end = start + 1; (end < batch.size() && !table.empty() &&
+                               batchTable(batch[end]) == table); end++) {
+        }
+        std::unique_lock<std::shared_timed_mutex> writeLock;
+        std::unique_lock<std::mutex> lock;
+        std::unique_ptr<Catalog::Locked> locked;
+        if (end - start > 1) {
+            try {
+                CSV& csv = loadAndGet(table);
+                writeLock = writeRows(csv);
+                lock = lockTable(csv);
+                locked.reset(new Catalog::Locked(csv));
+            } catch (const std::exception&) {
+                // The statements are run (and report the error) one by one.
+            }
+        }
+        for (size_t i = start; (i < end); i++) {
+            const auto startTime = std::chrono::steady_clock::now();
+            try {
+                run(batch[i].sql, batch[i].tokens, false, os, startTime);
+            } catch (const std::exception &exp) {
+                os << "Error: " << exp.what() << std::endl;
+            }
+        }
+    }
+}
+
+// Return the table of a statement that can be grouped with the statements
+// on the same table in a batch, or an empty string if it cannot.
+std::string
+SQLAir::batchTable(const PreparedStatement& stmt) {
+    const StrVec& tokens = stmt.tokens;
+    // Transactions, joins, stream() scans, and shards lock tables in their
+    // own ways.
+    if (tokens.size() < 2 || coordinator != nullptr ||
+        Session::current().txn != nullptr ||
+        Helper::find(tokens, "join") != -1 || !streamedFile(tokens).empty()) {
+        return "";
+    }
+    const int fromIdx = Helper::find(tokens, "from");
+    if (tokens.front() == "update" && tokens[1] != "set") {
+        return tokens[1];
+    } else if (tokens.front() == "select" && fromIdx != -1 &&
+               fromIdx + 1 < (int) tokens.size()) {
+        return tokens[fromIdx + 1];
+    }
+    return "";
+}
+
+// Queue a request for a worker thread, or reject it if the server is
+// overloaded.
+void
+SQLAir::admit(AdmissionQueue::Priority priority, TcpStreamPtr client,
+        AdmissionQueue::Task task, bool resumed) {
+    const auto body = [this, task] {
+        metrics.add(Metrics::ConnActive);
+        task();
+        metrics.add(Metrics::ConnActive, -1);
+    };
+    const auto run = [this, body] {
+        metrics.add(Metrics::ConnQueued, -1);
+        body();
+    };
+    const auto reject = [this, client] {
+        metrics.add(Metrics::ConnQueued, -1);
+        rejectRequest(*client);
+    };
+    metrics.add(Metrics::ConnQueued);
+    if (!admission.push(priority, run, reject, resumed)) {
+        metrics.add(Metrics::ConnQueued, -1);
+        rejectRequest(*client);
+    }
+}
+
+// Tell a client to retry a request that was not run.
+void
+SQLAir::rejectRequest(tcp::iostream& client) {
+    const std::string msg = "Error: Server is overloaded. Try again later.\n";
+    const std::string header = "HTTP/1.1 503 Service Unavailable\r\n"
+        "Server: localhost\r\n"
+        "Connection: Close\r\n"
+        "Retry-After: 1\r\n"
+        "Content-Type: text/plain\r\n"
+        "Content-Length: " + std::to_string(msg.size()) + "\r\n\r\n";
+    client << header << msg << std::flush;
+    // Discard the unread request (without blocking), as closing a socket
+    // with unread data resets the connection and the client may then lose
+    // the response.
+    char discard[4096];
+    while ((recv(client.socket().native_handle(), discard, sizeof(discard),
+                 MSG_DONTWAIT) > 0)) {
+    }
+    metrics.add(Metrics::BytesOut, header.size() + msg.size());
+    metrics.add(Metrics::Rejected);
+}
+
+// Scans and wait queries get a lower priority than point queries.
+AdmissionQueue::Priority
+SQLAir::queryPriority(const StrVec& tokens, bool mustWait) {
+    if (mustWait) {
+        return AdmissionQueue::Wait;
+    }
+    const std::string& stmt = (tokens.empty() ? "" : tokens.front());
+    if (stmt != "select" && stmt != "update") {
+        return AdmissionQueue::Interactive;
+    }
+    if (Helper::find(tokens, "like") != -1 ||
+        Helper::find(tokens, "join") != -1 || !streamedFile(tokens).empty()) {
+        return AdmissionQueue::Scan;
+    }
+    // As in Coordinator::route, a point query has a col = value condition
+    // joined by and to the other conditions in its where clause (an update
+    // also has an = in its set clause). With or/not (or parentheses)
+    // matching rows could be anywhere.
+    const int whereIdx = Helper::find(tokens, "where");
+    if (whereIdx == -1) {
+        return AdmissionQueue::Scan;
+    }
+    const int size = tokens.size();
+    for (int i = whereIdx + 1; (i < size); i++) {
+        if (tokens[i] == "or" || tokens[i] == "not" ||
+            tokens[i].find('(') != std::string::npos) {
+            return AdmissionQueue::Scan;
+        }
+    }
+    for (int i = whereIdx + 1; (i + 2 < size); i++) {
+        if ((i == whereIdx + 1 || tokens[i - 1] == "and") &&
+            tokens[i + 1] == "=") {
+            return AdmissionQueue::Interactive;
         }
-        // Send HTTP response back to the client.
-        const std::string resp = os.str();
-        // Send response back to the client.
-        *client << HTTPRespHeader << resp.size() << "\r\n\r\n" << resp;
+    }
+    return AdmissionQueue::Scan;
+}
+
+// Send the results staged in a buffer (with the HTTP header) to a client.
+// The results are written directly from the buffer, without a copy.
+void
+SQLAir::sendResponse(tcp::iostream& client, const OutputBuffer& resp) {
+    std::string header = HTTPRespHeader;
+    if (replica != nullptr) {
+        // Tell the client how old the data of this read replica may be.
+        header.insert(header.find("Content-Length"), "X-Replication-Lag: " +
+                      std::to_string(replica->lag()) + "\r\n");
+    }
+    client << header << resp.size() << "\r\n\r\n";
+    client.write(resp.data(), resp.size());
+    metrics.add(Metrics::BytesOut, header.size() + resp.size());
+}
+
+// Return the session with the given ID, after removing idle sessions.
+std::shared_ptr<Session>
+SQLAir::getSession(const std::string& id) {
+    const auto now = std::chrono::steady_clock::now();
+    std::lock_guard<std::mutex> guard(sessionMutex);
+    // Sessions being used are kept alive by their shared pointers.
+    for (auto entry = sessions.begin(); (entry != sessions.end());) {
+        if (now - entry->second->lastUsed >
+            std::chrono::seconds(SessionTimeout)) {
+            entry = sessions.erase(entry);
+        } else {
+            entry++;
+        }
+    }
+    std::shared_ptr<Session>& session = sessions[id];
+    if (session == nullptr) {
+        session = std::make_shared<Session>();
+    }
+    session->lastUsed = now;
+    return session;
+}
+
+// Print the server metrics, including the per-table metrics.
+void
+SQLAir::printMetrics(std::ostream& os) {
+    // Tables are never removed from the catalog. So the pointers to the
+    // CSVs remain valid. Each table is locked just while its memory is
+    // measured, so that a scrape does not hold up writers (or deadlock
+    // with commits, which lock several tables).
+    std::vector<TableMetrics> tables;
+    for (Catalog::Table* table : catalog.tables()) {
+        std::shared_lock<std::shared_timed_mutex> rowsLock(table->rowsMutex);
+        tables.push_back({table->name, &table->csv,
+            Metrics::memoryUsed(table->csv) + table->dict->memoryUsed() +
+            table->zones->memoryUsed() + table->trigrams->memoryUsed() +
+            (table->lazy != nullptr ? table->lazy->memoryUsed() : 0)});
+    }
+    metrics.print(os, tables);
+    size_t parked = 0;
+    for (const Catalog::Table* table : catalog.tables()) {
+        parked += table->waiters->size();
+    }
+    os << "# HELP sqlair_waits_parked Wait queries waiting for changes.\n"
+       << "# TYPE sqlair_waits_parked gauge\n"
+       << "sqlair_waits_parked " << parked << '\n';
+    if (replica != nullptr) {
+        replica->printMetrics(os);
+    } else if (changeLog.active()) {
+        os << "# HELP sqlair_change_log_position Last change log record.\n"
+           << "# TYPE sqlair_change_log_position gauge\n"
+           << "sqlair_change_log_position " << changeLog.position() << '\n';
     }
 }
 
 // The method to have this class run as a web-server. 
 void 
 SQLAir::runServer(boost::asio::ip::tcp::acceptor& server, const int maxThr) {
+    // Invalid settings (see setting()) are reported instead of running the
+    // server with settings that were not intended.
+    if (!settingErrors.empty()) {
+        for (const auto& error : settingErrors) {
+            std::cerr << "Error: " << error << std::endl;
+        }
+        return;
+    }
+    // Machine clients use the binary protocol on its own port, if set.
+    if (binaryPort != 0) {
+        std::thread(&SQLAir::runBinaryServer, this, binaryPort).detach();
+    }
+    if (replica != nullptr) {
+        // Keep the tables of this read replica up-to-date.
+        std::thread(&Replica::follow, replica.get(),
+            [this](const ChangeRecord& record) {
+                applyChanges(record);
+            }).detach();
+    }
+    // The workers that process the requests in the admission queue.
+    admission.start(maxThr);
+    std::thread(&SQLAir::expireWaits, this).detach();
+    std::thread(&SQLAir::refreshStats, this).detach();
     for (bool done = false; !done;) {
         // Creates garbage-collected connection on heap 
         TcpStreamPtr client = std::make_shared<tcp::iostream>();
         // Wait for a client to connect
         server.accept(*client->rdbuf());
-        // Now we have a I/O stream to talk to the client. 
-        std::thread thr(&SQLAir::clientThread, this, client);
-        thr.detach();  // Run independently
+        // Now we have a I/O stream to talk to the client. The request is
+        // read in a separate thread, as the client may be slow to send it,
+        // and only queries are queued for the workers.
+        std::thread(&SQLAir::clientThread, this, client).detach();
     }    
 }
 
+// Resume parked wait queries that timed out (checked 10 times a second).
+void
+SQLAir::expireWaits() {
+    while (true) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        const auto now = std::chrono::steady_clock::now();
+        for (Catalog::Table* table : catalog.tables()) {
+            table->waiters->expire(now);
+        }
+    }
+}
+
+// Analyze the tables whose statistics are out of date (checked every
+// StatsRefreshSecs seconds).
+void
+SQLAir::refreshStats() {
+    while (true) {
+        std::this_thread::sleep_for(std::chrono::seconds(StatsRefreshSecs));
+        for (Catalog::Table* table : catalog.tables()) {
+            if (table->stats->stale()) {
+                // As with analyze, the columns of lazily loaded tables must
+                // be loaded before they are scanned.
+                loadColumns(table->csv, {"*"});
+                const auto rowsLock = readRows(table->csv);
+                table->stats->analyze(table->csv, *table->dict);
+            }
+        }
+    }
+}
+
+// Return the port set via SQLAIR_BINARY_PORT, or 0 if it is not set.
+int
+SQLAir::binaryPortFromEnv() {
+    const char* const env = std::getenv("SQLAIR_BINARY_PORT");
+    if (env == nullptr) {
+        return 0;  // The binary protocol is not served.
+    }
+    const int port = std::atoi(env);
+    if (port <= 0 || port > 65535) {
+        throw Exp("Invalid SQLAIR_BINARY_PORT " + std::string(env) +
+                  " (expected a port number)");
+    }
+    return port;
+}
+
+// Accept connections from binary protocol clients, each in its own thread.
+void
+SQLAir::runBinaryServer(int port) {
+    io_service service;
+    std::unique_ptr<tcp::acceptor> server;
+    try {
+        server.reset(new tcp::acceptor(service, tcp::endpoint(tcp::v4(),
+                                                              port)));
+    } catch (const std::exception& exp) {
+        // The web-server still works without the binary protocol.
+        std::cerr << "Binary protocol is not available on port " << port
+                  << ": " << exp.what() << std::endl;
+        return;
+    }
+    std::cout << "SQL-Air binary protocol is listening on " << port
+              << std::endl;
+    while (true) {
+        auto client = std::make_shared<tcp::socket>(service);
+        server->accept(*client);
+        metrics.add(Metrics::ConnQueued);
+        std::thread thr(&SQLAir::binaryClientThread, this, client);
+        thr.detach();  // Run independently
+    }
+}
+
+// Process the requests from a binary protocol client until it disconnects.
+void
+SQLAir::binaryClientThread(std::shared_ptr<tcp::socket> client) {
+    metrics.add(Metrics::ConnQueued, -1);
+    metrics.add(Metrics::ConnActive);
+    // Replies are small and must not be delayed by Nagle's algorithm.
+    boost::system::error_code ec;
+    client->set_option(tcp::no_delay(true), ec);
+    FrameStream stream(*client);
+    Session session;
+    std::string reply;
+    size_t bytesOut = 0;
+    try {
+        for (Wire::Frame req; stream.read(req);) {
+            metrics.add(Metrics::BytesIn,
+                        Wire::HeaderSize + req.payload.size());
+            if (req.type == Wire::Subscribe) {
+                // The connection is used only for the changes from now on.
+                streamChanges(stream, req);
+                break;
+            }
+            BatchSink sink(stream, req.id);
+            Wire::MsgType type;
+            reply.clear();
+            try {
+                Session::Use use(session);
+                type = binaryRequest(req, reply);
+            } catch (const std::exception& exp) {
+                type = Wire::Error;
+                reply.clear();
+                WireWriter(reply).str(exp.what());
+            }
+            sink.finish();
+            stream.write(type, req.id, reply);
+            // Send the replies once all the pipelined requests are done.
+            if (!stream.hasFrame()) {
+                stream.flush();
+                metrics.add(Metrics::BytesOut, stream.bytesSent() - bytesOut);
+                bytesOut = stream.bytesSent();
+            }
+        }
+    } catch (const std::exception&) {
+        // The client sent an invalid message or went away. Nothing more
+        // can be sent to it, so just close the connection.
+    }
+    metrics.add(Metrics::ConnActive, -1);
+}
+
+// Process a prepare, execute, query, or close request.
+Wire::MsgType
+SQLAir::binaryRequest(const Wire::Frame& req, std::string& reply) {
+    const auto startTime = std::chrono::steady_clock::now();
+    Session& session = Session::current();
+    WireReader in(req.payload);
+    WireWriter out(reply);
+    if (req.type == Wire::Prepare) {
+        PreparedStatement stmt = prepare(in.str());
+        const uint32_t id = session.nextStatementId++;
+        out.u32(id);
+        out.u16(stmt.params.size());
+        session.statements[id] = std::move(stmt);
+        return Wire::Prepared;
+    }
+    if (req.type == Wire::Snapshot) {
+        return snapshot(in.str(), reply);
+    }
+    OutputBuffer& os = OutputBuffer::forThread();
+    if (req.type == Wire::Execute) {
+        const auto entry = session.statements.find(in.u32());
+        if (entry == session.statements.end()) {
+            throw Exp("Unknown prepared statement.");
+        }
+        const PreparedStatement& stmt = entry->second;
+        const size_t numParams = in.u16();
+        if (numParams != stmt.params.size()) {
+            throw Exp("Expected " + std::to_string(stmt.params.size()) +
+                      " parameter(s) but got " + std::to_string(numParams) +
+                      ".");
+        }
+        // The values replace tokens, which are marked so that they are
+        // never parsed as SQL.
+        StrVec tokens = stmt.tokens;
+        for (const int idx : stmt.params) {
+            tokens[idx] = in.str();
+        }
+        BoundValues bound(&stmt.params);
+        run(stmt.sql, tokens, stmt.mustWait, os, startTime);
+    } else if (req.type == Wire::Query) {
+        process(Helper::trim(in.str(), ";"), os);
+    } else if (req.type == Wire::Close) {
+        session.statements.erase(in.u32());
+    } else {
+        throw Exp("Unknown message type " + std::to_string(req.type) + ".");
+    }
+    out.str(std::string(os.data(), os.size()));
+    return Wire::Done;
+}
+
+// Tokenize a statement once, so that it can be run repeatedly.
+PreparedStatement
+SQLAir::prepare(const std::string& sql) {
+    PreparedStatement stmt;
+    stmt.sql = Helper::trim(sql, ";");
+    int cmd;
+    std::tie(stmt.tokens, stmt.mustWait, cmd) = preprocess(stmt.sql);
+    for (size_t i = 0; (i < stmt.tokens.size()); i++) {
+        if (stmt.tokens[i] == "?") {
+            stmt.params.push_back(i);
+        }
+    }
+    // Other statements (such as explain) use the text of the statement,
+    // which does not have the values of the parameters.
+    const std::string stmtType = (stmt.tokens.empty() ? "" :
+                                  stmt.tokens.front());
+    if (!stmt.params.empty() && stmtType != "select" &&
+        stmtType != "update" && stmtType != "insert" &&
+        stmtType != "delete") {
+        throw Exp("Parameters are only supported in select, update, "
+                  "insert, and delete statements.");
+    }
+    return stmt;
+}
+
+// Send all the rows of a table, along with the position in the change log
+// that they are consistent with.
+Wire::MsgType
+SQLAir::snapshot(const std::string& table, std::string& reply) {
+    CSV& csv = loadAndGet(table);
+    loadColumns(csv, {"*"});
+    const Dictionary& dict = getDictionary(csv);
+    const StrVec colNames  = csv.getColumnNames();
+    BatchSink* const sink  = BatchSink::current();
+    // Copy the rows & the position they are consistent with under the lock
+    // (changes to the table are logged while holding it), so that a slow
+    // follower does not hold up changes to the table.
+    uint64_t position;
+    StrVec values;
+    {
+        std::lock_guard<std::mutex> lock(csv.csvMutex);
+        position = changeLog.subscribe(UINT64_MAX);
+        values.reserve(csv.size() * colNames.size());
+        for (size_t rowIdx = 0; (rowIdx < csv.size()); rowIdx++) {
+            for (size_t col = 0; (col < colNames.size()); col++) {
+                values.push_back(dict.get(csv[rowIdx], rowIdx, col));
+            }
+        }
+    }
+    WireWriter out(reply);
+    out.u64(position);
+    out.u16(colNames.size());
+    for (const auto& colName : colNames) {
+        out.str(colName);
+    }
+    sink->start(colNames);
+    for (size_t i = 0; (i < values.size()); i++) {
+        sink->add(values[i]);
+        if ((i + 1) % colNames.size() == 0) {
+            sink->endRow();
+        }
+    }
+    sink->finish();
+    return Wire::Columns;
+}
+
+// Send the records in the change log to a follower as they are added.
+void
+SQLAir::streamChanges(FrameStream& stream, const Wire::Frame& req) {
+    std::string payload;
+    uint64_t position;
+    try {
+        position = changeLog.subscribe(WireReader(req.payload).u64());
+    } catch (const std::exception& exp) {
+        WireWriter(payload).str(exp.what());
+        stream.write(Wire::Error, req.id, payload);
+        stream.flush();
+        return;
+    }
+    const std::chrono::milliseconds interval(Replica::HeartbeatMillis);
+    std::vector<std::shared_ptr<const ChangeRecord>> records;
+    while (true) {
+        records.clear();
+        const uint64_t asOf = changeLog.read(position, records, interval);
+        for (const auto& record : records) {
+            payload.clear();
+            record->encode(payload);
+            stream.write(Wire::Change, req.id, payload);
+            position = record->position;
+        }
+        if (records.empty()) {
+            // The follower is up-to-date as of this time.
+            payload.clear();
+            WireWriter out(payload);
+            out.u64(position);
+            out.u64(asOf);
+            stream.write(Wire::Heartbeat, req.id, payload);
+        }
+        // An error (when the follower disconnects) ends the thread.
+        metrics.add(Metrics::BytesOut, stream.flush());
+    }
+}
+
+// Apply changes from the primary, like an update on each table changed.
+void
+SQLAir::applyChanges(const ChangeRecord& record) {
+    const auto& cells = record.cells;
+    for (size_t start = 0, end = 0; (start < cells.size()); start = end) {
+        const std::string& table = cells[start].table;
+        while ((end < cells.size() && cells[end].table == table)) {
+            end++;
+        }
+        Catalog::Table* const loaded = catalog.find(table);
+        CSV* const csv = (loaded != nullptr ? &loaded->csv : nullptr);
+        if (csv == nullptr) {
+            continue;  // The table could not be loaded after the snapshot.
+        }
+        Dictionary& dict = getDictionary(*csv);
+        {
+            const auto writeLock = writeRows(*csv);
+            const auto lock = lockTable(*csv);
+            TableVersions::Writer writer(getVersions(*csv));
+            for (size_t i = start; (i < end); i++) {
+                if (cells[i].row < csv->size()) {
+                    dict.set((*csv)[cells[i].row], cells[i].row, cells[i].col,
+                             cells[i].value);
+                    writer.bump(cells[i].row);
+                }
+            }
+        }
+        getWaiters(*csv).wake();
+    }
+}
+
 void 
 SQLAir::loadFromURL(CSV& csv, const std::string& hostName, 
         const std::string& port, const std::string& path) {
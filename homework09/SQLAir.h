@@ -17,7 +17,24 @@
 #include <thread>
 #include <atomic>
 #include <condition_variable>
+#include <shared_mutex>
+#include <chrono>
+#include <cstdlib>
 #include "SQLAirBase.h"
+#include "Predicate.h"
+#include "Expression.h"
+#include "Metrics.h"
+#include "Arena.h"
+#include "Session.h"
+#include "ResultCache.h"
+#include "StaticFiles.h"
+#include "WireProtocol.h"
+#include "Sharding.h"
+#include "Replication.h"
+#include "Catalog.h"
+#include "StreamScan.h"
+#include "ScanPlan.h"
+#include "AdmissionQueue.h"
 
 // Shortcut to smart pointer with TcpStream
 using TcpStreamPtr = std::shared_ptr<boost::asio::ip::tcp::iostream>;
@@ -29,6 +46,21 @@ using TcpStreamPtr = std::shared_ptr<boost::asio::ip::tcp::iostream>;
  */
 class SQLAir : public SQLAirBase {
 public:
+    /**
+     * Top-level method to process a SQL-air query. This method handles the
+     * statements that are specific to this class (such as select with a
+     * join). All other statements are processed by the base class.
+     *
+     * @param sql The SQL-air query to be processed by this method.
+     *
+     * @param os The output stream to where results from the processing are
+     * to be written.
+     *
+     * @return This method returns true if further queries are to be processed.
+     * This method returns false if the command was "exit;"
+     */
+    bool process(const std::string& sql, std::ostream& os) override;
+
     /**
      * Method to perform the actual operations associated with printing a
      * given set of columns in a given CSV that match an optional condition.
@@ -74,10 +106,46 @@ public:
         const int whereColIdx, const std::string& cond, 
         const std::string& value, std::ostream& os) override;
 
-    int selectQueryHelper(CSV& csv, bool mustWait, StrVec colNames, 
-        const int whereColIdx, const std::string& cond, 
-        const std::string& value, std::ostream& os);
-    
+    /**
+     * Method to perform the actual operations associated with printing a
+     * given set of columns in a given CSV that match an optional where
+     * clause. The where clause can have several conditions combined with
+     * and, or, and not. The other selectQuery method calls this one.
+     *
+     * @param csv The CSV data to be used.
+     *
+     * @param mustWait If this flag is true, then this query must keep trying
+     * until at least one row is selected.
+     *
+     * @param selectCols The column names in the CSV file to be printed by
+     * this method. These will be just {"*"} or valid column names in the CSV.
+     *
+     * @param where The predicate compiled from the where clause. If a where
+     * clause was not specified then this parameter is nullptr.
+     *
+     * @param os The output stream to where the results are to be written.
+     */
+    void selectQuery(CSV& csv, bool mustWait, const StrVec& selectCols,
+        const Predicate* where, std::ostream& os);
+
+    int selectQueryHelper(CSV& csv, bool mustWait, const StrVec& colNames,
+        const Predicate* where, std::ostream& os);
+
+    /**
+     * Runs a select query using the result cache. If the same query was
+     * run earlier and the table has not changed since, the cached result
+     * is written out. Otherwise the query is run and its result is added
+     * to the cache.
+     *
+     * @param csv The CSV data to be used.
+     * @param sql The tokens of the query, used as the key for the cache.
+     * @param colNames The column names to be printed.
+     * @param where The predicate compiled from the where clause, if any.
+     * @param os The output stream to where the results are to be written.
+     */
+    void cachedSelect(CSV& csv, const StrVec& sql, const StrVec& colNames,
+        const Predicate* where, std::ostream& os);
+
     /**
      * Method that is called to perform actual operations to update specified
      * values in the CSV. This method's documentation uses the following query
@@ -125,10 +193,40 @@ public:
         StrVec values, const int whereColIdx, const std::string& cond, 
         const std::string& value, std::ostream& os) override;
 
+    /**
+     * Method to perform the actual operations to update specified values in
+     * rows of the CSV that match an optional where clause. The where clause
+     * can have several conditions combined with and, or, and not. The other
+     * updateQuery method calls this one.
+     *
+     * @param csv The CSV whose values are to be updated.
+     *
+     * @param mustWait If this flag is true then this method must repeatedly
+     * try performing the update operation until at least 1 row is updated.
+     *
+     * @param colNames The names of the columns to be updated in each row.
+     *
+     * @param values The values to be set for each column. A value may be an
+     * arithmetic expression using the current values of the row, e.g.,
+     * "raters + 1". Outside a transaction, the values are computed and
+     * stored while holding the table's locks (see writeRows()), so that
+     * "raters = raters + 1" is atomic with respect to other updates and
+     * scans never see a partly updated row. In a transaction, the values
+     * are computed from the transaction's view of the row.
+     *
+     * @param where The predicate compiled from the where clause. If a where
+     * clause was not specified then this parameter is nullptr.
+     *
+     * @param os The output stream to where the number of rows updated must
+     * be written -- e.g." "1 row(s) updated.\n"
+     */
+    void updateQuery(CSV& csv, bool mustWait, const StrVec& colNames,
+        const std::vector<Expression>& values, const Predicate* where,
+        std::ostream& os);
+
     int
-    updateQueryHelper(CSV& csv,  bool mustWait, StrVec colNames, StrVec values, 
-        const int whereColIdx, const std::string& cond, 
-        const std::string& value, std::ostream& os);
+    updateQueryHelper(CSV& csv, const StrVec& colNames,
+        const std::vector<Expression>& values, const Predicate* where);
     /**
      * Helper method to perform the actual operations associated with inserting
      * a new row into a given CSV. This method's documentation uses the
@@ -203,10 +301,11 @@ public:
         std::ostream& os) override;
     
     /**
-     * Saves the recently used CSV using the name specified in the recentCSV
-     * string. If the recent CSV was downloaded from an URL, then this method
-     * throws an exception (as this feature is not yet implemented). If the CSV
-     * was loaded from a a file, then the data in the file is overwritten.
+     * Saves the CSV recently used by the current session (see
+     * getRecentCSV). If the recent CSV was downloaded from an URL, then this
+     * method throws an exception (as this feature is not yet implemented).
+     * If the CSV was loaded from a a file, then the data in the file is
+     * overwritten.
      * 
      * @param os The output stream to where the result of saving (if any) is
      * to be written.
@@ -217,16 +316,14 @@ public:
     
     /**
      * Helper method to obtain a reference to a pre-loaded CSV file from the
-     * inMemoryCSV map.  If the requested file is not present, then this
-     * method loads the data into the inMemoryCSV.   
-     * 
-     * @note Currently, this method is not MT-safe. So avoid calling this 
-     * method from multiple threads simultaneously.
+     * catalog.  If the requested file is not present, then this method
+     * loads the data and adds it to the catalog. Tables that are already
+     * loaded are looked up without any locks.
      * 
      * @param fileOrURL Path to a CSV file or a URL to a CSV data to be returned
      * by this method.  If the path is empty string, then this method returns
-     * the most recently accessed CSV file. This method intentionally uses
-     * pass-by-value.
+     * the CSV most recently accessed by the session (see getRecentCSV). This
+     * method intentionally uses pass-by-value.
      * 
      * @return A reference to the in-memory CSV file.  If the CSV data could
      * not be loaded, then this method throws an exception.
@@ -239,21 +336,97 @@ public:
     /**
      * Method to have this class run as a web-server that runs forever and 
      * keeps processing requests. This method does not do the core processing.
-     * Instead, for each connection it starts a detached-thread to process the
-     * request from the client. Hence, the task of processing HTTP-GET request
-     * is delegated to the clientThread method. 
-     * 
-     * @note This method uses detached threads to process each request.
+     * Instead, the request on each connection is read by the clientThread
+     * method in its own thread, which then adds queries to a bounded queue
+     * (see AdmissionQueue.h) from which a pool of worker threads process
+     * them. So slow or idle connections do not keep the workers. If the
+     * queue is full, the client gets a "503 Service Unavailable" response
+     * right away. Clients using the binary
+     * protocol (see WireProtocol.h) connect to the port set via the
+     * SQLAIR_BINARY_PORT environment variable (if it is set), which is
+     * served by runBinaryServer in a separate thread. A read replica also
+     * starts a thread that applies the changes made on the primary.
      * 
      * @param server The BOOST acceptor that must be used to accept connections
      * from clients.
      * 
-     * @param maxThr An optional maximum number of threads to be used by this
-     * method.
+     * @param maxThr The number of worker threads that process requests.
+     * Wait queries do not keep a worker while they wait (see WaitList.h).
      */
     void runServer(boost::asio::ip::tcp::acceptor& server, const int maxThr);
 
 protected:
+    /**
+     * Checks if a select query is valid and calls the selectQuery() method
+     * to process it. This method overrides the base class version to
+     * support where clauses with several conditions combined using and, or,
+     * not, and parentheses.
+     *
+     * @param sql The tokens in the select statement to be processed.
+     * @param mustWait Flag to indicate if the query must keep running until
+     * at least 1 matching row is found.
+     * @param os The output stream to where the results are to be written.
+     *
+     * @exception This method throws an exception if error occur when
+     * processing the specified SQL
+     */
+    void validateAndProcessSelect(const StrVec& sql, bool mustWait,
+        std::ostream &os) override;
+
+    /**
+     * Checks if an update query is valid and calls the updateQuery() method
+     * to process it. This method overrides the base class version to
+     * support where clauses with several conditions combined using and, or,
+     * not, and parentheses.
+     *
+     * @param sql The tokens in the update statement to be processed.
+     * @param mustWait Flag to indicate if the query must keep running until
+     * at least 1 row is updated.
+     * @param os The output stream to where the results are to be written.
+     *
+     * @exception This method throws an exception if error occur when
+     * processing the specified SQL
+     */
+    void validateAndProcessUpdate(const StrVec& sql, bool mustWait,
+        std::ostream &os) override;
+
+    /**
+     * Helper method to compile the where clause (if any) in a query into a
+     * predicate tree.
+     *
+     * @param csv The CSV used to check the column names in the where clause.
+     * @param sql The tokens in the query.
+     * @param startIdx The index from where to search for the 'where' clause.
+     *
+     * @return The compiled predicate or nullptr if the query does not have
+     * a where clause.
+     */
+    std::unique_ptr<Predicate> getWhere(const CSV& csv, const StrVec& sql,
+        const int startIdx = 0) const;
+
+    /**
+     * Returns the file scanned by a "select ... from stream('file')" query.
+     *
+     * @param sql The tokens in the query.
+     *
+     * @return The path to the file or an empty string if the query does
+     * not scan a file via stream().
+     */
+    static std::string streamedFile(const StrVec& sql);
+
+    /**
+     * Runs a select query on a CSV file that is read in blocks (see
+     * StreamScan) instead of being loaded into memory. The rows are
+     * filtered and written out as they are read.
+     *
+     * @param path The path to the CSV file.
+     * @param sql The tokens in the select statement.
+     * @param mustWait Must be false, as the file does not change.
+     * @param os The output stream to where the results are to be written.
+     */
+    void streamSelect(const std::string& path, const StrVec& sql,
+        bool mustWait, std::ostream& os);
+
     /**
      * This method is a refactored utility method. This method is called from
      * the seqlectQuery method. This method performs the actual operations
@@ -353,16 +526,597 @@ protected:
      * each time a client connects, when sql-air is running as a web-server.
      * This web-server will get the following 2 types of HTTP-GET requests:
      *     1. Request to run a query where the request starts with the prefix
-     *        "/sql-air?query=select;"
-     *     2. All other requests are assumed to be requests for files that are
-     *        returned back to the client using http::file() helper method in
-     *        the HTTPFile class.
-     * 
+     *        "/sql-air?query=select;". The query may be a batch of
+     *        statements separated by semicolons (see batchRequest), which
+     *        may also be sent as the body of a POST request to "/sql-air".
+     *     2. A request for "/metrics" that returns the server metrics in
+     *        Prometheus text format.
+     *     3. All other requests are assumed to be requests for files that are
+     *        returned back to the client by the StaticFiles class (which
+     *        also handles If-None-Match revalidation of cached copies).
+     * 
+     * Files and metrics are sent from this thread, while queries are added
+     * to the admission queue, with scans and wait queries at a lower
+     * priority (see queryPriority) than the other queries. A client that
+     * does not send its request within RequestTimeout seconds is dropped.
+     *
      * @param client The socket stream to be used for performing all of the
      * I/O operations.
      */
     void clientThread(TcpStreamPtr client);
 
+    /**
+     * Runs a sql-air query from a web-client and sends the results back.
+     *
+     * @param client The socket stream to the web-client.
+     * @param session The session named in the request or nullptr to use a
+     * session just for this query.
+     * @param sql The query to be run.
+     * @param tokens The tokens in the query from preprocess().
+     * @param mustWait Flag to indicate if the query has the wait keyword.
+     * If the query must wait, it is parked and this method is called again
+     * (on a worker thread) once the table changes.
+     * @param startTime The time when the request was received.
+     */
+    void queryResponse(TcpStreamPtr client, std::shared_ptr<Session> session,
+        const std::string& sql, const StrVec& tokens, bool mustWait,
+        std::chrono::steady_clock::time_point startTime);
+
+    /**
+     * Splits the text of a request into its statements, at the semicolons
+     * that are not in quoted values. Empty statements are dropped.
+     *
+     * @param sql The text of the request, e.g., "update a.csv set x = 1
+     * where id = 2; select * from a.csv where id = 2;".
+     *
+     * @return The statements, without the semicolons.
+     */
+    static StrVec splitBatch(const std::string& sql);
+
+    /**
+     * Runs a batch of statements from a web-client (in the session named
+     * in the request, if any) and sends all their results back in one
+     * response. The batch is not run if any of its statements is invalid
+     * or is a wait query (which would block the worker running the batch).
+     * The batch is queued at the lowest priority of its statements.
+     *
+     * @param client The socket stream to the web-client.
+     * @param session The session named in the request or nullptr to use a
+     * session just for this batch.
+     * @param stmts The statements in the batch, from splitBatch().
+     */
+    void batchRequest(TcpStreamPtr client, std::shared_ptr<Session> session,
+        const StrVec& stmts);
+
+    /**
+     * Runs the statements of a batch in order, writing their results (or
+     * errors) one after another. Consecutive statements on the same table
+     * (see batchTable) are run while holding the locks on the table, so
+     * that the locks are taken once for the group rather than once per
+     * statement.
+     *
+     * @param batch The tokenized statements.
+     * @param os The output stream to where the results are to be written.
+     */
+    void runBatch(const std::vector<PreparedStatement>& batch,
+        std::ostream& os);
+
+    /**
+     * Returns the table of a statement that may be grouped with others on
+     * the same table in a batch, i.e., of a select or update that is not
+     * a join, a stream() scan, or part of a transaction.
+     *
+     * @param stmt The tokenized statement.
+     *
+     * @return The name of the table, or an empty string if the statement
+     * may not be grouped.
+     */
+    std::string batchTable(const PreparedStatement& stmt);
+
+    /**
+     * Resumes the parked wait queries whose deadlines have passed, so that
+     * they report the timeout. This method runs forever in its own thread.
+     */
+    void expireWaits();
+
+    /**
+     * Analyzes the tables whose statistics are out of date, i.e., tables
+     * that were analyzed before and then changed a lot. This method runs
+     * forever in its own thread.
+     */
+    void refreshStats();
+
+    /**
+     * Adds a request to the admission queue, to be run by a worker thread.
+     * If the request cannot be queued, or waits in the queue for too long,
+     * the client is sent a 503 response instead.
+     *
+     * @param priority The priority of the request.
+     * @param client The socket stream to the client.
+     * @param task The task that processes the request.
+     * @param resumed True if the request is a parked wait query that is
+     * resumed, which is queued even if the queue is full.
+     */
+    void admit(AdmissionQueue::Priority priority, TcpStreamPtr client,
+        AdmissionQueue::Task task, bool resumed = false);
+
+    /**
+     * Sends a "503 Service Unavailable" response (that asks the client to
+     * retry in a second) to a client whose request was not run.
+     *
+     * @param client The socket stream to the client.
+     */
+    void rejectRequest(boost::asio::ip::tcp::iostream& client);
+
+    /**
+     * Returns the priority of a query in the admission queue. Wait queries
+     * have the lowest priority. Selects and updates that scan all the rows
+     * (i.e., without a col = value condition joined by and to the other
+     * conditions in the where clause, or with a like, join, or stream())
+     * have a lower priority than other queries.
+     *
+     * @param tokens The tokens in the query.
+     * @param mustWait Flag to indicate if the query has the wait keyword.
+     */
+    static AdmissionQueue::Priority queryPriority(const StrVec& tokens,
+        bool mustWait);
+
+    /**
+     * Accepts connections from clients using the binary protocol and
+     * processes each one in a separate thread. This method runs forever,
+     * unless the port is not available.
+     *
+     * @param port The port number on which to listen.
+     */
+    void runBinaryServer(int port);
+
+    /**
+     * Returns the port for the binary protocol, set via the
+     * SQLAIR_BINARY_PORT environment variable. The binary protocol is off
+     * by default, as it opens another port.
+     *
+     * @return The port number, or 0 if the variable is not set.
+     *
+     * @exception Exp Thrown if the variable is not a valid port number.
+     */
+    static int binaryPortFromEnv();
+
+    /**
+     * A thread-main method to process the requests from a client using the
+     * binary protocol. Each connection has its own session. Replies are
+     * buffered until there are no more pipelined requests to process, so
+     * that many replies are sent with a single system call.
+     *
+     * @param client The socket connected to the client.
+     */
+    void binaryClientThread(
+        std::shared_ptr<boost::asio::ip::tcp::socket> client);
+
+    /**
+     * Processes a request from a binary protocol client in the current
+     * session. Rows selected by queries are sent via the current BatchSink.
+     *
+     * @param req The request to be processed.
+     * @param reply The string to which the payload of the reply is added.
+     *
+     * @return The type of the reply.
+     */
+    Wire::MsgType binaryRequest(const Wire::Frame& req, std::string& reply);
+
+    /**
+     * Tokenizes a statement to be run repeatedly by a binary protocol
+     * client. The ? tokens in the statement are the parameters that are
+     * replaced by values when the statement is run.
+     *
+     * @param sql The statement to be prepared.
+     *
+     * @exception Exp Thrown if parameters are used in statements other
+     * than select, update, insert, and delete.
+     */
+    PreparedStatement prepare(const std::string& sql);
+
+    /**
+     * Sends all the rows of a table to a follower (via the current
+     * BatchSink), for a Snapshot request. The table is locked while it is
+     * copied, so that the rows are consistent with the position in the
+     * change log sent in the reply.
+     *
+     * @param table The name of the table.
+     * @param reply The string to which the payload of the reply is added.
+     *
+     * @return The type of the reply.
+     */
+    Wire::MsgType snapshot(const std::string& table, std::string& reply);
+
+    /**
+     * Sends the records in the change log to a follower, for a Subscribe
+     * request, until the follower disconnects. A heartbeat is sent when
+     * there are no changes for a while, so that the follower knows how
+     * up-to-date it is.
+     *
+     * @param stream The stream connected to the follower.
+     * @param req The Subscribe request.
+     */
+    void streamChanges(FrameStream& stream, const Wire::Frame& req);
+
+    /**
+     * Applies the changes made on the primary to the tables of this read
+     * replica. This method is called by the thread following the primary.
+     *
+     * @param record The changes to be applied, grouped by table.
+     */
+    void applyChanges(const ChangeRecord& record);
+
+    /**
+     * Adds the changes made by a transaction to the change log, if any
+     * follower is using it. The caller must hold the locks on the tables.
+     *
+     * @param txn The transaction that was applied.
+     */
+    void logCommit(const Transaction& txn);
+
+    /**
+     * Returns the name of the table most recently used by the current
+     * session. If the session has not used a table yet (for example, a
+     * web-client without a session ID) the table most recently used by any
+     * query is returned.
+     *
+     * @return The name of the table or an empty string if no table has
+     * been used.
+     */
+    std::string getRecentCSV() const;
+
+    /**
+     * Returns the name of a CSV loaded via the loadAndGet() method, i.e.,
+     * the name used by the change log.
+     *
+     * @param csv The CSV whose name is to be returned.
+     */
+    std::string tableName(const CSV& csv);
+
+    /**
+     * Prints the server metrics (request counts and latencies, lock waits,
+     * connections, bytes transferred, table cache hits/misses, and memory
+     * used by each table) in Prometheus text format.
+     *
+     * @param os The output stream to where the metrics are to be written.
+     */
+    void printMetrics(std::ostream& os);
+
+    /**
+     * Sends a HTTP response (with the results staged in a buffer) to a
+     * client. The results are written directly from the buffer.
+     *
+     * @param client The socket stream to where the response is written.
+     * @param resp The buffer with the body of the response.
+     */
+    void sendResponse(boost::asio::ip::tcp::iostream& client,
+        const OutputBuffer& resp);
+
+    /**
+     * Runs a select, update, insert, delete, use, or save statement using
+     * the tokens already generated by preprocess(), so that the query does
+     * not have to be tokenized again by the base class.
+     *
+     * @param tokens The tokens in the statement to be processed.
+     * @param mustWait Flag to indicate if the query must keep running until
+     * at least 1 matching row is found.
+     * @param os The output stream to where the results are to be written.
+     *
+     * @return This method returns false if the statement is not one of the
+     * above, in which case it must be processed by the base class.
+     */
+    bool dispatch(const StrVec& tokens, bool mustWait, std::ostream& os);
+
+    /**
+     * Runs a statement that has already been tokenized (by process or by
+     * prepare). A wait query may end with "timeout <seconds>" (see
+     * WaitList.h), in which case it fails if no rows are found in time.
+     *
+     * @param sql The statement, used by explain and by the base class.
+     * @param tokens The tokens in the statement to be processed.
+     * @param mustWait Flag to indicate if the query must keep running until
+     * at least 1 matching row is found.
+     * @param os The output stream to where the results are to be written.
+     * @param startTime The time when processing of the statement started.
+     * @param canPark If true, a wait query that must wait is parked (by
+     * throwing WaitList::Parked) instead of blocking the calling thread.
+     *
+     * @return This method returns false if the command was "exit;"
+     */
+    bool run(const std::string& sql, const StrVec& tokens, bool mustWait,
+        std::ostream& os, std::chrono::steady_clock::time_point startTime,
+        bool canPark = false);
+
+    /**
+     * Runs a statement (without the timeout of a wait query) and records
+     * its latency in the metrics.
+     *
+     * @param sql The statement, used by explain and by the base class.
+     * @param tokens The tokens in the statement to be processed.
+     * @param mustWait Flag to indicate if the query must keep running until
+     * at least 1 matching row is found.
+     * @param os The output stream to where the results are to be written.
+     * @param startTime The time when processing of the statement started.
+     *
+     * @return This method returns false if the command was "exit;"
+     */
+    bool runStatement(const std::string& sql, const StrVec& tokens,
+        bool mustWait, std::ostream& os,
+        std::chrono::steady_clock::time_point startTime);
+
+    /**
+     * Convenience method to compute the time elapsed since a given time.
+     *
+     * @param startTime The time from when the elapsed time is computed.
+     *
+     * @return The elapsed time in microseconds.
+     */
+    static uint64_t elapsedMicros(
+        std::chrono::steady_clock::time_point startTime);
+
+    /**
+     * Checks if a select query with a join is valid and uses a HashJoin to
+     * process it. This method is called from the process method to process
+     * queries of the form:
+     *
+     *     select title, rating from movies.csv join ratings.csv
+     *         on movies.csv.movieid = ratings.csv.movieid where year = 2006;
+     *
+     * Columns can be referred to by just their name or prefixed by the
+     * table name as shown above.
+     *
+     * @param sql The tokens in the select statement to be processed.
+     * @param mustWait Flag to indicate if the query must keep running until
+     * at least 1 matching row is found. Waiting is not supported for joins.
+     * @param os The output stream to where the results are to be written.
+     *
+     * @exception This method throws an exception if error occur when
+     * processing the specified SQL
+     */
+    void validateAndProcessJoin(const StrVec& sql, bool mustWait,
+        std::ostream& os);
+
+    /**
+     * Helper method to map a column name (optionally prefixed with the name
+     * of the table) used in a join query to a JoinCol. Unqualified names
+     * are looked up in the left table first.
+     *
+     * @param col The column name from the query, e.g., "movieid" or
+     * "movies.csv.movieid".
+     * @param names The names of the two tables in the join.
+     * @param left The first table in the join.
+     * @param right The second table in the join.
+     *
+     * @return The table (0 or 1) and the index of the column in that table.
+     *
+     * @exception Exp This method throws an exception if the column is not
+     * found.
+     */
+    std::pair<int, int> getJoinColumn(const std::string& col,
+        const StrVec& names, const CSV& left, const CSV& right) const;
+
+    /**
+     * Processes a select or update query prefixed with "explain" or
+     * "explain analyze". For explain, only the plan for the query (with
+     * its priority in the admission queue) is printed. For explain
+     * analyze, the query is run (but its results are not printed) and the
+     * plan, number of rows scanned and emitted, bytes produced, and the
+     * wall and CPU time for each phase are printed.
+     *
+     * @param sql The original query that is used to extract the query
+     * after the explain keywords.
+     * @param tokens The tokens in the query.
+     * @param mustWait Flag to indicate if the query was prefixed with wait.
+     * Waiting is not supported for explain queries.
+     * @param os The output stream to where the results are to be written.
+     *
+     * @exception This method throws an exception if error occur when
+     * processing the specified SQL
+     */
+    void explainQuery(const std::string& sql, const StrVec& tokens,
+        bool mustWait, std::ostream& os);
+
+    /**
+     * Helper method to add the steps of scanning a CSV to the plan of an
+     * explain query. This method does nothing for other queries.
+     *
+     * @param name The name of the CSV file or URL being scanned.
+     * @param csv The CSV being scanned.
+     * @param where The optional where clause used to filter rows.
+     */
+    void explainScan(const std::string& name, const CSV& csv,
+        const Predicate* where);
+
+    /**
+     * Returns the dictionary for the encoded columns of a CSV loaded via
+     * the loadAndGet() method. The dictionary must be used to access the
+     * values in the rows of the CSV.
+     *
+     * @param csv The CSV whose dictionary is to be returned.
+     */
+    Dictionary& getDictionary(const CSV& csv);
+
+    /**
+     * Returns the row versions of a CSV loaded via the loadAndGet() method.
+     * The versions are used to validate transactions.
+     *
+     * @param csv The CSV whose row versions are to be returned.
+     */
+    TableVersions& getVersions(const CSV& csv);
+
+    /**
+     * Returns the zone maps of a CSV loaded via the loadAndGet() method.
+     * The zone maps are used to skip blocks of rows in scans.
+     *
+     * @param csv The CSV whose zone maps are to be returned.
+     */
+    ZoneMap& getZones(const CSV& csv);
+
+    /**
+     * Returns the trigram indexes of a CSV loaded via the loadAndGet()
+     * method. The indexes are used for like conditions in scans.
+     *
+     * @param csv The CSV whose trigram indexes are to be returned.
+     */
+    TrigramIndex& getTrigrams(const CSV& csv);
+
+    /**
+     * Returns the wait queries waiting for a CSV loaded via the
+     * loadAndGet() method to change.
+     *
+     * @param csv The CSV whose wait queries are to be returned.
+     */
+    WaitList& getWaiters(const CSV& csv);
+
+    /**
+     * Returns the statistics for a CSV loaded via the loadAndGet() method.
+     * The statistics are collected by analyze and are used to plan
+     * queries.
+     *
+     * @param csv The CSV whose statistics are to be returned.
+     */
+    TableStats& getStats(const CSV& csv);
+
+    /**
+     * Processes a "create trigram index on a.csv (col)" statement, which
+     * indexes the trigrams in a column for like conditions. Updates keep
+     * the index up to date.
+     *
+     * @param sql The tokens in the statement.
+     * @param os The output stream to where the results are to be written.
+     */
+    void createIndexQuery(const StrVec& sql, std::ostream& os);
+
+    /**
+     * Processes a "copy into a.csv from 'b.csv'" statement, which appends
+     * the rows of a CSV file (or URL) to a table. The rows are parsed by
+     * the CSV loader, appended all at once, and then dictionary encoded
+     * and added to the zone maps and trigram indexes in bulk. The columns
+     * of the file are matched with the table's columns by name.
+     *
+     * @param sql The tokens in the statement.
+     * @param os The output stream to where the number of rows copied (and
+     * the rate, in rows per second) is written.
+     */
+    void copyQuery(const StrVec& sql, std::ostream& os);
+
+    /**
+     * Processes an "analyze a.csv" statement, which collects the statistics
+     * on the columns of a table (see TableStats.h) and prints a summary of
+     * them.
+     *
+     * @param sql The tokens in the statement.
+     * @param os The output stream to where the summary is to be written.
+     */
+    void analyzeQuery(const StrVec& sql, std::ostream& os);
+
+    /**
+     * Processes the statements for cursors (see Cursor.h): "declare c
+     * cursor for select ...", "fetch n from c", and "close c". Cursors
+     * are kept in the current session and are closed after being idle for
+     * CursorTimeout seconds.
+     *
+     * @param sql The tokens in the statement.
+     * @param mustWait True if the statement is a wait query, which is not
+     * supported for cursors.
+     * @param os The output stream to where the results are to be written.
+     */
+    void cursorQuery(const StrVec& sql, bool mustWait, std::ostream& os);
+
+    /**
+     * Declares a cursor for a select on a single table. The where clause
+     * is compiled and the scan is planned once, for all the fetches.
+     *
+     * @param sql The tokens in the "declare" statement.
+     * @param os The output stream to where the results are to be written.
+     */
+    void declareQuery(const StrVec& sql, std::ostream& os);
+
+    /**
+     * Returns the next rows of a cursor, in the same format as a select.
+     * The rows are copied while holding the lock on the table, and are
+     * written out after the lock is released.
+     *
+     * @param sql The tokens in the "fetch" statement.
+     * @param os The output stream to where the rows are to be written.
+     */
+    void fetchQuery(const StrVec& sql, std::ostream& os);
+
+    /**
+     * Reads the rows of a local CSV file or an URL with the CSV loader.
+     *
+     * @param csv The CSV to which the rows are loaded.
+     * @param fileOrURL The path to the file or the URL.
+     *
+     * @exception Exp This method throws exceptions if the data could not
+     * be read.
+     */
+    void readCSV(CSV& csv, const std::string& fileOrURL);
+
+    /**
+     * Returns a shared lock on the rows of a CSV loaded via loadAndGet(),
+     * which keeps copy into from moving the rows while they are scanned.
+     * The lock is not taken (again) if the calling thread holds it for a
+     * batch (see Catalog::Locked).
+     *
+     * @param csv The CSV to be scanned.
+     */
+    std::shared_lock<std::shared_timed_mutex> readRows(const CSV& csv);
+
+    /**
+     * Returns an exclusive lock on the rows of a CSV loaded via
+     * loadAndGet(), which is held (along with the lock on the CSV) while
+     * its values are changed, so that scans never read a value while it
+     * is being changed. The lock is not taken (again) if the calling
+     * thread holds it for a batch (see Catalog::Locked).
+     *
+     * @param csv The CSV whose values are to be changed.
+     */
+    std::unique_lock<std::shared_timed_mutex> writeRows(const CSV& csv);
+
+    /**
+     * Returns the lock on a CSV, which is held to change its values, once
+     * the lock is acquired (and the time spent waiting for it is added to
+     * the metrics). The lock is not taken (again) if the calling thread
+     * holds it for a batch (see Catalog::Locked).
+     *
+     * @param csv The CSV to be locked.
+     */
+    std::unique_lock<std::mutex> lockTable(CSV& csv);
+
+    /**
+     * Returns the state of the current session's transaction for a given
+     * CSV, if the current session has started a transaction.
+     *
+     * @param csv The CSV used by a statement in the transaction.
+     *
+     * @return The state of the transaction for the CSV or nullptr if the
+     * session does not have a transaction in progress.
+     */
+    Transaction::Table* txnTable(CSV& csv);
+
+    /**
+     * Processes the "begin", "commit", and "rollback" statements for the
+     * current session. A commit validates the transaction and applies all
+     * of its writes while holding the locks on the tables it used. If
+     * another session changed rows that the transaction read, the
+     * transaction is aborted instead.
+     *
+     * @param stmt The statement to be processed.
+     * @param os The output stream to where the results are to be written.
+     */
+    void transactionQuery(const std::string& stmt, std::ostream& os);
+
+    /**
+     * Returns the session with a given ID, creating it if needed. Sessions
+     * that have been idle for a while are removed (rolling back any open
+     * transaction) by this method.
+     *
+     * @param id The session ID sent by the client.
+     */
+    std::shared_ptr<Session> getSession(const std::string& id);
+
     /**
      * Internal helper method to obtain CSV file from a given URL. The URL
      * processing is initially done in the gloadAndGet method that calls
@@ -390,43 +1144,147 @@ protected:
      */
     void loadFromURL(CSV& csv, const std::string& hostName, 
         const std::string& port, const std::string& path);
+
+    /**
+     * Loads a CSV (from a file, a URL, or the primary of a read replica)
+     * and adds it to the catalog. This method is called by loadAndGet when
+     * a CSV is not in the catalog.
+     *
+     * @param fileOrURL Path to a CSV file or a URL to a CSV data.
+     *
+     * @return The table in the catalog.
+     *
+     * @exception Exp This method throws an exception if the file could not
+     * be loaded.
+     */
+    Catalog::Table& load(const std::string& fileOrURL);
+
+    /**
+     * Loads the columns of a lazily loaded CSV that are used by a query,
+     * if they have not been loaded yet. See LazyColumns.
+     *
+     * @param csv The CSV loaded via the loadAndGet() method.
+     * @param tokens The tokens of the query. A "*" loads all the columns.
+     * @param name The name of the CSV, which may qualify column names.
+     */
+    void loadColumns(CSV& csv, const StrVec& tokens,
+        const std::string& name = "");
     
 private:
     /**
-     * The most recently referenced CSV in a query. This value is updated
-     * int he getOrLoadCSV method.
+     * The tables (with their dictionaries and row versions) that have been
+     * accessed in queries. Tables are added in the loadAndGet method and
+     * are never removed.
      */
-    std::string recentCSV;
-    
+    Catalog catalog;
+
     /**
-     * This is a convenience mutex that is used to enable thread-safe 
-     * operations on the recentCSV instance variable in this class. This
-     * mutex is locked and unlocked in the loadAndGet method in this class.
+     * The table most recently used by any query. It is used by sessions
+     * that have not used a table yet. See getRecentCSV().
      */
-    std::mutex recentCSVMutex;
-    
+    std::atomic<const Catalog::Table*> recentTable = {nullptr};
+
+    /** Sessions are removed after being idle for this many seconds */
+    static const int SessionTimeout = 300;
+
+    /** The time (in seconds) a web-client has to send its request */
+    static const int RequestTimeout = 10;
+
+    /** The largest body of a POST request (i.e., a batch) in bytes */
+    static const size_t MaxBodySize = 4 << 20;
+
+    /** How often (in seconds) stale statistics are refreshed */
+    static const int StatsRefreshSecs = 10;
+
+    /** Cursors are closed after being idle for this many seconds */
+    static const int CursorTimeout = 120;
+
+    /** The most cursors that a session may have open */
+    static const size_t MaxCursors = 16;
+
+    /** The sessions of web-clients, with their IDs as the key */
+    std::unordered_map<std::string, std::shared_ptr<Session>> sessions;
+
+    /** The mutex to guard the sessions map */
+    std::mutex sessionMutex;
+
+    /** The results of recent select queries, see cachedSelect() */
+    ResultCache resultCache;
+
     /**
-     * An unordered map to maintain the CSV files that have been accessed
-     * in recent queries.  This map is used to provide convenient/rapid
-     * access to CSV files that the user has recently worked with. The most
-     * recent CSV used is tracked by the recentCSV instance variable. See the
-     * getOrLoadCSV() method in this class.
+     * The errors in the settings made via environment variables, which
+     * runServer reports (see setting()).
      */
-    std::unordered_map<std::string, CSV> inMemoryCSV;
-    
-    // -------------[ Limit number of threads ]-------------------    
-    /** The atomic counter that tracks the number of active threads.
-     * This counter is incremented in runServer each time a thread is started.
-     * It is decremented at the end of clientThread each time a thread finishes.
+    StrVec settingErrors;
+
+    /**
+     * Returns a setting made via an environment variable. The settings are
+     * read as the members are created, where errors cannot be reported.
+     * So an invalid setting is noted in settingErrors instead.
+     *
+     * @param get The function that reads the setting. It throws Exp if
+     * the setting is invalid.
+     * @param otherwise The value used if the setting is invalid.
+     */
+    template<typename Get, typename Default>
+    auto setting(Get get, Default otherwise) -> decltype(get()) {
+        try {
+            return get();
+        } catch (const std::exception& exp) {
+            settingErrors.push_back(exp.what());
+            return decltype(get())(std::move(otherwise));
+        }
+    }
+
+    /** The shard this process is (set via SQLAIR_SHARD), if any */
+    const ShardSpec shard = setting(ShardSpec::fromEnv, ShardSpec());
+
+    /**
+     * The coordinator of the shards (set via SQLAIR_SHARDS) that run the
+     * queries, or nullptr if this process runs queries itself.
      */
-    std::atomic<int> numThreads = {0};
+    std::unique_ptr<Coordinator> coordinator =
+        setting(Coordinator::fromEnv, nullptr);
 
-    /** A condition variable to wait if number of threads being used 
-     * exceeds a given limit. The runServer method waits on it. The 
-     * clientThread method call notify.
+    /** The changes to tables, for read replicas of this process */
+    ChangeLog changeLog;
+
+    /**
+     * The primary that this process is a read replica of (set via
+     * SQLAIR_PRIMARY), or nullptr if this process is not a replica.
+     */
+    std::unique_ptr<Replica> replica = setting(Replica::fromEnv, nullptr);
+
+    /**
+     * If true (set via SQLAIR_LAZY_COLUMNS), the columns of local CSV files
+     * are loaded when queries first use them.
+     */
+    const bool lazyColumns = (std::getenv("SQLAIR_LAZY_COLUMNS") != nullptr);
+
+    /**
+     * The port for binary protocol clients (set via SQLAIR_BINARY_PORT), or
+     * 0 if the binary protocol is not served.
+     */
+    const int binaryPort = setting(binaryPortFromEnv, 0);
+
+    /** The static files (such as the files in the web folder) served */
+    StaticFiles staticFiles;
+
+    /**
+     * The requests from web-clients waiting for a worker thread, with the
+     * size and deadline set via SQLAIR_QUEUE_SIZE and SQLAIR_QUEUE_MS
+     */
+    AdmissionQueue admission{
+        size_t(setting([] {
+            return AdmissionQueue::fromEnv("SQLAIR_QUEUE_SIZE", 256); }, 256)),
+        setting([] {
+            return AdmissionQueue::fromEnv("SQLAIR_QUEUE_MS", 1000); }, 1000)};
+    
+    /**
+     * The metrics that are reported by the "/metrics" endpoint. These are
+     * updated as queries are processed.
      */
-    std::condition_variable thrCond;
-    // -----------------------------------------------------------
+    Metrics metrics;
 };
 
 #endif /* SQL_AIR_H */
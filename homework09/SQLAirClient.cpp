@@ -0,0 +1,114 @@
+/*
+ * Copyright (C) Ethan Gutknecht 2021 (gutkneET@miamioh.edu)
+ *
+ * Implementation of the client library for the binary protocol.
+ */
+
+#include "SQLAirClient.h"
+#include "Helper.h"
+
+using namespace boost::asio::ip;
+
+size_t
+SQLAirClient::Result::rows() const {
+    size_t total = 0;
+    for (const auto& batch : batches) {
+        total += batch.rows;
+    }
+    return total;
+}
+
+SQLAirClient::SQLAirClient(const std::string& host, const std::string& port)
+    : sock(service), stream(sock) {
+    boost::system::error_code ec;
+    tcp::resolver resolver(service);
+    boost::asio::connect(sock, resolver.resolve(host, port, ec), ec);
+    if (ec) {
+        throw Exp("Unable to connect to " + host + " at port " + port);
+    }
+    sock.set_option(tcp::no_delay(true), ec);
+}
+
+uint32_t
+SQLAirClient::prepare(const std::string& sql) {
+    payload.clear();
+    WireWriter(payload).str(sql);
+    return wait(send(Wire::Prepare, payload)).stmtId;
+}
+
+void
+SQLAirClient::close(uint32_t stmtId) {
+    payload.clear();
+    WireWriter(payload).u32(stmtId);
+    wait(send(Wire::Close, payload));
+}
+
+uint32_t
+SQLAirClient::send(uint32_t stmtId, const StrVec& params) {
+    payload.clear();
+    WireWriter writer(payload);
+    writer.u32(stmtId);
+    writer.u16(params.size());
+    for (const auto& param : params) {
+        writer.str(param);
+    }
+    return send(Wire::Execute, payload);
+}
+
+uint32_t
+SQLAirClient::send(const std::string& sql) {
+    payload.clear();
+    WireWriter(payload).str(sql);
+    return send(Wire::Query, payload);
+}
+
+uint32_t
+SQLAirClient::send(Wire::MsgType type, const std::string& payload) {
+    // Requests are buffered until the client waits for a result, so that
+    // pipelined requests are sent together.
+    const uint32_t id = nextId++;
+    stream.write(type, id, payload);
+    pending[id] = Pending();
+    return id;
+}
+
+SQLAirClient::Result
+SQLAirClient::wait(uint32_t reqId) {
+    const auto entry = pending.find(reqId);
+    if (entry == pending.end()) {
+        throw Exp("Unknown request id " + std::to_string(reqId));
+    }
+    stream.flush();
+    // Read replies (to this or to earlier requests) until this one is done.
+    for (Wire::Frame reply; !entry->second.done;) {
+        if (!stream.read(reply)) {
+            throw Exp("Connection closed by the server.");
+        }
+        const auto found = pending.find(reply.id);
+        if (found == pending.end()) {
+            throw Exp("Reply for an unknown request from the server.");
+        }
+        WireReader in(reply.payload);
+        Pending& req = found->second;
+        req.done = (reply.type != Wire::Batch);
+        if (reply.type == Wire::Batch) {
+            req.result.batches.emplace_back();
+            req.result.batches.back().decode(in);
+        } else if (reply.type == Wire::Prepared) {
+            req.result.stmtId    = in.u32();
+            req.result.numParams = in.u16();
+        } else if (reply.type == Wire::Done) {
+            req.result.message = in.str();
+        } else if (reply.type == Wire::Error) {
+            req.error = in.str();
+        } else {
+            throw Exp("Unexpected message from the server.");
+        }
+    }
+    Pending req = std::move(entry->second);
+    pending.erase(entry);
+    if (!req.error.empty()) {
+        throw Exp(req.error);
+    }
+    return req.result;
+}
@@ -0,0 +1,145 @@
+#ifndef SQL_AIR_CLIENT_H
+#define SQL_AIR_CLIENT_H
+
+/*
+ * Copyright (C) Ethan Gutknecht 2021 (gutkneET@miamioh.edu)
+ *
+ * A small client library for the binary protocol of SQLAir (see
+ * WireProtocol.h). It is also used by a shard coordinator to talk to its
+ * shards. Compile SQLAirClient.cpp and WireProtocol.cpp with the program.
+ * For example:
+ *
+ *     SQLAirClient client("localhost", "8081");
+ *     const uint32_t stmt = client.prepare(
+ *         "select name, rating from test.csv where movieid = ?");
+ *     SQLAirClient::Result res = client.execute(stmt, {"2"});
+ *     for (const auto& batch : res.batches) {
+ *         for (size_t row = 0; (row < batch.rows); row++) {
+ *             std::cout << batch.columns[0].text(row) << '\n';
+ *         }
+ *     }
+ *
+ * To pipeline requests, use send() for several requests and then wait()
+ * for each of their results.
+ */
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <unordered_map>
+#include <boost/asio.hpp>
+#include "WireProtocol.h"
+
+/**
+ * A connection to a SQLAir server using the binary protocol. An object
+ * must be used by only one thread at a time.
+ */
+class SQLAirClient {
+public:
+    /** The result of a request */
+    struct Result {
+        /** The rows returned by a query, in batches */
+        std::vector<ColumnBatch> batches;
+        /** The message from the server, e.g., "3 row(s) selected." */
+        std::string message;
+        /** The id and number of parameters of a prepared statement */
+        uint32_t stmtId = 0, numParams = 0;
+
+        /** Returns the total number of rows in all of the batches */
+        size_t rows() const;
+    };
+
+    /**
+     * Connects to a SQLAir server.
+     *
+     * @param host The host name of the server.
+     * @param port The port for the binary protocol (the server's
+     * SQLAIR_BINARY_PORT).
+     *
+     * @exception Exp Thrown if a connection could not be established.
+     */
+    SQLAirClient(const std::string& host, const std::string& port);
+
+    /**
+     * Prepares a statement to be run repeatedly.
+     *
+     * @param sql The statement with a ? for each parameter, for example
+     * "update test.csv set raters = raters + ? where movieid = ?".
+     *
+     * @return The id of the prepared statement.
+     * @exception Exp Thrown if the server reports an error.
+     */
+    uint32_t prepare(const std::string& sql);
+
+    /** Runs a prepared statement with the given parameters */
+    Result execute(uint32_t stmtId, const StrVec& params) {
+        return wait(send(stmtId, params));
+    }
+
+    /** Runs a statement (that is not prepared) */
+    Result query(const std::string& sql) { return wait(send(sql)); }
+
+    /** Releases a prepared statement on the server */
+    void close(uint32_t stmtId);
+
+    /**
+     * Sends a request to run a prepared statement without waiting for the
+     * result.
+     *
+     * @return The id of the request, to be used with wait().
+     */
+    uint32_t send(uint32_t stmtId, const StrVec& params);
+
+    /** Sends a statement to be run without waiting for the result */
+    uint32_t send(const std::string& sql);
+
+    /**
+     * Sends the requests that are buffered. This is done by wait(), so it
+     * is only needed to send requests before doing something else.
+     */
+    void flush() { stream.flush(); }
+
+    /**
+     * Waits for the result of a request sent earlier.
+     *
+     * @param reqId The id returned by send().
+     *
+     * @exception Exp Thrown if the server reports an error for the request
+     * or if the connection fails.
+     */
+    Result wait(uint32_t reqId);
+
+private:
+    /** Sends a request with the given payload and returns its id */
+    uint32_t send(Wire::MsgType type, const std::string& payload);
+
+    /** Needed for the socket */
+    boost::asio::io_service service;
+
+    /** The socket connected to the server */
+    boost::asio::ip::tcp::socket sock;
+
+    /** The stream used to send requests and receive replies */
+    FrameStream stream;
+
+    /** The id for the next request */
+    uint32_t nextId = 1;
+
+    /** A request that has not been waited on yet */
+    struct Pending {
+        /** The replies received so far */
+        Result result;
+        /** True once the last reply (or an error) is received */
+        bool done = false;
+        /** The error reported by the server, if any */
+        std::string error;
+    };
+
+    /** The requests that have not been waited on yet, by id */
+    std::unordered_map<uint32_t, Pending> pending;
+
+    /** A buffer reused for the payload of each request */
+    std::string payload;
+};
+
+#endif /* SQL_AIR_CLIENT_H */
@@ -0,0 +1,73 @@
+/*
+ * Copyright (C) Ethan Gutknecht 2021 (gutkneET@miamioh.edu)
+ *
+ * Implementation of the choice of rows checked by a scan.
+ */
+
+#include <utility>
+#include <algorithm>
+#include "ScanPlan.h"
+
+ScanPlan::ScanPlan(size_t numRows, const Predicate* where,
+        const ZoneMap* zones, const TrigramIndex* index) : numRows(numRows) {
+    if (where == nullptr) {
+        return;
+    }
+    this->where = where;
+    this->zones = zones;
+    like = (index != nullptr ? index->usable(*where) : nullptr);
+    if (like != nullptr && like->selectivity() > MaxIndexSelectivity) {
+        std::swap(like, unselective);
+    }
+    if (like != nullptr) {
+        index->candidates(*like, candidates);
+    }
+}
+
+size_t
+ScanPlan::next(size_t rowIdx) {
+    const size_t start = rowIdx;
+    while ((rowIdx < numRows)) {
+        if (like != nullptr) {
+            // Only the candidates from the index are checked.
+            while ((nextCandidate < candidates.size() &&
+                    candidates[nextCandidate] < rowIdx)) {
+                nextCandidate++;
+            }
+            rowIdx = (nextCandidate < candidates.size() ?
+                      candidates[nextCandidate] : numRows);
+        }
+        // Each block is checked against its zones once.
+        const size_t block = rowIdx / ZoneMap::BlockRows;
+        if (zones == nullptr || rowIdx >= numRows || block == matchBlock) {
+            break;
+        }
+        if (zones->mayMatch(block, *where)) {
+            matchBlock = block;
+            break;
+        }
+        const size_t blockEnd = std::min(numRows,
+                                         (block + 1) * ZoneMap::BlockRows);
+        zoneSkipped += blockEnd - rowIdx;
+        rowIdx = blockEnd;
+    }
+    rowsSkipped += rowIdx - start;
+    return rowIdx;
+}
+
+StrVec
+ScanPlan::describe() const {
+    StrVec steps;
+    if (like != nullptr) {
+        steps.push_back("  Trigram index on " + like->colName + ": " +
+                        std::to_string(candidates.size()) + " candidate rows");
+    } else if (unselective != nullptr) {
+        steps.push_back("  Trigram index on " + unselective->colName +
+                        ": not used, as the like matches many rows");
+    }
+    if (zoneSkipped > 0) {
+        steps.push_back("  Zone maps skipped " + std::to_string(zoneSkipped) +
+                        " rows");
+    }
+    return steps;
+}
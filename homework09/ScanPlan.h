@@ -0,0 +1,93 @@
+#ifndef SCAN_PLAN_H
+#define SCAN_PLAN_H
+
+/*
+ * Copyright (C) Ethan Gutknecht 2021 (gutkneET@miamioh.edu)
+ *
+ * The rows that a scan of a CSV checks against its where clause. Rows are
+ * skipped if a zone map shows that their block cannot match or (with a
+ * trigram index) if they cannot meet a like condition. The index is not
+ * used if the like condition is estimated to match many rows.
+ */
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include "CSV.h"
+#include "Predicate.h"
+#include "ZoneMap.h"
+#include "TrigramIndex.h"
+
+/** Chooses the rows to be checked by a scan */
+class ScanPlan {
+public:
+    /**
+     * The highest estimated selectivity of a like condition for which the
+     * trigram index is used. Beyond it, reading the postings lists of the
+     * trigrams costs more than checking every row.
+     */
+    static constexpr double MaxIndexSelectivity = 0.3;
+
+    /**
+     * Plans a scan. Without a where clause, every row is checked.
+     *
+     * @param numRows The number of rows in the CSV.
+     * @param where The where clause of the query, if any.
+     * @param zones The zone maps of the CSV (already built for the where
+     * clause), or nullptr if they are not to be used.
+     * @param index The trigram indexes of the CSV, or nullptr if they are
+     * not to be used.
+     */
+    ScanPlan(size_t numRows, const Predicate* where, const ZoneMap* zones,
+        const TrigramIndex* index);
+
+    /**
+     * Returns the first row to be checked at or after a given row. The
+     * scan ends when this method returns the number of rows.
+     *
+     * @param rowIdx The index of the row after the last one checked.
+     */
+    size_t next(size_t rowIdx);
+
+    /** Returns the number of rows that were not checked */
+    size_t skipped() const { return rowsSkipped; }
+
+    /**
+     * Returns the steps (for explain analyze) that describe how the zone
+     * maps and the trigram index were used, if at all.
+     */
+    StrVec describe() const;
+
+private:
+    /** The number of rows in the CSV */
+    const size_t numRows;
+
+    /** The where clause, if zones are used */
+    const Predicate* where = nullptr;
+
+    /** The zone maps, if used */
+    const ZoneMap* zones = nullptr;
+
+    /** The like condition for which the trigram index is used, if any */
+    const Predicate* like = nullptr;
+
+    /** The like condition for which the trigram index is not worth using */
+    const Predicate* unselective = nullptr;
+
+    /** The rows that may meet the like condition, if an index is used */
+    std::vector<uint32_t> candidates;
+
+    /** The position in candidates of the next row */
+    size_t nextCandidate = 0;
+
+    /** The last block whose zones showed that its rows may match */
+    size_t matchBlock = SIZE_MAX;
+
+    /** The number of rows skipped via the zone maps */
+    size_t zoneSkipped = 0;
+
+    /** The number of rows that were not checked */
+    size_t rowsSkipped = 0;
+};
+
+#endif /* SCAN_PLAN_H */
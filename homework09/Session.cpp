@@ -0,0 +1,43 @@
+/*
+ * Copyright (C) Ethan Gutknecht 2021 (gutkneET@miamioh.edu)
+ *
+ * Implementation of client sessions.
+ */
+
+#include <algorithm>
+#include "Session.h"
+
+thread_local Session* Session::currentSession = nullptr;
+
+Session&
+Session::current() {
+    thread_local Session defaultSession;
+    return (currentSession != nullptr ? *currentSession : defaultSession);
+}
+
+Session::Use::Use(Session& session) : guard(session.mutex),
+    prev(currentSession) {
+    currentSession = &session;
+}
+
+Session::Use::~Use() {
+    currentSession = prev;
+}
+
+thread_local const std::vector<int>* BoundValues::currentParams = nullptr;
+
+BoundValues::BoundValues(const std::vector<int>* params) :
+    prev(currentParams) {
+    currentParams = params;
+}
+
+BoundValues::~BoundValues() {
+    currentParams = prev;
+}
+
+bool
+BoundValues::contains(int idx) {
+    return (currentParams != nullptr &&
+            std::find(currentParams->begin(), currentParams->end(), idx) !=
+            currentParams->end());
+}
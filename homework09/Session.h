@@ -0,0 +1,121 @@
+#ifndef SESSION_H
+#define SESSION_H
+
+/*
+ * Copyright (C) Ethan Gutknecht 2021 (gutkneET@miamioh.edu)
+ *
+ * The state of a client session, such as an open transaction. The console
+ * has a single session. Web-clients identify their session via a session
+ * parameter in the URL, for example:
+ *
+ *     /sql-air?query=begin&session=abc123
+ */
+
+#include <mutex>
+#include <memory>
+#include <chrono>
+#include <vector>
+#include <unordered_map>
+#include "Transaction.h"
+#include "Cursor.h"
+
+/** A statement prepared by a binary protocol client, see SQLAir::prepare */
+struct PreparedStatement {
+    /** The statement, without a trailing semicolon */
+    std::string sql;
+    /** The tokens in the statement, as returned by preprocess */
+    StrVec tokens;
+    /** True if the statement is a wait query */
+    bool mustWait = false;
+    /** The indexes of the tokens that are parameters (? tokens) */
+    std::vector<int> params;
+};
+
+/**
+ * Marks the tokens of the statement run by the calling thread (within a
+ * scope) that are values bound to the parameters of a prepared statement.
+ * These tokens are used only as values and are never parsed as SQL, e.g.,
+ * a value "where" does not end a set clause and "raters*0" is not an
+ * arithmetic expression.
+ */
+class BoundValues {
+public:
+    /**
+     * Sets the bound values of the calling thread.
+     *
+     * @param params The indexes of the tokens with bound values, or
+     * nullptr if no tokens are bound values (e.g., for a statement that is
+     * tokenized again).
+     */
+    explicit BoundValues(const std::vector<int>* params);
+    ~BoundValues();
+
+    /**
+     * Returns true if a token of the statement run by the calling thread
+     * is a bound value.
+     *
+     * @param idx The index of the token.
+     */
+    static bool contains(int idx);
+
+private:
+    /** The bound values in the enclosing scope, if any */
+    const std::vector<int>* const prev;
+
+    /** The indexes of the bound values for each thread */
+    static thread_local const std::vector<int>* currentParams;
+};
+
+/**
+ * The state of a client session. Queries are processed for the current
+ * session of the calling thread (see current()). Each thread has a default
+ * session that is used when no other session has been set.
+ */
+class Session {
+public:
+    /** The transaction started by a "begin" statement, if any */
+    std::unique_ptr<Transaction> txn;
+
+    /** The prepared statements, with their ids as the key */
+    std::unordered_map<uint32_t, PreparedStatement> statements;
+
+    /** The id for the next prepared statement */
+    uint32_t nextStatementId = 1;
+
+    /** The cursors declared in this session, with their names as the key */
+    std::unordered_map<std::string, std::unique_ptr<Cursor>> cursors;
+
+    /**
+     * The most recently used table, which is used by statements that do
+     * not name a table. Empty if this session has not used a table.
+     */
+    std::string recentCSV;
+
+    /** Mutex to process only one request for a session at a time */
+    std::mutex mutex;
+
+    /** The time when this session was last used */
+    std::chrono::steady_clock::time_point lastUsed;
+
+    /** Returns the current session of the calling thread */
+    static Session& current();
+
+    /**
+     * A convenience class to set the current session of the calling thread
+     * (while holding the session's mutex) within a scope.
+     */
+    class Use {
+    public:
+        explicit Use(Session& session);
+        ~Use();
+    private:
+        std::lock_guard<std::mutex> guard;
+        Session* const prev;
+    };
+
+private:
+    /** The session set by the Use class for each thread */
+    static thread_local Session* currentSession;
+};
+
+#endif /* SESSION_H */
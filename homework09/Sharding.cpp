@@ -0,0 +1,284 @@
+/*
+ * Copyright (C) Ethan Gutknecht 2021 (gutkneET@miamioh.edu)
+ *
+ * Implementation of hash partitioning of tables across shards.
+ */
+
+#include <cstdlib>
+#include <deque>
+#include <sstream>
+#include <algorithm>
+#include "Sharding.h"
+#include "Helper.h"
+
+//------------------------------[  ShardSpec  ]----------------------------
+
+ShardSpec
+ShardSpec::fromEnv() {
+    ShardSpec spec;
+    const char* const env = std::getenv("SQLAIR_SHARD");
+    if (env == nullptr) {
+        return spec;  // Not a shard.
+    }
+    std::istringstream is(env);
+    char slash = 0;
+    if (!(is >> spec.index >> slash >> spec.count) || slash != '/' ||
+        spec.index < 0 || spec.index >= spec.count) {
+        throw Exp("Invalid SQLAIR_SHARD " + std::string(env) +
+                  " (expected index/count, e.g., 0/2)");
+    }
+    return spec;
+}
+
+int
+ShardSpec::owner(const std::string& key, int numShards) {
+    // FNV-1a, as all the processes must compute the same hash.
+    uint64_t hash = 14695981039346656037ULL;
+    for (const unsigned char c : key) {
+        hash = (hash ^ c) * 1099511628211ULL;
+    }
+    return hash % numShards;
+}
+
+void
+ShardSpec::filter(CSV& csv) const {
+    if (count == 0) {
+        return;  // Not a shard. So all the rows are kept.
+    }
+    csv.erase(std::remove_if(csv.begin(), csv.end(),
+        [this](const CSVRow& row) {
+            return owner(row.empty() ? "" : row.front(), count) != index;
+        }), csv.end());
+}
+
+//-----------------------------[  Coordinator  ]---------------------------
+
+Coordinator::Coordinator(const StrVec& shardList) : idle(shardList.size()) {
+    for (const auto& shard : shardList) {
+        const size_t colon = shard.rfind(':');
+        if (colon == std::string::npos) {
+            throw Exp("Invalid shard " + shard + " (expected host:port)");
+        }
+        shards.push_back({shard.substr(0, colon), shard.substr(colon + 1)});
+    }
+}
+
+std::unique_ptr<Coordinator>
+Coordinator::fromEnv() {
+    const char* const env = std::getenv("SQLAIR_SHARDS");
+    if (env == nullptr) {
+        return nullptr;  // Not a coordinator.
+    }
+    StrVec shardList;
+    std::istringstream is(env);
+    for (std::string shard; std::getline(is, shard, ',');) {
+        shardList.push_back(Helper::trim(shard));
+    }
+    if (shardList.empty()) {
+        throw Exp("SQLAIR_SHARDS must list at least one host:port");
+    }
+    return std::unique_ptr<Coordinator>(new Coordinator(shardList));
+}
+
+void
+Coordinator::process(const StrVec& tokens, bool mustWait, std::ostream& os) {
+    const std::string& stmt = tokens.front();
+    if (stmt == "select") {
+        select(tokens, mustWait, os);
+    } else if (stmt == "update") {
+        update(tokens, mustWait, os);
+    } else if (stmt == "describe" && tokens.size() == 2) {
+        os << columns(tokens[1]) << std::endl;
+    } else {
+        throw Exp(stmt + " is not supported with shards.");
+    }
+}
+
+void
+Coordinator::select(const StrVec& tokens, bool mustWait, std::ostream& os) {
+    const std::string table = Helper::getCSVInfo(tokens, "from");
+    if (table.empty()) {
+        throw Exp("A table name is required in queries with shards.");
+    }
+    const int shard = route(tokens, columns(table).front());
+    if (mustWait && shard == -1) {
+        throw Exp("wait with shards requires a condition on the first "
+                  "column (with =).");
+    }
+    const auto results = scatter(toSQL(tokens, mustWait), shard);
+    // Merge the rows from the shards (in order of the shards) and print
+    // them just like a single process does.
+    BatchSink* const sink = BatchSink::current();
+    size_t numSelects = 0;
+    for (const auto& res : results) {
+        for (const auto& batch : res.batches) {
+            if (numSelects == 0 && batch.rows > 0) {
+                StrVec colNames;
+                for (const auto& column : batch.columns) {
+                    colNames.push_back(column.name);
+                }
+                if (sink != nullptr) {
+                    sink->start(colNames);
+                } else {
+                    os << colNames << std::endl;
+                }
+            }
+            for (size_t row = 0; (row < batch.rows); row++) {
+                std::string delim = "";
+                for (const auto& column : batch.columns) {
+                    if (sink != nullptr) {
+                        sink->add(column.text(row));
+                    } else {
+                        os << delim << column.text(row);
+                        delim = "\t";
+                    }
+                }
+                if (sink != nullptr) {
+                    sink->endRow();
+                } else {
+                    os << std::endl;
+                }
+            }
+            numSelects += batch.rows;
+        }
+    }
+    os << numSelects << " row(s) selected.\n";
+}
+
+void
+Coordinator::update(const StrVec& tokens, bool mustWait, std::ostream& os) {
+    const std::string table = Helper::getCSVInfo(tokens, "update");
+    if (table.empty()) {
+        throw Exp("A table name is required in queries with shards.");
+    }
+    const std::string key = columns(table).front();
+    // A row whose key changes may belong to another shard.
+    const int setIdx   = Helper::find(tokens, "set");
+    const int whereIdx = Helper::find(tokens, "where");
+    const int endIdx   = (whereIdx == -1 ? tokens.size() : whereIdx);
+    for (int i = setIdx + 1; (setIdx != -1 && i + 1 < endIdx); i++) {
+        if (tokens[i] == key && tokens[i + 1] == "=") {
+            throw Exp("The first column (" + key + ") cannot be updated "
+                      "with shards.");
+        }
+    }
+    const int shard = route(tokens, key);
+    if (mustWait && shard == -1) {
+        throw Exp("wait with shards requires a condition on the first "
+                  "column (with =).");
+    }
+    long numUpdates = 0;
+    for (const auto& res : scatter(toSQL(tokens, mustWait), shard)) {
+        numUpdates += std::stol(res.message);  // "N row(s) updated."
+    }
+    os << numUpdates << " row(s) updated.\n";
+}
+
+std::vector<SQLAirClient::Result>
+Coordinator::scatter(const std::string& sql, int shard) {
+    const int first = (shard == -1 ? 0 : shard);
+    const int last  = (shard == -1 ? shards.size() : shard + 1);
+    // Start the query on all the shards before waiting for any of them.
+    std::deque<Lease> leases;
+    std::vector<uint32_t> reqIds;
+    for (int i = first; (i < last); i++) {
+        leases.emplace_back(*this, i);
+        reqIds.push_back(leases.back()->send(sql));
+        leases.back()->flush();
+    }
+    std::vector<SQLAirClient::Result> results;
+    for (size_t i = 0; (i < leases.size()); i++) {
+        results.push_back(leases[i]->wait(reqIds[i]));
+        leases[i].done();
+    }
+    return results;
+}
+
+StrVec
+Coordinator::columns(const std::string& table) {
+    {
+        std::lock_guard<std::mutex> guard(mutex);
+        const auto entry = tables.find(table);
+        if (entry != tables.end()) {
+            return entry->second;
+        }
+    }
+    // All the shards have the same columns, so ask the first one.
+    const auto results = scatter(toSQL({"describe", table}, false), 0);
+    StrVec colNames;
+    std::istringstream is(Helper::trim(results.front().message));
+    for (std::string col; std::getline(is, col, '\t');) {
+        colNames.push_back(col);
+    }
+    if (colNames.empty()) {
+        throw Exp("Table " + table + " has no columns.");
+    }
+    std::lock_guard<std::mutex> guard(mutex);
+    return (tables[table] = colNames);
+}
+
+int
+Coordinator::route(const StrVec& tokens, const std::string& key) const {
+    const int whereIdx = Helper::find(tokens, "where");
+    if (whereIdx == -1) {
+        return -1;
+    }
+    // With or/not (or parentheses) matching rows could be anywhere.
+    const int size = tokens.size();
+    for (int i = whereIdx + 1; (i < size); i++) {
+        if (tokens[i] == "or" || tokens[i] == "not" ||
+            tokens[i].find('(') != std::string::npos) {
+            return -1;
+        }
+    }
+    // Otherwise, a key = value condition gives the only possible shard.
+    for (int i = whereIdx + 1; (i + 2 < size); i++) {
+        if ((i == whereIdx + 1 || tokens[i - 1] == "and") &&
+            tokens[i] == key && tokens[i + 1] == "=") {
+            return ShardSpec::owner(tokens[i + 2], shards.size());
+        }
+    }
+    return -1;
+}
+
+std::string
+Coordinator::toSQL(const StrVec& tokens, bool mustWait) {
+    std::string sql = (mustWait ? "wait" : "");
+    for (const auto& token : tokens) {
+        const char quote = (token.find('\'') == std::string::npos ?
+                            '\'' : '"');
+        if (token.find(quote) != std::string::npos) {
+            throw Exp("Values with both ' and \" are not supported with "
+                      "shards.");
+        }
+        sql += (sql.empty() ? "" : " ");
+        sql += quote + token + quote;
+    }
+    return sql;
+}
+
+//--------------------------[  Coordinator::Lease  ]-----------------------
+
+Coordinator::Lease::Lease(Coordinator& coord, int shard) : coord(coord),
+    shard(shard) {
+    {
+        std::lock_guard<std::mutex> guard(coord.mutex);
+        auto& pool = coord.idle[shard];
+        if (!pool.empty()) {
+            client = std::move(pool.back());
+            pool.pop_back();
+        }
+    }
+    if (client == nullptr) {
+        // Connect outside the lock, as this can take a while.
+        client.reset(new SQLAirClient(coord.shards[shard].first,
+                                      coord.shards[shard].second));
+    }
+}
+
+Coordinator::Lease::~Lease() {
+    if (ok) {
+        std::lock_guard<std::mutex> guard(coord.mutex);
+        coord.idle[shard].push_back(std::move(client));
+    }
+}
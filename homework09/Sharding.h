@@ -0,0 +1,154 @@
+#ifndef SHARDING_H
+#define SHARDING_H
+
+/*
+ * Copyright (C) Ethan Gutknecht 2021 (gutkneET@miamioh.edu)
+ *
+ * Hash partitioning of tables across several SQLAir processes (shards).
+ * Each shard keeps only the rows whose first column hashes to it. A
+ * coordinator process (that has no data) runs each select and update on
+ * the shards and merges their results. The processes are configured via
+ * environment variables, for example, for 2 shards and a coordinator:
+ *
+ *     SQLAIR_SHARD=0/2 SQLAIR_BINARY_PORT=5011 ./homework09 5010 &
+ *     SQLAIR_SHARD=1/2 SQLAIR_BINARY_PORT=5021 ./homework09 5020 &
+ *     SQLAIR_SHARDS=localhost:5011,localhost:5021 ./homework09 5000
+ *
+ * The coordinator uses the binary protocol port (SQLAIR_BINARY_PORT) of
+ * each shard. Clients use the coordinator just like a single SQLAir server.
+ */
+
+#include <mutex>
+#include <memory>
+#include <string>
+#include <vector>
+#include <iostream>
+#include <unordered_map>
+#include "CSV.h"
+#include "SQLAirClient.h"
+
+/** The shard that this process is, if any */
+class ShardSpec {
+public:
+    /** The index of this shard */
+    int index = 0;
+
+    /** The number of shards. Zero if this process is not a shard */
+    int count = 0;
+
+    /**
+     * Returns the shard set by the SQLAIR_SHARD environment variable, in
+     * the form "index/count".
+     *
+     * @exception Exp Thrown if the variable is not valid.
+     */
+    static ShardSpec fromEnv();
+
+    /** Returns the shard that owns the rows with a given key */
+    static int owner(const std::string& key, int numShards);
+
+    /** Removes the rows of a (newly loaded) table not owned by this shard */
+    void filter(CSV& csv) const;
+};
+
+/**
+ * Runs queries on a set of shards and merges the results. Point queries
+ * (with a "key = value" condition on the first column, not combined with
+ * or/not) are sent only to the shard that owns the key. All other queries
+ * are sent to all the shards at the same time.
+ */
+class Coordinator {
+public:
+    /**
+     * Creates a coordinator for the given shards.
+     *
+     * @param shards The host:port (of the binary protocol) of each shard.
+     */
+    explicit Coordinator(const StrVec& shards);
+
+    /**
+     * Returns a coordinator for the shards in the SQLAIR_SHARDS environment
+     * variable (a comma-separated list of host:port) or nullptr if the
+     * variable is not set.
+     */
+    static std::unique_ptr<Coordinator> fromEnv();
+
+    /**
+     * Runs a select, update, or describe statement on the shards. The
+     * results are written in the same form as by a single SQLAir process.
+     *
+     * @param tokens The tokens in the statement, from preprocess.
+     * @param mustWait Flag to indicate if the query must keep running until
+     * at least 1 matching row is found.
+     * @param os The output stream to where the results are to be written.
+     *
+     * @exception Exp Thrown on errors in the statement or from a shard.
+     */
+    void process(const StrVec& tokens, bool mustWait, std::ostream& os);
+
+private:
+    /**
+     * A connection to a shard that is borrowed from the pool of idle
+     * connections. It is returned to the pool only if it is done(), as
+     * otherwise it may have replies that have not been read.
+     */
+    class Lease {
+    public:
+        Lease(Coordinator& coord, int shard);
+        ~Lease();
+
+        /** Marks the connection as ready to be used by other queries */
+        void done() { ok = true; }
+
+        SQLAirClient* operator->() { return client.get(); }
+
+    private:
+        Coordinator& coord;
+        const int shard;
+        std::unique_ptr<SQLAirClient> client;
+        bool ok = false;
+    };
+
+    /** Runs a select on the shards and merges the rows */
+    void select(const StrVec& tokens, bool mustWait, std::ostream& os);
+
+    /** Runs an update on the shards and adds up the rows updated */
+    void update(const StrVec& tokens, bool mustWait, std::ostream& os);
+
+    /**
+     * Runs a query on the given shards (or all shards if shard is -1).
+     *
+     * @return The results from each shard, in order of the shards.
+     */
+    std::vector<SQLAirClient::Result> scatter(const std::string& sql,
+        int shard);
+
+    /** Returns the columns of a table (from the first shard) */
+    StrVec columns(const std::string& table);
+
+    /**
+     * Returns the shard that owns all the rows that may match the where
+     * clause of a query, or -1 if such rows can be on any shard.
+     */
+    int route(const StrVec& tokens, const std::string& key) const;
+
+    /**
+     * Converts tokens back to a query. Tokens are quoted, so that the shard
+     * gets exactly the same tokens.
+     */
+    static std::string toSQL(const StrVec& tokens, bool mustWait);
+
+    /** The host and port of each shard */
+    std::vector<std::pair<std::string, std::string>> shards;
+
+    /** The idle connections to each shard */
+    std::vector<std::vector<std::unique_ptr<SQLAirClient>>> idle;
+
+    /** The columns of each table used so far */
+    std::unordered_map<std::string, StrVec> tables;
+
+    /** The mutex to guard the above data */
+    std::mutex mutex;
+};
+
+#endif /* SHARDING_H */
@@ -0,0 +1,149 @@
+/*
+ * Copyright (C) Ethan Gutknecht 2021 (gutkneET@miamioh.edu)
+ *
+ * Implementation of serving static files to web-clients.
+ */
+
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/sendfile.h>
+#include <sys/socket.h>
+#include <cerrno>
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include "StaticFiles.h"
+#include "HTTPFile.h"
+
+// Definition for the constant used by reference.
+const off_t StaticFiles::MaxCachedSize;
+
+// Helper method to wait until a socket can be written to. Returns false
+// if the socket is not writable in a reasonable amount of time.
+static bool waitWritable(int sock) {
+    struct pollfd pfd = {sock, POLLOUT, 0};
+    return poll(&pfd, 1, 30 * 1000) == 1;
+}
+
+size_t
+StaticFiles::send(int sock, const std::string& path,
+        const std::string& ifNoneMatch) {
+    struct stat info;
+    // Do not serve files outside the current directory.
+    if (path.find("..") != std::string::npos ||
+        stat(path.c_str(), &info) != 0 || !S_ISREG(info.st_mode)) {
+        return sendStatus(sock, "404 Not Found", "", "File not found.\n");
+    }
+    const std::string etag = etagOf(info);
+    if (!ifNoneMatch.empty() && (ifNoneMatch == "*" ||
+        ifNoneMatch.find(etag) != std::string::npos)) {
+        // The client's cached copy is the current version of the file.
+        return sendStatus(sock, "304 Not Modified", "ETag: " + etag + "\r\n");
+    }
+    if (info.st_size <= MaxCachedSize) {
+        std::shared_ptr<const Entry> entry;
+        {
+            std::lock_guard<std::mutex> guard(mutex);
+            const auto found = cache.find(path);
+            if (found != cache.end() && found->second->etag == etag) {
+                entry = found->second;
+            }
+        }
+        if (entry == nullptr) {
+            // Read the file (outside the lock) and cache it with headers.
+            std::ifstream is(path, std::ios::binary);
+            const std::string body((std::istreambuf_iterator<char>(is)),
+                                   std::istreambuf_iterator<char>());
+            std::shared_ptr<Entry> newEntry = std::make_shared<Entry>();
+            newEntry->etag     = etag;
+            newEntry->response = headers(path, body.size(), etag) + body;
+            std::lock_guard<std::mutex> guard(mutex);
+            cache[path] = entry = newEntry;
+        }
+        return writeAll(sock, entry->response.data(), entry->response.size());
+    }
+    // Large files are sent directly from the file to the socket.
+    const int fd = open(path.c_str(), O_RDONLY);
+    if (fd == -1) {
+        return sendStatus(sock, "404 Not Found", "", "File not found.\n");
+    }
+    const std::string hdrs = headers(path, info.st_size, etag);
+    size_t sent = writeAll(sock, hdrs.data(), hdrs.size());
+    for (off_t offset = 0; (offset < info.st_size);) {
+        const ssize_t bytes = sendfile(sock, fd, &offset,
+                                       info.st_size - offset);
+        if (bytes > 0) {
+            sent += bytes;
+        } else if (bytes == 0 || (errno != EINTR && (errno != EAGAIN ||
+                   !waitWritable(sock)))) {
+            break;  // The file was truncated or the client went away.
+        }
+    }
+    close(fd);
+    return sent;
+}
+
+std::string
+StaticFiles::headers(const std::string& path, off_t size,
+        const std::string& etag) {
+    // The browser must revalidate (with If-None-Match) before reusing
+    // its cached copy, so that changes to files are seen right away.
+    return "HTTP/1.1 200 OK\r\n"
+        "Server: localhost\r\n"
+        "Connection: Close\r\n"
+        "Cache-Control: no-cache\r\n"
+        "Content-Type: " + contentType(path) + "\r\n"
+        "Content-Length: " + std::to_string(size) + "\r\n"
+        "ETag: " + etag + "\r\n\r\n";
+}
+
+std::string
+StaticFiles::etagOf(const struct stat& info) {
+    char etag[64];
+    std::snprintf(etag, sizeof(etag), "\"%lx.%lx-%lx\"",
+                  static_cast<long>(info.st_mtim.tv_sec),
+                  static_cast<long>(info.st_mtim.tv_nsec),
+                  static_cast<long>(info.st_size));
+    return etag;
+}
+
+std::string
+StaticFiles::contentType(const std::string& path) {
+    // Types for binary files, which need to be correct for browsers.
+    const std::unordered_map<std::string, std::string> Types = {
+        {"png", "image/png"}, {"ico", "image/x-icon"},
+        {"jpg", "image/jpeg"}, {"gif", "image/gif"},
+        {"js", "application/javascript"}, {"css", "text/css"}};
+    const size_t dot = path.rfind('.');
+    const auto type = (dot == std::string::npos ? Types.end() :
+                       Types.find(path.substr(dot + 1)));
+    return (type != Types.end() ? type->second : http::getContentType(path));
+}
+
+size_t
+StaticFiles::writeAll(int sock, const char* data, size_t size) {
+    size_t sent = 0;
+    while (sent < size) {
+        const ssize_t bytes = ::send(sock, data + sent, size - sent,
+                                     MSG_NOSIGNAL);
+        if (bytes > 0) {
+            sent += bytes;
+        } else if (bytes == 0 || (errno != EINTR && (errno != EAGAIN ||
+                   !waitWritable(sock)))) {
+            break;  // The client went away.
+        }
+    }
+    return sent;
+}
+
+size_t
+StaticFiles::sendStatus(int sock, const std::string& status,
+        const std::string& extraHeaders, const std::string& body) {
+    const std::string resp = "HTTP/1.1 " + status + "\r\n"
+        "Server: localhost\r\n"
+        "Connection: Close\r\n" + extraHeaders +
+        "Content-Type: text/plain\r\n"
+        "Content-Length: " + std::to_string(body.size()) + "\r\n\r\n" + body;
+    return writeAll(sock, resp.data(), resp.size());
+}
@@ -0,0 +1,95 @@
+#ifndef STATIC_FILES_H
+#define STATIC_FILES_H
+
+/*
+ * Copyright (C) Ethan Gutknecht 2021 (gutkneET@miamioh.edu)
+ *
+ * Serving static files (such as the files in the web folder) to
+ * web-clients. Files are sent as-is (so binary files such as PNG and ICO
+ * are sent correctly) with a Content-Length header and an ETag, so that
+ * browsers can revalidate cached copies via If-None-Match.
+ */
+
+#include <mutex>
+#include <string>
+#include <memory>
+#include <unordered_map>
+#include <sys/stat.h>
+
+/**
+ * Sends static files to web-clients. Small files are kept in memory along
+ * with their HTTP headers and are sent with a single system call. Larger
+ * files are sent from the file to the socket using sendfile(2), without
+ * copying the data through user space. Cached files are checked for
+ * changes (via stat) on each request.
+ */
+class StaticFiles {
+public:
+    /**
+     * Sends a file (or a 304 or 404 response) to a client.
+     *
+     * @param sock The native handle of the client's socket. Any data
+     * buffered in the client's stream must be flushed before calling
+     * this method.
+     * @param path The path to the file, relative to the current directory.
+     * @param ifNoneMatch The value of the If-None-Match header, if any.
+     *
+     * @return The number of bytes sent.
+     */
+    size_t send(int sock, const std::string& path,
+        const std::string& ifNoneMatch);
+
+private:
+    /** Files up to this size (in bytes) are kept in memory */
+    static const off_t MaxCachedSize = 256 * 1024;
+
+    /** A file kept in memory */
+    struct Entry {
+        /** The entity tag for the version of the file that was read */
+        std::string etag;
+        /** The HTTP headers followed by the contents of the file */
+        std::string response;
+    };
+
+    /**
+     * Returns the HTTP headers to send a file.
+     *
+     * @param path The path to the file, used to determine its type.
+     * @param size The size of the file.
+     * @param etag The entity tag for the file.
+     */
+    static std::string headers(const std::string& path, off_t size,
+        const std::string& etag);
+
+    /** Returns the entity tag for a file, based on its mtime and size */
+    static std::string etagOf(const struct stat& info);
+
+    /** Returns the content type based on the extension of a file */
+    static std::string contentType(const std::string& path);
+
+    /**
+     * Writes data to a socket, waiting if the socket's buffer is full.
+     *
+     * @return The number of bytes written.
+     */
+    static size_t writeAll(int sock, const char* data, size_t size);
+
+    /**
+     * Sends a response that is not a file, such as 304 or 404.
+     *
+     * @param sock The native handle of the client's socket.
+     * @param status The status code and reason, e.g., "404 Not Found".
+     * @param extraHeaders Additional headers, each ending with "\r\n".
+     * @param body The body of the response.
+     */
+    static size_t sendStatus(int sock, const std::string& status,
+        const std::string& extraHeaders, const std::string& body = "");
+
+    /** The cached files with their paths as the key */
+    std::unordered_map<std::string, std::shared_ptr<const Entry>> cache;
+
+    /** The mutex to guard the cache */
+    std::mutex mutex;
+};
+
+#endif /* STATIC_FILES_H */
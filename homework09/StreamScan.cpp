@@ -0,0 +1,107 @@
+/*
+ * Copyright (C) Ethan Gutknecht 2021 (gutkneET@miamioh.edu)
+ *
+ * Implementation of scans of CSV files in blocks of a fixed size.
+ */
+
+#include <cstring>
+#include <sstream>
+#include "StreamScan.h"
+#include "LazyColumns.h"
+#include "Helper.h"
+
+// Definition for the constant used by reference.
+const size_t StreamScan::BlockSize;
+
+StreamScan::StreamScan(const std::string& path) :
+    file(path, std::ios::binary), buffer(BlockSize) {
+    if (!file.good()) {
+        throw Exp("Unable to open " + path + " to stream it.");
+    }
+    // The CSV gets the column names from the header line.
+    std::string line;
+    if (!std::getline(file, line)) {
+        throw Exp("The file " + path + " is empty.");
+    }
+    std::istringstream is(line + "\n");
+    header.load(is);
+    numCols = header.getColumnCount();
+    fields.resize(numCols + 1);
+    values.resize(numCols);
+    decoded.resize(numCols);
+}
+
+bool
+StreamScan::fill() {
+    // Move the partial line (if any) to the front of the buffer.
+    std::memmove(buffer.data(), buffer.data() + pos, end - pos);
+    end -= pos;
+    pos  = 0;
+    if (end == buffer.size()) {
+        buffer.resize(buffer.size() * 2);  // A very long line.
+    }
+    file.read(buffer.data() + end, buffer.size() - end);
+    end += file.gcount();
+    return file.gcount() > 0;
+}
+
+bool
+StreamScan::next() {
+    size_t lineEnd, nextLine;
+    do {
+        // Find the end of the next line, reading more of the file as needed.
+        // The last line of the file may not end with a newline.
+        const char* newline;
+        while ((newline = static_cast<const char*>(std::memchr(
+                    buffer.data() + pos, '\n', end - pos))) == nullptr) {
+            if (!fill()) {
+                if (pos == end) {
+                    return false;
+                }
+                buffer.resize(std::max(buffer.size(), end + 1));
+                buffer[end++] = '\n';
+            }
+        }
+        nextLine = newline - buffer.data() + 1;
+        lineEnd  = nextLine - 1;
+        if (lineEnd > pos && buffer[lineEnd - 1] == '\r') {
+            lineEnd--;
+        }
+        if (lineEnd == pos) {
+            pos = nextLine;  // Skip empty lines.
+        }
+    } while ((pos == nextLine));
+    // Record where the fields of the line start.
+    fields[0] = pos;
+    int field = 1;
+    bool quoted = false;
+    for (size_t i = pos; (i < lineEnd && field <= numCols); i++) {
+        if (buffer[i] == '"') {
+            quoted = !quoted;  // A doubled quote toggles this twice.
+        } else if (buffer[i] == ',' && !quoted) {
+            fields[field++] = i + 1;  // Extra fields are ignored.
+        }
+    }
+    // The end of the line ends the last field. Missing fields are empty.
+    while ((field <= numCols)) {
+        fields[field++] = lineEnd + 1;
+    }
+    pos = nextLine;
+    rows++;
+    return true;
+}
+
+const std::string&
+StreamScan::value(int col) {
+    if (decoded[col] != rows) {
+        const size_t begin = fields[col], next = fields[col + 1];
+        if (next <= begin) {
+            values[col].clear();  // A missing field.
+        } else {
+            LazyColumns::unquote(buffer.data() + begin, next - 1 - begin,
+                                 values[col]);
+        }
+        decoded[col] = rows;
+    }
+    return values[col];
+}
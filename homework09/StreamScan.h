@@ -0,0 +1,100 @@
+#ifndef STREAM_SCAN_H
+#define STREAM_SCAN_H
+
+/*
+ * Copyright (C) Ethan Gutknecht 2021 (gutkneET@miamioh.edu)
+ *
+ * Scans of CSV files that are too large to be loaded in memory, used by
+ * "select ... from stream('big.csv')" queries. The file is read in blocks
+ * of a fixed size and the rows are evaluated one at a time as they are
+ * read. So the memory used does not depend on the size of the file. The
+ * values in a row are decoded only when the query uses them.
+ */
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <fstream>
+#include "CSV.h"
+
+/** A scan of the rows of a CSV file, in the order they are in the file */
+class StreamScan {
+public:
+    /** The number of bytes read from the file at a time */
+    static const size_t BlockSize = 1 << 20;
+
+    /**
+     * Opens a CSV file and reads its header.
+     *
+     * @param path The path to the CSV file.
+     *
+     * @exception Exp Thrown if the file could not be opened or does not
+     * have a header.
+     */
+    explicit StreamScan(const std::string& path);
+
+    /** Returns a CSV with the columns of the file (but without any rows) */
+    const CSV& columns() const { return header; }
+
+    /**
+     * Moves to the next (non-empty) row in the file.
+     *
+     * @return false if there are no more rows in the file.
+     */
+    bool next();
+
+    /**
+     * Returns a value in the current row. Missing values are empty.
+     *
+     * @param col The zero-based index of the column.
+     */
+    const std::string& value(int col);
+
+    /** Returns the number of rows scanned so far */
+    size_t rowsScanned() const { return rows; }
+
+private:
+    /**
+     * Reads the next block of the file, after the unused part of the
+     * buffer. The buffer grows only if a line is longer than a block.
+     *
+     * @return false if there is no more data in the file.
+     */
+    bool fill();
+
+    /** The file being scanned */
+    std::ifstream file;
+
+    /** The columns of the file */
+    CSV header;
+
+    /** The number of columns in the file */
+    int numCols = 0;
+
+    /** The data read from the file. Only [pos, end) is yet to be used */
+    std::vector<char> buffer;
+
+    /** The offset in the buffer of the next line */
+    size_t pos = 0;
+
+    /** The number of bytes of data in the buffer */
+    size_t end = 0;
+
+    /**
+     * The offset in the buffer where each field of the current row starts
+     * (numCols + 1 entries). A field ends just before the delimiter
+     * preceding the start of the next one.
+     */
+    std::vector<size_t> fields;
+
+    /** The decoded values of the current row */
+    StrVec values;
+
+    /** The row for which each value was decoded */
+    std::vector<size_t> decoded;
+
+    /** The number of rows read so far. The current row is numbered this */
+    size_t rows = 0;
+};
+
+#endif /* STREAM_SCAN_H */
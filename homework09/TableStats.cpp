@@ -0,0 +1,268 @@
+/*
+ * Copyright (C) Ethan Gutknecht 2021 (gutkneET@miamioh.edu)
+ *
+ * Implementation of the statistics on the columns of a table.
+ */
+
+#include <cmath>
+#include <cstdlib>
+#include <algorithm>
+#include <functional>
+#include <unordered_map>
+#include <unordered_set>
+#include "TableStats.h"
+#include "Helper.h"
+
+// Mix the bits of a hash (the finalizer of splitmix64), as HyperLogLog
+// needs all the bits to be uniformly distributed.
+static uint64_t
+mix(uint64_t hash) {
+    hash = (hash ^ (hash >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    hash = (hash ^ (hash >> 27)) * 0x94d049bb133111ebULL;
+    return hash ^ (hash >> 31);
+}
+
+// Check if a value is a number, as compared by where clauses.
+static bool
+isNumber(const std::string& value) {
+    char* end = nullptr;
+    std::strtod(value.c_str(), &end);
+    return !value.empty() && *end == '\0';
+}
+
+void
+HyperLogLog::add(const std::string& value) {
+    const uint64_t hash = mix(std::hash<std::string>()(value));
+    // The first bits choose the register and the rest are the run.
+    const uint64_t rest = hash << Bits;
+    const uint8_t rank = (rest == 0 ? 64 - Bits + 1 :
+                          __builtin_clzll(rest) + 1);
+    uint8_t& reg = registers[hash >> (64 - Bits)];
+    reg = std::max(reg, rank);
+}
+
+double
+HyperLogLog::estimate() const {
+    double sum = 0;
+    size_t zeros = 0;
+    for (const uint8_t reg : registers) {
+        sum   += std::ldexp(1.0, -reg);
+        zeros += (reg == 0);
+    }
+    const double m = NumRegisters;
+    const double raw = 0.7213 / (1 + 1.079 / m) * m * m / sum;
+    // Few distinct values are estimated better by the empty registers.
+    if (raw <= 2.5 * m && zeros > 0) {
+        return m * std::log(m / zeros);
+    }
+    return raw;
+}
+
+void
+TableStats::analyze(const CSV& csv, const Dictionary& dict) {
+    std::shared_ptr<Snapshot> snapshot = std::make_shared<Snapshot>();
+    const size_t numRows = csv.size();
+    const int numCols = csv.getColumnCount();
+    snapshot->rows = numRows;
+    snapshot->columns.resize(numCols);
+    // Changes made during the scan may or may not be seen. So they count
+    // toward the next analyze.
+    numChanged = 0;
+    // The sketches use all the rows, while the mcvs and histograms use
+    // every step-th row.
+    const size_t step = std::max<size_t>(1, (numRows + SampleRows - 1) /
+                                         SampleRows);
+    std::vector<HyperLogLog> sketches(numCols);
+    std::vector<StrVec> samples(numCols);
+    for (size_t rowIdx = 0; (rowIdx < numRows); rowIdx++) {
+        const CSVRow& row = csv[rowIdx];
+        const bool sampled = (rowIdx % step == 0);
+        for (int col = 0; (col < numCols); col++) {
+            const std::string& value = dict.get(row, rowIdx, col);
+            sketches[col].add(value);
+            if (sampled) {
+                samples[col].push_back(value);
+            }
+        }
+    }
+    for (int col = 0; (col < numCols); col++) {
+        ColumnStats& stats = snapshot->columns[col];
+        summarize(samples[col], stats);
+        stats.distinct = std::max<double>(std::round(sketches[col].estimate()),
+                                          stats.mcvs.size());
+    }
+    std::lock_guard<std::mutex> guard(mutex);
+    collected = std::move(snapshot);
+}
+
+void
+TableStats::summarize(StrVec& sample, ColumnStats& stats) {
+    if (sample.empty()) {
+        return;
+    }
+    std::unordered_map<std::string, size_t> counts;
+    for (const auto& value : sample) {
+        counts[value]++;
+    }
+    // If the sample has only a few distinct values, they are all kept.
+    // Otherwise, only the values that are more common than the average.
+    const double average = double(sample.size()) / counts.size();
+    std::vector<std::pair<size_t, std::string>> common;
+    for (const auto& entry : counts) {
+        if (counts.size() <= NumMCVs ||
+            (entry.second > 1 && entry.second > 1.25 * average)) {
+            common.push_back({entry.second, entry.first});
+        }
+    }
+    std::sort(common.begin(), common.end(),
+        [](const std::pair<size_t, std::string>& c1,
+           const std::pair<size_t, std::string>& c2) {
+            return c1.first > c2.first ||
+                (c1.first == c2.first && c1.second < c2.second);
+        });
+    if (common.size() > NumMCVs) {
+        common.resize(NumMCVs);
+    }
+    std::unordered_set<std::string> mcvs;
+    for (const auto& entry : common) {
+        const double frac = double(entry.first) / sample.size();
+        stats.mcvs.push_back({entry.second, frac});
+        stats.otherFrac -= frac;
+        mcvs.insert(entry.second);
+    }
+    stats.otherFrac = std::max(stats.otherFrac, 0.0);
+    // The histogram is built from the rest of the values, except empty
+    // ones (that are not numbers but are common in numeric columns).
+    sample.erase(std::remove_if(sample.begin(), sample.end(),
+        [&mcvs](const std::string& value) {
+            return value.empty() || mcvs.count(value) > 0;
+        }), sample.end());
+    if (sample.size() < 2) {
+        return;
+    }
+    stats.numeric = std::all_of(sample.begin(), sample.end(), isNumber);
+    if (stats.numeric) {
+        std::sort(sample.begin(), sample.end(),
+            [](const std::string& v1, const std::string& v2) {
+                return std::strtod(v1.c_str(), nullptr) <
+                    std::strtod(v2.c_str(), nullptr);
+            });
+    } else {
+        std::sort(sample.begin(), sample.end());
+    }
+    for (size_t i = 0; (i <= NumBuckets); i++) {
+        stats.bounds.push_back(sample[i * (sample.size() - 1) / NumBuckets]);
+    }
+}
+
+std::shared_ptr<const TableStats::Snapshot>
+TableStats::latest() const {
+    std::lock_guard<std::mutex> guard(mutex);
+    return collected;
+}
+
+bool
+TableStats::stale() const {
+    const auto snapshot = latest();
+    return snapshot != nullptr && numChanged > 50 + snapshot->rows / 10;
+}
+
+double
+TableStats::selectivity(const Predicate& cmp) const {
+    const auto snapshot = latest();
+    const int col = cmp.col.second;
+    if (snapshot == nullptr || col < 0 ||
+        col >= (int) snapshot->columns.size()) {
+        return -1;
+    }
+    const ColumnStats& stats = snapshot->columns[col];
+    if (cmp.cond == "=" || cmp.cond == "<>") {
+        // A value that is not an mcv is assumed to be as common as any of
+        // the other distinct values.
+        double equal = -1;
+        for (const auto& mcv : stats.mcvs) {
+            equal = (mcv.first == cmp.value ? mcv.second : equal);
+        }
+        if (equal < 0) {
+            const double others = stats.distinct - stats.mcvs.size();
+            equal = (others >= 1 ? stats.otherFrac / others : 0);
+        }
+        equal = std::min(equal, 1.0);
+        return (cmp.cond == "=" ? equal : 1 - equal);
+    }
+    // The mcvs are checked directly and the rest via the histogram.
+    double sel = 0;
+    for (const auto& mcv : stats.mcvs) {
+        sel += (cmp.compareValue(mcv.first) ? mcv.second : 0);
+    }
+    double others = 0;
+    if (stats.bounds.empty()) {
+        others = (cmp.cond == "like" ? 0.25 : 1.0 / 3);
+    } else if (cmp.cond == "like") {
+        // The bounds are a sample of the values, spread evenly.
+        const auto matches = std::count_if(stats.bounds.begin(),
+            stats.bounds.end(), [&cmp](const std::string& value) {
+                return value.find(cmp.value) != std::string::npos;
+            });
+        others = std::max(double(matches), 0.5) / stats.bounds.size();
+    } else {
+        const double fracBelow = below(stats, cmp);
+        if (fracBelow < 0) {
+            return -1;
+        }
+        others = (cmp.cond[0] == '<' ? fracBelow : 1 - fracBelow);
+    }
+    return std::min(sel + stats.otherFrac * others, 1.0);
+}
+
+double
+TableStats::below(const ColumnStats& stats, const Predicate& cmp) {
+    const StrVec& bounds = stats.bounds;
+    const size_t buckets = bounds.size() - 1;
+    if (stats.numeric != cmp.isNum) {
+        return -1;  // Compared partly as strings and partly as numbers.
+    } else if (!stats.numeric) {
+        // Strings are only placed in their bucket.
+        const auto pos = std::lower_bound(bounds.begin(), bounds.end(),
+                                          cmp.value);
+        return double(pos - bounds.begin()) / bounds.size();
+    }
+    const auto bound = [&bounds](size_t i) {
+        return std::strtod(bounds[i].c_str(), nullptr);
+    };
+    if (cmp.num <= bound(0)) {
+        return 0;
+    } else if (cmp.num >= bound(buckets)) {
+        return 1;
+    }
+    // Find the bucket with the value and assume that the values in the
+    // bucket are spread evenly.
+    size_t lo = 0, hi = buckets;
+    while ((hi - lo > 1)) {
+        const size_t mid = (lo + hi) / 2;
+        (bound(mid) <= cmp.num ? lo : hi) = mid;
+    }
+    const double lower = bound(lo), upper = bound(hi);
+    const double within = (upper > lower ? (cmp.num - lower) /
+                           (upper - lower) : 0.5);
+    return (lo + within) / buckets;
+}
+
+double
+TableStats::distinct(int col) const {
+    const auto snapshot = latest();
+    if (snapshot == nullptr || col < 0 ||
+        col >= (int) snapshot->columns.size()) {
+        return -1;
+    }
+    return std::max(snapshot->columns[col].distinct, 1.0);
+}
+
+ColumnStats
+TableStats::column(int col) const {
+    const auto snapshot = latest();
+    if (snapshot == nullptr) {
+        throw Exp("The table has not been analyzed.");
+    }
+    return snapshot->columns.at(col);
+}
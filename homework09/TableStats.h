@@ -0,0 +1,190 @@
+#ifndef TABLE_STATS_H
+#define TABLE_STATS_H
+
+/*
+ * Copyright (C) Ethan Gutknecht 2021 (gutkneET@miamioh.edu)
+ *
+ * Statistics on the values in the columns of a table, collected by an
+ * "analyze a.csv" statement. For each column, the statistics include the
+ * number of distinct values (estimated via a HyperLogLog sketch of all the
+ * rows), the most common values, and an equi-depth histogram of the other
+ * values (both from a sample of the rows). The planner uses them to
+ * estimate the selectivity of conditions in where clauses, which orders
+ * the conditions, decides whether a trigram index is worth using, and
+ * picks the build side of hash joins.
+ *
+ * A table whose values changed a lot since it was analyzed is analyzed
+ * again by a background thread (see SQLAir::refreshStats).
+ */
+
+#include <mutex>
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <utility>
+#include "CSV.h"
+#include "Dictionary.h"
+#include "Predicate.h"
+
+/**
+ * A HyperLogLog sketch that estimates the number of distinct values added
+ * to it, using a fixed amount of memory (4 KB, for an error of about 2%).
+ */
+class HyperLogLog {
+public:
+    HyperLogLog() : registers(NumRegisters, 0) {}
+
+    /** Adds a value to the sketch */
+    void add(const std::string& value);
+
+    /** Returns the estimated number of distinct values added */
+    double estimate() const;
+
+private:
+    /** The number of bits of the hash that choose the register */
+    static const int Bits = 12;
+
+    /** The number of registers */
+    static const size_t NumRegisters = size_t(1) << Bits;
+
+    /** The longest run of leading zeros (plus one) seen in each register */
+    std::vector<uint8_t> registers;
+};
+
+/** The statistics on the values in a column */
+struct ColumnStats {
+    /** The estimated number of distinct values */
+    double distinct = 0;
+
+    /**
+     * The most common values, with the fraction of rows that have each
+     * value, most common first.
+     */
+    std::vector<std::pair<std::string, double>> mcvs;
+
+    /** The fraction of rows whose value is not one of the mcvs */
+    double otherFrac = 1;
+
+    /**
+     * The bounds of the buckets of an equi-depth histogram of the values
+     * that are not mcvs, in increasing order. Each bucket (between two
+     * consecutive bounds) has about the same number of rows.
+     */
+    StrVec bounds;
+
+    /** True if the values in bounds are numbers (and sorted as numbers) */
+    bool numeric = false;
+};
+
+/** The statistics on the columns of a table */
+class TableStats {
+public:
+    /** The most rows sampled for the mcvs and histograms */
+    static const size_t SampleRows = 30000;
+
+    /** The most common values kept for each column */
+    static const size_t NumMCVs = 20;
+
+    /** The number of buckets in each histogram */
+    static const size_t NumBuckets = 100;
+
+    /**
+     * Collects the statistics on all the columns of a CSV, replacing the
+     * earlier ones (if any). Queries that are being planned meanwhile use
+     * the earlier statistics. The caller must hold the lock on the rows,
+     * but not the lock on the CSV, as the statistics are only estimates.
+     *
+     * @param csv The CSV to be analyzed.
+     * @param dict The dictionary used to access the values of the rows.
+     */
+    void analyze(const CSV& csv, const Dictionary& dict);
+
+    /** Returns true if the table was analyzed */
+    bool analyzed() const { return latest() != nullptr; }
+
+    /**
+     * Returns true if the table was analyzed and then enough of its values
+     * changed (10% of its rows, plus 50) to analyze it again.
+     */
+    bool stale() const;
+
+    /**
+     * Notes changes to values of the table. This method is called (via
+     * Dictionary::set) each time a value is changed and by copy into.
+     *
+     * @param count The number of values changed.
+     */
+    void changed(size_t count = 1) { numChanged += count; }
+
+    /**
+     * Estimates the fraction of rows that meet a comparison on a column of
+     * this table.
+     *
+     * @param cmp A comparison (such as "year > 2010") in a where clause.
+     *
+     * @return The estimated selectivity, or a negative value if the table
+     * was not analyzed.
+     */
+    double selectivity(const Predicate& cmp) const;
+
+    /**
+     * Returns the estimated number of distinct values in a column, or a
+     * negative value if the table was not analyzed.
+     *
+     * @param col The zero-based index of the column.
+     */
+    double distinct(int col) const;
+
+    /**
+     * Returns the statistics on a column, for the output of analyze.
+     *
+     * @param col The zero-based index of the column.
+     *
+     * @exception Exp If the table was not analyzed.
+     */
+    ColumnStats column(int col) const;
+
+private:
+    /** The statistics collected by one analyze */
+    struct Snapshot {
+        /** The number of rows when the table was analyzed */
+        size_t rows;
+
+        /** The statistics on each column */
+        std::vector<ColumnStats> columns;
+    };
+
+    /** Returns the latest statistics, or nullptr if none */
+    std::shared_ptr<const Snapshot> latest() const;
+
+    /**
+     * Helper method to collect the mcvs and histogram of a column from a
+     * sample of its values.
+     *
+     * @param sample The values of the column in the sampled rows.
+     * @param stats The statistics to which the mcvs and bounds are added.
+     */
+    static void summarize(StrVec& sample, ColumnStats& stats);
+
+    /**
+     * Helper method to estimate the fraction of the values in a histogram
+     * that are less than a value.
+     *
+     * @param stats The statistics on the column.
+     * @param cmp The comparison whose value is used.
+     */
+    static double below(const ColumnStats& stats, const Predicate& cmp);
+
+    /** The latest statistics, replaced as a whole by analyze */
+    std::shared_ptr<const Snapshot> collected;
+
+    /** The number of values changed since the table was analyzed */
+    std::atomic<size_t> numChanged = {0};
+
+    /** Guards collected */
+    mutable std::mutex mutex;
+};
+
+#endif /* TABLE_STATS_H */
@@ -0,0 +1,143 @@
+/*
+ * Copyright (C) Ethan Gutknecht 2021 (gutkneET@miamioh.edu)
+ *
+ * Implementation of row versions and optimistic transactions.
+ */
+
+#include "Transaction.h"
+
+// The counter from where versions are assigned. Version 0 is the version
+// of all rows when a table is loaded.
+std::atomic<uint64_t> TableVersions::counter = {0};
+
+TableVersions::Writer::Writer(TableVersions& versions, bool active) :
+    versions(versions), version(active ? ++counter : 0) {
+    if (active) {
+        versions.writers++;
+    }
+}
+
+TableVersions::Writer::~Writer() {
+    if (version == 0) {
+        return;  // Not active.
+    }
+    if (changed) {
+        versions.latest.store(version, std::memory_order_release);
+    }
+    versions.writers--;
+}
+
+void
+TableVersions::grow(size_t rows) {
+    std::unique_ptr<std::atomic<uint64_t>[]> versions(
+        new std::atomic<uint64_t>[rows]());
+    for (size_t rowIdx = 0; (rowIdx < numRows); rowIdx++) {
+        versions[rowIdx].store(this->rows[rowIdx].load());
+    }
+    this->rows = std::move(versions);
+    numRows = rows;
+}
+
+bool
+Transaction::Table::matches(size_t rowIdx, const Predicate* where) {
+    // Get the version before reading the row, so that a change made while
+    // the row is being read is detected when validating.
+    const uint64_t version = versions.row(rowIdx);
+    bool isMatch = (where == nullptr);
+    if (!isMatch && writes.find(rowIdx) == writes.end()) {
+        isMatch = where->eval(csv[rowIdx]);
+    } else if (!isMatch) {
+        // The row was changed by this transaction. Use the new values.
+        isMatch = where->eval([this, rowIdx](int col) -> const std::string& {
+                return get(rowIdx, col);
+            });
+    }
+    if (isMatch) {
+        reads.emplace(rowIdx, version);  // Keeps the version when first read
+    }
+    return isMatch;
+}
+
+const std::string&
+Transaction::Table::get(size_t rowIdx, int col) const {
+    const auto row = writes.find(rowIdx);
+    if (row != writes.end()) {
+        const auto val = row->second.find(col);
+        if (val != row->second.end()) {
+            return val->second;
+        }
+    }
+    return dict.get(csv[rowIdx], rowIdx, col);
+}
+
+void
+Transaction::Table::keep(std::unique_ptr<Predicate> where) {
+    if (where != nullptr) {
+        predicates.push_back(std::move(where));
+    }
+}
+
+Transaction::Table&
+Transaction::use(CSV& csv, Dictionary& dict, TableVersions& vers) {
+    for (const auto& tbl : used) {
+        if (&tbl->csv == &csv) {
+            return *tbl;
+        }
+    }
+    used.emplace_back(new Table(csv, dict, vers));
+    return *used.back();
+}
+
+bool
+Transaction::validate() const {
+    for (const auto& tbl : used) {
+        if (tbl->versions.table() == tbl->startVersion) {
+            continue;  // No changes to this table. Nothing to check.
+        }
+        // The values in the where clauses may have been added to the
+        // dictionary since the statements ran. So their codes are looked
+        // up again.
+        for (const auto& where : tbl->predicates) {
+            where->bind(0, tbl->csv, tbl->dict);
+        }
+        // Check the rows that were changed after the transaction started.
+        for (size_t rowIdx = 0; (rowIdx < tbl->versions.size()); rowIdx++) {
+            const uint64_t version = tbl->versions.row(rowIdx);
+            if (version <= tbl->startVersion) {
+                continue;
+            }
+            const auto read = tbl->reads.find(rowIdx);
+            if (read != tbl->reads.end()) {
+                if (read->second != version) {
+                    return false;  // Row was changed after it was read.
+                }
+                continue;
+            }
+            // A row the transaction did not read must not now match any of
+            // the where clauses used in the transaction.
+            for (const auto& where : tbl->predicates) {
+                if (where->eval(tbl->csv[rowIdx])) {
+                    return false;
+                }
+            }
+        }
+    }
+    return true;
+}
+
+int
+Transaction::apply() {
+    int rowsChanged = 0;
+    for (const auto& tbl : used) {
+        TableVersions::Writer writer(tbl->versions);
+        for (const auto& write : tbl->writes) {
+            CSVRow& row = tbl->csv[write.first];
+            for (const auto& colVal : write.second) {
+                tbl->dict.set(row, write.first, colVal.first, colVal.second);
+            }
+            writer.bump(write.first);
+            rowsChanged++;
+        }
+    }
+    return rowsChanged;
+}
@@ -0,0 +1,238 @@
+#ifndef TRANSACTION_H
+#define TRANSACTION_H
+
+/*
+ * Copyright (C) Ethan Gutknecht 2021 (gutkneET@miamioh.edu)
+ *
+ * Row versions and multi-statement transactions that use optimistic
+ * concurrency control. The statements in a transaction run without locks,
+ * buffering their writes. At commit, the rows the transaction read are
+ * validated against their versions and the writes are applied while the
+ * tables are locked.
+ */
+
+#include <map>
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <cstdint>
+#include <unordered_map>
+#include "CSV.h"
+#include "Dictionary.h"
+#include "Predicate.h"
+
+/**
+ * The version of each row in a CSV. Each change to a table (an update
+ * statement or a commit) is assigned a new version number from a global
+ * counter. The rows changed are tagged with that version, and the table's
+ * version is set to it once the change is complete. So data read while the
+ * table's version does not change (and no change is in progress) is
+ * consistent with that version.
+ */
+class TableVersions {
+public:
+    /**
+     * Creates versions (all zero) for a given number of rows.
+     *
+     * @param rows The number of rows in the table.
+     */
+    explicit TableVersions(size_t rows) :
+        rows(new std::atomic<uint64_t>[rows]()), numRows(rows) {}
+
+    /** Returns the version of the last change to the table */
+    uint64_t table() const { return latest.load(std::memory_order_acquire); }
+
+    /**
+     * Returns the version of the last change to a row.
+     *
+     * @param rowIdx The index of the row in the CSV.
+     */
+    uint64_t row(size_t rowIdx) const {
+        return rows[rowIdx].load(std::memory_order_acquire);
+    }
+
+    /**
+     * Checks if a change to the table is in progress. Data read while the
+     * table is being changed may be a mix of old and new values.
+     */
+    bool writing() const { return writers.load() != 0; }
+
+    /** Returns the number of rows whose versions are tracked */
+    size_t size() const { return numRows; }
+
+    /**
+     * Tracks the versions of rows appended to the table (by copy into).
+     * The caller must hold the lock on the CSV and keep scans out, as the
+     * versions are moved in memory.
+     *
+     * @param rows The number of rows in the table.
+     */
+    void grow(size_t rows);
+
+    /**
+     * Tracks a change to the table in its scope. The rows changed are given
+     * a new version and the version of the table is set when the change is
+     * done. The caller must hold the lock on the CSV.
+     */
+    class Writer {
+    public:
+        /**
+         * Starts a change to the table.
+         *
+         * @param versions The versions of the table being changed.
+         * @param active If false, this object does nothing. This is
+         * convenient for code that changes the table only in some cases.
+         */
+        Writer(TableVersions& versions, bool active = true);
+
+        /** Sets the version of the table, if any rows were changed */
+        ~Writer();
+
+        /**
+         * Sets the version of a changed row.
+         *
+         * @param rowIdx The index of the row in the CSV.
+         */
+        void bump(size_t rowIdx) {
+            versions.rows[rowIdx].store(version, std::memory_order_release);
+            changed = true;
+        }
+
+    private:
+        TableVersions& versions;
+        const uint64_t version;
+        bool changed = false;
+    };
+
+private:
+    /** The version of each row */
+    std::unique_ptr<std::atomic<uint64_t>[]> rows;
+
+    /** The number of entries in rows */
+    size_t numRows;
+
+    /** The version of the last change to the table */
+    std::atomic<uint64_t> latest = {0};
+
+    /** The number of changes to the table in progress */
+    std::atomic<int> writers = {0};
+
+    /** The global counter from where versions are assigned */
+    static std::atomic<uint64_t> counter;
+};
+
+/**
+ * A transaction started by a "begin" statement. The statements in the
+ * transaction see their own (buffered) writes. The rows matched by the
+ * where clauses form the read set of the transaction and the where
+ * clauses are kept to detect rows that start matching due to changes made
+ * by other sessions.
+ */
+class Transaction {
+public:
+    /** The reads and writes of the transaction on one table */
+    class Table {
+    public:
+        Table(CSV& csv, Dictionary& dict, TableVersions& vers) :
+            csv(csv), dict(dict), versions(vers), startVersion(vers.table()) {}
+
+        /**
+         * Checks if a row matches a where clause, taking the writes of
+         * this transaction into account. Matching rows are added to the
+         * read set of the transaction.
+         *
+         * @param rowIdx The index of the row in the CSV.
+         * @param where The where clause. nullptr matches all rows.
+         */
+        bool matches(size_t rowIdx, const Predicate* where);
+
+        /**
+         * Returns the value of a column in a row, as seen by this
+         * transaction.
+         *
+         * @param rowIdx The index of the row in the CSV.
+         * @param col The zero-based index of the column.
+         */
+        const std::string& get(size_t rowIdx, int col) const;
+
+        /**
+         * Buffers a change to a column in a row. The change is applied to
+         * the CSV when the transaction commits.
+         *
+         * @param rowIdx The index of the row in the CSV.
+         * @param col The zero-based index of the column.
+         * @param value The new value for the column.
+         */
+        void set(size_t rowIdx, int col, const std::string& value) {
+            writes[rowIdx][col] = value;
+        }
+
+        /**
+         * Keeps a where clause used by a statement in this transaction, so
+         * that it can be used to validate the transaction.
+         */
+        void keep(std::unique_ptr<Predicate> where);
+
+        /** Returns the buffered writes (new values by row and column) */
+        const std::map<size_t, std::map<int, std::string>>&
+        getWrites() const { return writes; }
+
+        /** The table read and written by this transaction */
+        CSV& csv;
+
+    private:
+        friend class Transaction;
+
+        /** The dictionary for the encoded columns of the CSV */
+        Dictionary& dict;
+
+        /** The versions of the rows of the CSV */
+        TableVersions& versions;
+
+        /** The version of the table when the transaction first used it */
+        const uint64_t startVersion;
+
+        /** The version of each row read by this transaction, when read */
+        std::unordered_map<size_t, uint64_t> reads;
+
+        /** The buffered writes, i.e., new values for columns of rows */
+        std::map<size_t, std::map<int, std::string>> writes;
+
+        /** The where clauses of the statements that read this table */
+        std::vector<std::unique_ptr<Predicate>> predicates;
+    };
+
+    /**
+     * Returns the state of the transaction for a table, adding it if this
+     * is the first statement in the transaction that uses the table.
+     */
+    Table& use(CSV& csv, Dictionary& dict, TableVersions& vers);
+
+    /** Returns the tables used by this transaction */
+    const std::vector<std::unique_ptr<Table>>& tables() const { return used; }
+
+    /**
+     * Checks that no other session changed the rows read by this
+     * transaction, or changed rows so that they now match a where clause
+     * used by this transaction. The caller must hold the locks on all the
+     * tables used by this transaction.
+     *
+     * @return This method returns true if there are no conflicts.
+     */
+    bool validate() const;
+
+    /**
+     * Applies the buffered writes to the tables and bumps the versions of
+     * the rows changed. The caller must hold the locks on all the tables
+     * used by this transaction.
+     *
+     * @return The number of rows changed.
+     */
+    int apply();
+
+private:
+    /** The state of each table used by the transaction */
+    std::vector<std::unique_ptr<Table>> used;
+};
+
+#endif /* TRANSACTION_H */
@@ -0,0 +1,210 @@
+/*
+ * Copyright (C) Ethan Gutknecht 2021 (gutkneET@miamioh.edu)
+ *
+ * Implementation of trigram indexes for like conditions.
+ */
+
+#include <algorithm>
+#include <iterator>
+#include "TrigramIndex.h"
+
+// Definition for the constant used by reference.
+const size_t TrigramIndex::MaxPending;
+
+//----------------------------[  Postings  ]-------------------------------
+
+void
+TrigramIndex::Postings::append(uint32_t row) {
+    uint32_t delta = (count == 0 ? row : row - last);
+    for (; (delta >= 0x80); delta >>= 7) {
+        bytes += static_cast<char>(0x80 | (delta & 0x7F));
+    }
+    bytes += static_cast<char>(delta);
+    last = row;
+    count++;
+}
+
+void
+TrigramIndex::Postings::add(uint32_t row) {
+    if (count == 0 || row > last) {
+        append(row);
+        return;
+    } else if (row == last) {
+        return;
+    }
+    const auto pos = std::lower_bound(pending.begin(), pending.end(), row);
+    if (pos == pending.end() || *pos != row) {
+        pending.insert(pos, row);
+    }
+    if (pending.size() >= MaxPending) {
+        // Encode all the rows again, in order.
+        std::vector<uint32_t> rows;
+        decode(rows);
+        *this = Postings();
+        for (const uint32_t r : rows) {
+            append(r);
+        }
+    }
+}
+
+void
+TrigramIndex::Postings::decode(std::vector<uint32_t>& rows) const {
+    rows.clear();
+    rows.reserve(count + pending.size());
+    uint32_t row = 0, delta = 0;
+    int shift = 0;
+    for (const char ch : bytes) {
+        delta |= static_cast<uint32_t>(ch & 0x7F) << shift;
+        shift += 7;
+        if ((ch & 0x80) == 0) {
+            row  += delta;
+            rows.push_back(row);
+            delta = shift = 0;
+        }
+    }
+    if (!pending.empty()) {
+        // The pending rows may already be in the list (from a value that
+        // was overwritten). So merge them in without duplicates.
+        const size_t mid = rows.size();
+        rows.insert(rows.end(), pending.begin(), pending.end());
+        std::inplace_merge(rows.begin(), rows.begin() + mid, rows.end());
+        rows.erase(std::unique(rows.begin(), rows.end()), rows.end());
+    }
+}
+
+//---------------------------[  TrigramIndex  ]----------------------------
+
+TrigramIndex::TrigramIndex(int numCols) : columns(numCols),
+    indexed(new std::atomic<bool>[numCols]()) {
+}
+
+void
+TrigramIndex::trigramsOf(const std::string& value,
+        std::vector<uint32_t>& trigrams) {
+    trigrams.clear();
+    for (size_t i = 0; (i + 3 <= value.size()); i++) {
+        trigrams.push_back(static_cast<uint8_t>(value[i]) << 16 |
+                           static_cast<uint8_t>(value[i + 1]) << 8 |
+                           static_cast<uint8_t>(value[i + 2]));
+    }
+    std::sort(trigrams.begin(), trigrams.end());
+    trigrams.erase(std::unique(trigrams.begin(), trigrams.end()),
+                   trigrams.end());
+}
+
+size_t
+TrigramIndex::create(const CSV& csv, const Dictionary& dict, int col) {
+    std::unique_lock<std::shared_timed_mutex> lock(mutex);
+    if (!indexed[col].load(std::memory_order_relaxed)) {
+        // Rows are added in increasing order, so they are just appended.
+        std::unique_ptr<Column> column(new Column());
+        std::vector<uint32_t> trigrams;
+        for (size_t rowIdx = 0; (rowIdx < csv.size()); rowIdx++) {
+            trigramsOf(dict.get(csv[rowIdx], rowIdx, col), trigrams);
+            for (const uint32_t trigram : trigrams) {
+                (*column)[trigram].append(rowIdx);
+            }
+        }
+        columns[col] = std::move(column);
+        indexed[col].store(true, std::memory_order_release);
+    }
+    return columns[col]->size();
+}
+
+const Predicate*
+TrigramIndex::usable(const Predicate& where) const {
+    if (where.kind == Predicate::And) {
+        for (const auto& child : where.children) {
+            const Predicate* const like = usable(*child);
+            if (like != nullptr) {
+                return like;
+            }
+        }
+    }
+    const bool isLike = (where.kind == Predicate::Compare &&
+                         where.col.first == 0 && where.cond == "like" &&
+                         where.value.size() >= 3);
+    return (isLike && indexed[where.col.second].load(
+                std::memory_order_acquire) ? &where : nullptr);
+}
+
+void
+TrigramIndex::candidates(const Predicate& like,
+        std::vector<uint32_t>& rows) const {
+    std::vector<uint32_t> trigrams;
+    trigramsOf(like.value, trigrams);
+    std::shared_lock<std::shared_timed_mutex> lock(mutex);
+    const Column& column = *columns[like.col.second];
+    // Intersect the shortest lists first, so the candidates shrink fast.
+    std::vector<const Postings*> lists;
+    for (const uint32_t trigram : trigrams) {
+        const auto entry = column.find(trigram);
+        if (entry == column.end()) {
+            rows.clear();
+            return;  // No row contains this trigram.
+        }
+        lists.push_back(&entry->second);
+    }
+    std::sort(lists.begin(), lists.end(),
+              [](const Postings* p1, const Postings* p2) {
+                  return p1->count + p1->pending.size() <
+                      p2->count + p2->pending.size(); });
+    lists.front()->decode(rows);
+    std::vector<uint32_t> list, common;
+    for (size_t i = 1; (i < lists.size() && !rows.empty()); i++) {
+        lists[i]->decode(list);
+        common.clear();
+        std::set_intersection(rows.begin(), rows.end(), list.begin(),
+                              list.end(), std::back_inserter(common));
+        rows.swap(common);
+    }
+}
+
+void
+TrigramIndex::add(size_t rowIdx, int col, const std::string& value) {
+    if (!indexed[col].load(std::memory_order_acquire)) {
+        return;
+    }
+    std::vector<uint32_t> trigrams;
+    trigramsOf(value, trigrams);
+    std::unique_lock<std::shared_timed_mutex> lock(mutex);
+    for (const uint32_t trigram : trigrams) {
+        (*columns[col])[trigram].add(rowIdx);
+    }
+}
+
+void
+TrigramIndex::extend(const CSV& csv, const Dictionary& dict, size_t firstRow) {
+    std::unique_lock<std::shared_timed_mutex> lock(mutex);
+    std::vector<uint32_t> trigrams;
+    for (size_t col = 0; (col < columns.size()); col++) {
+        if (!indexed[col].load(std::memory_order_relaxed)) {
+            continue;
+        }
+        Column& column = *columns[col];
+        for (size_t rowIdx = firstRow; (rowIdx < csv.size()); rowIdx++) {
+            trigramsOf(dict.get(csv[rowIdx], rowIdx, col), trigrams);
+            for (const uint32_t trigram : trigrams) {
+                column[trigram].add(rowIdx);
+            }
+        }
+    }
+}
+
+size_t
+TrigramIndex::memoryUsed() const {
+    std::shared_lock<std::shared_timed_mutex> lock(mutex);
+    size_t bytes = 0;
+    for (const auto& column : columns) {
+        if (column == nullptr) {
+            continue;
+        }
+        bytes += column->bucket_count() * sizeof(void*);
+        for (const auto& entry : *column) {
+            bytes += sizeof(entry) + 2 * sizeof(void*) +
+                entry.second.bytes.capacity() +
+                entry.second.pending.capacity() * sizeof(uint32_t);
+        }
+    }
+    return bytes;
+}
@@ -0,0 +1,153 @@
+#ifndef TRIGRAM_INDEX_H
+#define TRIGRAM_INDEX_H
+
+/*
+ * Copyright (C) Ethan Gutknecht 2021 (gutkneET@miamioh.edu)
+ *
+ * Trigram indexes for like (substring) conditions, for example:
+ *
+ *     create trigram index on test.csv (title);
+ *     select * from test.csv where title like 'Nut Job';
+ *
+ * The index maps each sequence of 3 characters (trigram) in the values of
+ * a column to the rows that contain it. A row can contain 'Nut Job' only if
+ * it contains each of the trigrams "Nut", "ut ", "t J", " Jo", and "Job".
+ * So the scan checks only the rows in all of their lists, instead of every
+ * row in the table.
+ */
+
+#include <mutex>
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <unordered_map>
+#include <shared_mutex>
+#include "CSV.h"
+#include "Predicate.h"
+
+/** The trigram indexes on the columns of a CSV */
+class TrigramIndex {
+public:
+    /**
+     * Creates the (empty) trigram indexes for a CSV.
+     *
+     * @param numCols The number of columns in the CSV.
+     */
+    explicit TrigramIndex(int numCols);
+
+    /**
+     * Indexes a column, unless it is already indexed. The caller must hold
+     * the lock on the CSV, so that no values are changed meanwhile.
+     *
+     * @param csv The CSV whose column is to be indexed.
+     * @param dict The dictionary used to access the values of the rows.
+     * @param col The zero-based index of the column.
+     *
+     * @return The number of distinct trigrams in the column.
+     */
+    size_t create(const CSV& csv, const Dictionary& dict, int col);
+
+    /**
+     * Returns a like condition in a where clause that can use an index,
+     * i.e., a like on an indexed column with at least 3 characters that is
+     * the where clause or one of the conditions and-ed in it.
+     *
+     * @param where The where clause (for table 0) of the query.
+     *
+     * @return The like condition or nullptr if the index is of no use.
+     */
+    const Predicate* usable(const Predicate& where) const;
+
+    /**
+     * Returns the rows that may meet a like condition, in increasing
+     * order. The rows contain every trigram of the condition's value, but
+     * must still be checked, as the trigrams may not be adjacent.
+     *
+     * @param like A like condition returned by usable().
+     * @param rows The vector to which the row indexes are added.
+     */
+    void candidates(const Predicate& like, std::vector<uint32_t>& rows) const;
+
+    /**
+     * Adds the trigrams of a new value of a row to the index of its column,
+     * if the column is indexed. This method is called (via Dictionary::set)
+     * each time a value is changed. The row is not removed from the lists
+     * of the old value's trigrams, as rows are checked anyway.
+     *
+     * @param rowIdx The index of the row in the CSV.
+     * @param col The zero-based index of the column.
+     * @param value The new value for the column.
+     */
+    void add(size_t rowIdx, int col, const std::string& value);
+
+    /**
+     * Adds the rows appended to a CSV (by copy into) to the indexes of
+     * the indexed columns. The rows are appended to the postings lists, as
+     * they come after the rows already in them.
+     *
+     * @param csv The CSV to which rows were appended.
+     * @param dict The dictionary used to access the values of the rows.
+     * @param firstRow The index of the first row appended.
+     */
+    void extend(const CSV& csv, const Dictionary& dict, size_t firstRow);
+
+    /** Returns the memory (in bytes) used by the indexes */
+    size_t memoryUsed() const;
+
+private:
+    /**
+     * The rows that contain a trigram. The rows are stored in increasing
+     * order as variable-length deltas (7 bits per byte) from the previous
+     * row, so most rows take 1 or 2 bytes.
+     */
+    struct Postings {
+        /** The encoded rows */
+        std::string bytes;
+
+        /** The last row in bytes */
+        uint32_t last = 0;
+
+        /** The number of rows in bytes */
+        uint32_t count = 0;
+
+        /** Rows added (by updates) out of order, merged in at MaxPending */
+        std::vector<uint32_t> pending;
+
+        /** Appends a row that is larger than the last one */
+        void append(uint32_t row);
+
+        /** Adds a row (in any order) */
+        void add(uint32_t row);
+
+        /** Decodes the rows (including pending ones) in increasing order */
+        void decode(std::vector<uint32_t>& rows) const;
+    };
+
+    /** The number of pending rows at which they are merged */
+    static const size_t MaxPending = 64;
+
+    /** The index of a column */
+    using Column = std::unordered_map<uint32_t, Postings>;
+
+    /**
+     * Returns the distinct trigrams in a value.
+     *
+     * @param value The value whose trigrams are to be returned.
+     * @param trigrams The vector to which the trigrams are assigned.
+     */
+    static void trigramsOf(const std::string& value,
+        std::vector<uint32_t>& trigrams);
+
+    /** The index of each column (nullptr if the column is not indexed) */
+    std::vector<std::unique_ptr<Column>> columns;
+
+    /** Flags set (with release semantics) once a column is indexed */
+    std::unique_ptr<std::atomic<bool>[]> indexed;
+
+    /** Guards the postings, which are read by many queries at once */
+    mutable std::shared_timed_mutex mutex;
+};
+
+#endif /* TRIGRAM_INDEX_H */
@@ -0,0 +1,98 @@
+/*
+ * Copyright (C) Ethan Gutknecht 2021 (gutkneET@miamioh.edu)
+ *
+ * Implementation of the list of wait queries waiting for a table.
+ */
+
+#include <utility>
+#include "WaitList.h"
+#include "Helper.h"
+
+// The options of wait queries for each thread.
+thread_local const WaitList::Options* WaitList::Options::currentOptions =
+    nullptr;
+
+WaitList::Options::Options(Clock::time_point deadline, bool canPark) :
+    deadline(deadline), canPark(canPark), prev(currentOptions) {
+    currentOptions = this;
+}
+
+WaitList::Options::~Options() {
+    currentOptions = prev;
+}
+
+uint64_t
+WaitList::generation() const {
+    std::lock_guard<std::mutex> guard(mutex);
+    return changes;
+}
+
+void
+WaitList::wait(uint64_t generation) {
+    const Options* const options = Options::current();
+    const Clock::time_point deadline = (options != nullptr ?
+        options->deadline : Clock::time_point::max());
+    std::unique_lock<std::mutex> lock(mutex);
+    if (changes != generation) {
+        return;
+    } else if (Clock::now() >= deadline) {
+        throw Exp("The wait timed out.");
+    } else if (options != nullptr && options->canPark) {
+        throw Parked{this, generation, deadline};
+    }
+    const auto isChanged = [&] { return changes != generation; };
+    if (deadline == Clock::time_point::max()) {
+        changed.wait(lock, isChanged);
+    } else if (!changed.wait_until(lock, deadline, isChanged)) {
+        throw Exp("The wait timed out.");
+    }
+}
+
+void
+WaitList::park(uint64_t generation, Clock::time_point deadline,
+        Resume resume) {
+    {
+        std::lock_guard<std::mutex> guard(mutex);
+        if (changes == generation && Clock::now() < deadline) {
+            waiters.push_back({deadline, std::move(resume)});
+            return;
+        }
+    }
+    resume();  // The table changed (or the wait timed out) meanwhile.
+}
+
+void
+WaitList::wake() {
+    std::vector<Waiter> resumed;
+    {
+        std::lock_guard<std::mutex> guard(mutex);
+        changes++;
+        resumed.swap(waiters);
+    }
+    changed.notify_all();
+    for (auto& waiter : resumed) {
+        waiter.resume();
+    }
+}
+
+void
+WaitList::expire(Clock::time_point now) {
+    std::vector<Waiter> expired, kept;
+    {
+        std::lock_guard<std::mutex> guard(mutex);
+        for (auto& waiter : waiters) {
+            (waiter.deadline <= now ? expired : kept).push_back(
+                std::move(waiter));
+        }
+        waiters.swap(kept);
+    }
+    for (auto& waiter : expired) {
+        waiter.resume();
+    }
+}
+
+size_t
+WaitList::size() const {
+    std::lock_guard<std::mutex> guard(mutex);
+    return waiters.size();
+}
@@ -0,0 +1,154 @@
+#ifndef WAIT_LIST_H
+#define WAIT_LIST_H
+
+/*
+ * Copyright (C) Ethan Gutknecht 2021 (gutkneET@miamioh.edu)
+ *
+ * The wait queries (such as "wait select ...") that are waiting for a
+ * table to change. A wait query that finds no rows is tried again each
+ * time the table changes. Web-clients' wait queries are parked in the
+ * list as callbacks, without a thread, and are resumed on the worker pool
+ * (see AdmissionQueue.h) when the table changes. Other clients (the
+ * console and the binary protocol) have a thread of their own, which just
+ * blocks until the table changes.
+ *
+ * A wait query may end with a timeout (in seconds), for example:
+ *
+ *     wait select * from test.csv where rating > 4.5 timeout 30
+ */
+
+#include <mutex>
+#include <chrono>
+#include <vector>
+#include <cstdint>
+#include <functional>
+#include <condition_variable>
+
+/** The wait queries waiting for a table to change */
+class WaitList {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    /** The callback that resumes a parked wait query */
+    using Resume = std::function<void()>;
+
+    /**
+     * Thrown by wait() to unwind a wait query that must be parked. The
+     * caller that allowed parking (via Options) catches it and calls
+     * park() with a callback that runs the query again.
+     */
+    struct Parked {
+        /** The list in which the query is to be parked */
+        WaitList* list;
+
+        /** The generation of the table that the query saw */
+        uint64_t generation;
+
+        /** The time at which the query times out */
+        Clock::time_point deadline;
+    };
+
+    /**
+     * The options for wait queries run by the calling thread within a
+     * scope. Without options, wait queries block without a timeout.
+     */
+    class Options {
+    public:
+        /**
+         * Sets the options of the calling thread.
+         *
+         * @param deadline The time at which wait queries time out.
+         * @param canPark If true, wait queries are parked (by throwing
+         * Parked) instead of blocking the thread.
+         */
+        Options(Clock::time_point deadline, bool canPark);
+        ~Options();
+
+        /** The time at which wait queries time out */
+        const Clock::time_point deadline;
+
+        /** True if wait queries are parked instead of blocking */
+        const bool canPark;
+
+        /** Returns the options of the calling thread, if any */
+        static const Options* current() { return currentOptions; }
+
+    private:
+        /** The options in the enclosing scope, if any */
+        const Options* const prev;
+
+        /** The options set for each thread */
+        static thread_local const Options* currentOptions;
+    };
+
+    /**
+     * Returns the generation of the table, i.e., the number of times it
+     * changed. A wait query reads it before checking the table, so that
+     * wait() does not miss a change made after the check.
+     */
+    uint64_t generation() const;
+
+    /**
+     * Waits (or parks the query) until the table changes after a given
+     * generation. This method returns right away if it already changed.
+     *
+     * @param generation The generation that the wait query saw.
+     *
+     * @exception Parked If the options of the calling thread allow the
+     * query to be parked.
+     * @exception Exp If the wait times out.
+     */
+    void wait(uint64_t generation);
+
+    /**
+     * Parks a wait query until the table changes after a given generation
+     * or the query's deadline passes. If the table already changed, the
+     * query is resumed right away.
+     *
+     * @param generation The generation that the wait query saw.
+     * @param deadline The time at which the query times out.
+     * @param resume The callback that runs the query again.
+     */
+    void park(uint64_t generation, Clock::time_point deadline, Resume resume);
+
+    /**
+     * Tells the wait queries that the table changed. This method is called
+     * after the changes (made with the table's lock) are done.
+     */
+    void wake();
+
+    /**
+     * Resumes the parked queries whose deadlines have passed (to report
+     * that they timed out).
+     *
+     * @param now The current time.
+     */
+    void expire(Clock::time_point now);
+
+    /** Returns the number of parked queries */
+    size_t size() const;
+
+private:
+    /** A parked wait query */
+    struct Waiter {
+        /** The time at which the query times out */
+        Clock::time_point deadline;
+
+        /** The callback that runs the query again */
+        Resume resume;
+    };
+
+    /** The number of times the table changed */
+    uint64_t changes = 0;
+
+    /** The parked queries */
+    std::vector<Waiter> waiters;
+
+    /** Guards changes and waiters */
+    mutable std::mutex mutex;
+
+    /** Notified when the table changes, for the blocked queries */
+    std::condition_variable changed;
+};
+
+#endif /* WAIT_LIST_H */
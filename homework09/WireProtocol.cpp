@@ -0,0 +1,312 @@
+/*
+ * Copyright (C) Ethan Gutknecht 2021 (gutkneET@miamioh.edu)
+ *
+ * Implementation of the binary protocol used by machine clients.
+ */
+
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include "WireProtocol.h"
+#include "Helper.h"
+
+// Definitions for the constants used by reference.
+const size_t Wire::HeaderSize;
+const uint32_t Wire::MaxFrameSize;
+const size_t Wire::BatchRows;
+const size_t FrameStream::FlushSize;
+const size_t FrameStream::ReadSize;
+
+thread_local BatchSink* BatchSink::currentSink = nullptr;
+
+// Convert a value to an integer only if the integer prints as the same
+// string, so that no information (such as leading zeros) is lost.
+static bool toInt(const std::string& str, int64_t& val) {
+    if (str.empty() || str.size() > 20) {
+        return false;
+    }
+    char* end;
+    errno = 0;
+    val = std::strtoll(str.c_str(), &end, 10);
+    char buf[24];
+    return (*end == '\0' && errno == 0 &&
+            std::snprintf(buf, sizeof(buf), "%lld",
+                          static_cast<long long>(val)) ==
+            static_cast<int>(str.size()) && str == buf);
+}
+
+// Convert a value to a double only if it prints as the same string. Values
+// are printed like the results of expressions in update statements.
+static bool toReal(const std::string& str, double& val) {
+    if (str.empty() || str.size() > 24) {
+        return false;
+    }
+    char* end;
+    val = std::strtod(str.c_str(), &end);
+    char buf[32];
+    std::snprintf(buf, sizeof(buf), "%.15g", val);
+    return (*end == '\0' && str == buf);
+}
+
+//----------------------[  WireWriter & WireReader  ]----------------------
+
+void
+WireWriter::put(uint64_t val, int bytes) {
+    for (int i = 0; (i < bytes); i++) {
+        out += static_cast<char>(val >> (8 * i));
+    }
+}
+
+void
+WireWriter::str(const std::string& val) {
+    u32(val.size());
+    out += val;
+}
+
+uint64_t
+WireReader::get(int bytes) {
+    if (in.size() - pos < static_cast<size_t>(bytes)) {
+        throw Exp("Truncated message.");
+    }
+    uint64_t val = 0;
+    for (int i = 0; (i < bytes); i++) {
+        val |= uint64_t(static_cast<uint8_t>(in[pos++])) << (8 * i);
+    }
+    return val;
+}
+
+std::string
+WireReader::str() {
+    const uint32_t len = u32();
+    if (in.size() - pos < len) {
+        throw Exp("Truncated message.");
+    }
+    pos += len;
+    return in.substr(pos - len, len);
+}
+
+//-----------------------------[  ColumnBatch  ]---------------------------
+
+std::string
+ColumnBatch::Column::text(size_t row) const {
+    if (type == Wire::Int) {
+        return std::to_string(ints.at(row));
+    } else if (type == Wire::Real) {
+        char buf[32];
+        std::snprintf(buf, sizeof(buf), "%.15g", reals.at(row));
+        return buf;
+    }
+    return texts.at(row);
+}
+
+void
+ColumnBatch::encode(std::string& out) const {
+    WireWriter writer(out);
+    writer.u16(columns.size());
+    for (const auto& column : columns) {
+        writer.str(column.name);
+    }
+    writer.u32(rows);
+    for (const auto& column : columns) {
+        // Try each type, from the most compact one, until all the values
+        // of the column can be sent with it.
+        const size_t start = out.size();
+        size_t row = 0;
+        writer.u8(Wire::Int);
+        for (int64_t val; (row < rows && toInt(column.texts[row], val));
+             row++) {
+            writer.u64(val);
+        }
+        if (row < rows) {
+            out.resize(start);
+            writer.u8(Wire::Real);
+            for (row = 0; (row < rows); row++) {
+                double val;
+                if (!toReal(column.texts[row], val)) {
+                    break;
+                }
+                uint64_t bits;
+                std::memcpy(&bits, &val, sizeof(bits));
+                writer.u64(bits);
+            }
+        }
+        if (row < rows) {
+            out.resize(start);
+            writer.u8(Wire::Text);
+            for (row = 0; (row < rows); row++) {
+                writer.str(column.texts[row]);
+            }
+        }
+    }
+}
+
+void
+ColumnBatch::decode(WireReader& in) {
+    columns.resize(in.u16());
+    for (auto& column : columns) {
+        column.name = in.str();
+    }
+    rows = in.u32();
+    for (auto& column : columns) {
+        column.ints.clear();
+        column.reals.clear();
+        column.texts.clear();
+        column.type = static_cast<Wire::ColType>(in.u8());
+        for (size_t row = 0; (row < rows); row++) {
+            if (column.type == Wire::Int) {
+                column.ints.push_back(in.u64());
+            } else if (column.type == Wire::Real) {
+                const uint64_t bits = in.u64();
+                double val;
+                std::memcpy(&val, &bits, sizeof(val));
+                column.reals.push_back(val);
+            } else if (column.type == Wire::Text) {
+                column.texts.push_back(in.str());
+            } else {
+                throw Exp("Invalid column type in batch.");
+            }
+        }
+    }
+}
+
+//-----------------------------[  FrameStream  ]---------------------------
+
+// Read a little-endian 32-bit value from a buffer.
+static uint32_t getU32(const std::string& buf, size_t pos) {
+    uint32_t val = 0;
+    for (int i = 0; (i < 4); i++) {
+        val |= uint32_t(static_cast<uint8_t>(buf[pos + i])) << (8 * i);
+    }
+    return val;
+}
+
+bool
+FrameStream::fill(size_t bytes) {
+    while (in.size() - inPos < bytes) {
+        // Discard the frames already read before receiving more data.
+        in.erase(0, inPos);
+        inPos = 0;
+        const size_t used = in.size();
+        in.resize(used + std::max(bytes - used, ReadSize));
+        boost::system::error_code ec;
+        const size_t got = sock.read_some(
+            boost::asio::buffer(&in[used], in.size() - used), ec);
+        in.resize(used + got);
+        if (ec == boost::asio::error::eof) {
+            return false;
+        } else if (ec) {
+            throw Exp(ec.message());
+        }
+    }
+    return true;
+}
+
+bool
+FrameStream::read(Wire::Frame& frame) {
+    if (!fill(4)) {
+        if (in.size() > inPos) {
+            throw Exp("Connection closed in the middle of a message.");
+        }
+        return false;
+    }
+    const uint32_t length = getU32(in, inPos);
+    if (length < Wire::HeaderSize - 4 || length > Wire::MaxFrameSize) {
+        throw Exp("Invalid message length " + std::to_string(length));
+    }
+    if (!fill(4 + length)) {
+        throw Exp("Connection closed in the middle of a message.");
+    }
+    frame.type = in[inPos + 4];
+    frame.id   = getU32(in, inPos + 5);
+    frame.payload.assign(in, inPos + Wire::HeaderSize,
+                         length + 4 - Wire::HeaderSize);
+    inPos += 4 + length;
+    return true;
+}
+
+bool
+FrameStream::hasFrame() const {
+    const size_t avail = in.size() - inPos;
+    return (avail >= 4 && avail - 4 >= getU32(in, inPos));
+}
+
+void
+FrameStream::write(uint8_t type, uint32_t id, const std::string& payload) {
+    WireWriter writer(out);
+    writer.u32(Wire::HeaderSize - 4 + payload.size());
+    writer.u8(type);
+    writer.u32(id);
+    out += payload;
+    if (out.size() >= FlushSize) {
+        flush();  // Send large results as they are produced.
+    }
+}
+
+size_t
+FrameStream::flush() {
+    if (out.empty()) {
+        return 0;
+    }
+    boost::asio::write(sock, boost::asio::buffer(out));
+    const size_t bytes = out.size();
+    sent += bytes;
+    out.clear();
+    // Do not hold on to the memory used by an unusually large result.
+    if (out.capacity() > (1 << 20)) {
+        std::string().swap(out);
+    }
+    return bytes;
+}
+
+//------------------------------[  BatchSink  ]----------------------------
+
+BatchSink::BatchSink(FrameStream& stream, uint32_t id) : stream(stream),
+    id(id), prev(currentSink) {
+    currentSink = this;
+}
+
+BatchSink::~BatchSink() {
+    currentSink = prev;
+}
+
+void
+BatchSink::start(const StrVec& colNames) {
+    finish();  // Send the rows of an earlier result, if any.
+    batch.columns.resize(colNames.size());
+    for (size_t i = 0; (i < colNames.size()); i++) {
+        batch.columns[i].name = colNames[i];
+    }
+    col = 0;
+}
+
+void
+BatchSink::add(const std::string& value) {
+    // Reuse the strings from earlier batches to avoid allocations.
+    StrVec& texts = batch.columns[col++].texts;
+    if (texts.size() > batch.rows) {
+        texts[batch.rows] = value;
+    } else {
+        texts.push_back(value);
+    }
+}
+
+void
+BatchSink::endRow() {
+    col = 0;
+    if (++batch.rows == Wire::BatchRows) {
+        finish();
+    }
+}
+
+void
+BatchSink::finish() {
+    if (batch.rows == 0) {
+        return;
+    }
+    payload.clear();
+    batch.encode(payload);
+    stream.write(Wire::Batch, id, payload);
+    batch.rows = 0;
+}
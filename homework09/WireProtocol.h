@@ -0,0 +1,283 @@
+#ifndef WIRE_PROTOCOL_H
+#define WIRE_PROTOCOL_H
+
+/*
+ * Copyright (C) Ethan Gutknecht 2021 (gutkneET@miamioh.edu)
+ *
+ * A compact binary protocol for machine clients of SQLAir. It avoids the
+ * overheads of the HTTP interface (URL-encoding, text headers, one
+ * connection per query, and tab-separated results). The protocol is used
+ * on its own port (set via SQLAIR_BINARY_PORT). All messages are frames of the
+ * form:
+ *
+ *     uint32 length   The number of bytes in the rest of the frame
+ *     uint8  type     One of the Wire::MsgType values
+ *     uint32 id       The request id, chosen by the client. Replies to a
+ *                     request have the same id.
+ *     ...             The payload
+ *
+ * Integers are little-endian and strings are a uint32 length followed by
+ * the bytes. The payloads of the messages are:
+ *
+ *     Prepare   string sql (with ? for parameters)
+ *     Execute   uint32 statement id, uint16 count, count x string values
+ *     Query     string sql
+ *     Close     uint32 statement id
+ *     Snapshot  string table
+ *     Subscribe uint64 position (see below)
+ *     Prepared  uint32 statement id, uint16 number of parameters
+ *     Batch     A batch of rows in columnar form (see ColumnBatch)
+ *     Done      string message, e.g., "3 row(s) selected."
+ *     Error     string message
+ *     Change    A record from the change log (see ChangeRecord)
+ *     Heartbeat uint64 position, uint64 time
+ *     Columns   uint64 position, uint16 count, count x string names
+ *
+ * A request gets zero or more Batch replies followed by one Done, Error,
+ * Prepared, or Columns reply. Clients may send many requests without
+ * waiting for replies. Requests on a connection are processed in order.
+ *
+ * Snapshot and Subscribe are used by read replicas (see Replication.h).
+ * A Snapshot gets all the rows of a table (as batches) and then Columns
+ * with the position in the change log that the rows are consistent with.
+ * A Subscribe gets the Change records after the given position (or after
+ * the latest one, if the position is 2^64 - 1) and a Heartbeat whenever
+ * there are no changes for a while. The connection is then used only for
+ * these replies.
+ */
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <boost/asio.hpp>
+#include "CSV.h"
+
+/** The constants and the frame used in the binary protocol */
+class Wire {
+public:
+    /** The types of messages */
+    enum MsgType { Prepare = 1, Execute, Query, Close, Snapshot, Subscribe,
+                   Prepared = 0x81, Batch, Done, Error, Change, Heartbeat,
+                   Columns };
+
+    /** The types of columns in a batch */
+    enum ColType { Int = 1, Real, Text };
+
+    /** The size of the fixed part of a frame (length, type, and id) */
+    static const size_t HeaderSize = 9;
+
+    /** Frames larger than this are rejected as invalid */
+    static const uint32_t MaxFrameSize = 64 << 20;
+
+    /** The maximum number of rows sent in a single batch */
+    static const size_t BatchRows = 1024;
+
+    /** A message received from the other end */
+    struct Frame {
+        uint8_t type = 0;
+        uint32_t id = 0;
+        std::string payload;
+    };
+};
+
+/** Appends values (in the format used by the protocol) to a string */
+class WireWriter {
+public:
+    explicit WireWriter(std::string& out) : out(out) {}
+
+    void u8(uint8_t val)   { out += static_cast<char>(val); }
+    void u16(uint16_t val) { put(val, 2); }
+    void u32(uint32_t val) { put(val, 4); }
+    void u64(uint64_t val) { put(val, 8); }
+    void str(const std::string& val);
+
+private:
+    /** Appends the given number of bytes of a value, lowest byte first */
+    void put(uint64_t val, int bytes);
+
+    /** The string to which values are appended */
+    std::string& out;
+};
+
+/** Reads values (in the format used by the protocol) from a payload */
+class WireReader {
+public:
+    explicit WireReader(const std::string& in) : in(in) {}
+
+    uint8_t  u8()  { return get(1); }
+    uint16_t u16() { return get(2); }
+    uint32_t u32() { return get(4); }
+    uint64_t u64() { return get(8); }
+    std::string str();
+
+private:
+    /**
+     * Reads the given number of bytes of a value, lowest byte first.
+     *
+     * @exception Exp Thrown if the payload is too short.
+     */
+    uint64_t get(int bytes);
+
+    /** The payload being read */
+    const std::string& in;
+
+    /** The index of the next byte to be read */
+    size_t pos = 0;
+};
+
+/**
+ * A batch of rows in columnar form. The values of a column are sent
+ * together, using the most compact type that preserves every value exactly
+ * (so "7" is an Int but "007" is Text). The payload of a batch is:
+ *
+ *     uint16 columns, columns x string name, uint32 rows, and for each
+ *     column a uint8 ColType followed by the values: int64 for Int,
+ *     float64 for Real, and string for Text.
+ */
+class ColumnBatch {
+public:
+    /** The name and values of a column */
+    struct Column {
+        std::string name;
+        Wire::ColType type = Wire::Text;
+        std::vector<int64_t> ints;
+        std::vector<double> reals;
+        StrVec texts;
+
+        /** Returns a value as a string (as it is in the table) */
+        std::string text(size_t row) const;
+    };
+
+    /** The columns in this batch */
+    std::vector<Column> columns;
+
+    /** The number of rows in this batch */
+    size_t rows = 0;
+
+    /**
+     * Appends this batch to a payload. The values are taken from the first
+     * rows entries in the texts of each column (the strings after them are
+     * kept only to reuse their memory). The type of each column is chosen
+     * here.
+     */
+    void encode(std::string& out) const;
+
+    /** Reads a batch from a payload, replacing the data in this batch */
+    void decode(WireReader& in);
+};
+
+/**
+ * A connection that reads and writes frames. Frames to be written are
+ * buffered, so that replies to pipelined requests can be sent with a single
+ * system call.
+ */
+class FrameStream {
+public:
+    explicit FrameStream(boost::asio::ip::tcp::socket& sock) : sock(sock) {}
+
+    /**
+     * Reads the next frame.
+     *
+     * @return false if the connection was closed before the frame.
+     * @exception Exp Thrown if the frame is invalid or incomplete.
+     */
+    bool read(Wire::Frame& frame);
+
+    /** Returns true if another complete frame has already been received */
+    bool hasFrame() const;
+
+    /**
+     * Adds a frame to be sent. Frames are sent when flush is called, or
+     * when enough of them have been buffered.
+     */
+    void write(uint8_t type, uint32_t id, const std::string& payload);
+
+    /** Sends the buffered frames and returns the number of bytes sent */
+    size_t flush();
+
+    /** Returns the number of bytes sent via this stream */
+    size_t bytesSent() const { return sent; }
+
+private:
+    /** Buffered frames are sent once they reach this size */
+    static const size_t FlushSize = 64 * 1024;
+
+    /** The minimum number of bytes requested from the socket per read */
+    static const size_t ReadSize = 16 * 1024;
+
+    /**
+     * Receives data until the given number of bytes are buffered.
+     *
+     * @return false if the connection was closed before that.
+     */
+    bool fill(size_t bytes);
+
+    /** The socket used to read and write frames */
+    boost::asio::ip::tcp::socket& sock;
+
+    /** The data received but not yet read, starting at inPos */
+    std::string in;
+    size_t inPos = 0;
+
+    /** The frames to be sent */
+    std::string out;
+
+    /** The total number of bytes sent */
+    size_t sent = 0;
+};
+
+/**
+ * Sends the rows selected by a query as batches, instead of printing them
+ * as text. Creating an object makes it the current sink of the calling
+ * thread. The select methods check current() to send rows to the sink.
+ */
+class BatchSink {
+public:
+    /**
+     * Creates a sink for the replies to a request.
+     *
+     * @param stream The stream to which batches are written.
+     * @param id The id of the request.
+     */
+    BatchSink(FrameStream& stream, uint32_t id);
+    ~BatchSink();
+
+    /** Returns the sink of the calling thread or nullptr if none */
+    static BatchSink* current() { return currentSink; }
+
+    /** Starts the rows of a result that has the given columns */
+    void start(const StrVec& colNames);
+
+    /** Adds the next value of the current row */
+    void add(const std::string& value);
+
+    /** Ends the current row, sending a batch if it is full */
+    void endRow();
+
+    /** Sends the remaining rows, if any */
+    void finish();
+
+private:
+    /** The stream to which batches are written */
+    FrameStream& stream;
+
+    /** The id of the request */
+    const uint32_t id;
+
+    /** The rows that have not been sent yet */
+    ColumnBatch batch;
+
+    /** The column to which the next value is added */
+    size_t col = 0;
+
+    /** A buffer reused for the payload of each batch */
+    std::string payload;
+
+    /** The sink that was current when this object was created */
+    BatchSink* const prev;
+
+    /** The sink of each thread */
+    static thread_local BatchSink* currentSink;
+};
+
+#endif /* WIRE_PROTOCOL_H */
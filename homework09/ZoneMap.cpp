@@ -0,0 +1,191 @@
+/*
+ * Copyright (C) Ethan Gutknecht 2021 (gutkneET@miamioh.edu)
+ *
+ * Implementation of the zone maps used to skip blocks of rows in scans.
+ */
+
+#include <cmath>
+#include <limits>
+#include <cstdlib>
+#include "ZoneMap.h"
+
+// Definition for the constant used by reference.
+const size_t ZoneMap::BlockRows;
+
+ZoneMap::Zone::Zone() : min(std::numeric_limits<double>::infinity()),
+    max(-std::numeric_limits<double>::infinity()) {
+}
+
+void
+ZoneMap::Zone::add(const std::string& value) {
+    if (value.empty()) {
+        empty++;
+        return;
+    }
+    // Numbers are recognized the same way as in Predicate::compareTo.
+    char *end = nullptr;
+    const double num = std::strtod(value.c_str(), &end);
+    if (*end != '\0' || std::isnan(num)) {
+        other++;
+        return;
+    }
+    for (double cur = min.load(); (num < cur &&
+                                   !min.compare_exchange_weak(cur, num));) {
+    }
+    for (double cur = max.load(); (num > cur &&
+                                   !max.compare_exchange_weak(cur, num));) {
+    }
+}
+
+ZoneMap::ZoneMap(int numCols) : columns(numCols) {
+}
+
+bool
+ZoneMap::usesZones(const Predicate& node) {
+    return node.kind == Predicate::Compare && node.col.first == 0 &&
+        node.isNum && !std::isnan(node.num) && node.cond != "like" &&
+        node.cond != "<>";
+}
+
+bool
+ZoneMap::missing(const Predicate& where) const {
+    for (const auto& child : where.children) {
+        if (missing(*child)) {
+            return true;
+        }
+    }
+    return usesZones(where) &&
+        !columns[where.col.second].built.load(std::memory_order_acquire);
+}
+
+void
+ZoneMap::build(const CSV& csv, const Dictionary& dict,
+        const Predicate& where) {
+    for (const auto& child : where.children) {
+        build(csv, dict, *child);
+    }
+    if (!usesZones(where)) {
+        return;
+    }
+    std::lock_guard<std::mutex> guard(mutex);
+    Column& column = columns[where.col.second];
+    if (column.built.load(std::memory_order_relaxed)) {
+        return;
+    }
+    column.blocks = (csv.size() + BlockRows - 1) / BlockRows;
+    column.zones.reset(new Zone[column.blocks]);
+    for (size_t rowIdx = 0; (rowIdx < csv.size()); rowIdx++) {
+        column.zones[rowIdx / BlockRows].add(
+            dict.get(csv[rowIdx], rowIdx, where.col.second));
+    }
+    column.built.store(true, std::memory_order_release);
+}
+
+bool
+ZoneMap::mayMatch(size_t block, const Predicate& where) const {
+    switch (where.kind) {
+    case Predicate::And:
+        for (const auto& child : where.children) {
+            if (!mayMatch(block, *child)) {
+                return false;
+            }
+        }
+        return true;
+    case Predicate::Or:
+        for (const auto& child : where.children) {
+            if (mayMatch(block, *child)) {
+                return true;
+            }
+        }
+        return false;
+    case Predicate::Not:
+        return true;  // Zones cannot show that every row matches.
+    default:
+        break;
+    }
+    if (!usesZones(where)) {
+        return true;
+    }
+    const Column& column = columns[where.col.second];
+    if (!column.built.load(std::memory_order_acquire) ||
+        block >= column.blocks) {
+        return true;  // Rows added after the zones were built.
+    }
+    return mayMatch(column.zones[block], where);
+}
+
+bool
+ZoneMap::mayMatch(const Zone& zone, const Predicate& cmp) {
+    if (zone.other > 0) {
+        return true;  // Non-numeric values are compared as strings.
+    }
+    // Empty values are less than any number (as strings), so they only
+    // meet the < and <= conditions. Equality is checked on the strings,
+    // which implies that the numbers are equal.
+    const double min = zone.min, max = zone.max, num = cmp.num;
+    const bool empty = (zone.empty > 0);
+    if (cmp.cond == "=") {
+        return min <= num && num <= max;
+    } else if (cmp.cond == "<") {
+        return empty || min < num;
+    } else if (cmp.cond == "<=") {
+        return empty || min <= num;
+    } else if (cmp.cond == ">") {
+        return max > num;
+    } else if (cmp.cond == ">=") {
+        return max >= num;
+    }
+    return true;
+}
+
+void
+ZoneMap::widen(size_t rowIdx, int col, const std::string& value) {
+    Column& column = columns[col];
+    // Values are changed while holding the lock on the CSV. So the zones of
+    // a column are not being built now and are included in the build
+    // otherwise.
+    if (column.built.load(std::memory_order_acquire) &&
+        rowIdx / BlockRows < column.blocks) {
+        column.zones[rowIdx / BlockRows].add(value);
+    }
+}
+
+void
+ZoneMap::extend(const CSV& csv, const Dictionary& dict, size_t firstRow) {
+    std::lock_guard<std::mutex> guard(mutex);
+    const size_t blocks = (csv.size() + BlockRows - 1) / BlockRows;
+    for (size_t col = 0; (col < columns.size()); col++) {
+        Column& column = columns[col];
+        if (!column.built.load(std::memory_order_relaxed)) {
+            continue;
+        }
+        if (blocks > column.blocks) {
+            // Copy the zones to a larger array, with empty zones at the end.
+            std::unique_ptr<Zone[]> zones(new Zone[blocks]);
+            for (size_t block = 0; (block < column.blocks); block++) {
+                const Zone& zone = column.zones[block];
+                zones[block].min   = zone.min.load();
+                zones[block].max   = zone.max.load();
+                zones[block].empty = zone.empty.load();
+                zones[block].other = zone.other.load();
+            }
+            column.zones  = std::move(zones);
+            column.blocks = blocks;
+        }
+        for (size_t rowIdx = firstRow; (rowIdx < csv.size()); rowIdx++) {
+            column.zones[rowIdx / BlockRows].add(dict.get(csv[rowIdx], rowIdx,
+                                                          col));
+        }
+    }
+}
+
+size_t
+ZoneMap::memoryUsed() const {
+    size_t bytes = columns.size() * sizeof(Column);
+    for (const auto& column : columns) {
+        if (column.built.load(std::memory_order_acquire)) {
+            bytes += column.blocks * sizeof(Zone);
+        }
+    }
+    return bytes;
+}
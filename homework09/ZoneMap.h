@@ -0,0 +1,148 @@
+#ifndef ZONE_MAP_H
+#define ZONE_MAP_H
+
+/*
+ * Copyright (C) Ethan Gutknecht 2021 (gutkneET@miamioh.edu)
+ *
+ * Zone maps that let scans skip blocks of rows. For each block of rows, a
+ * zone records the smallest and largest numbers in a column along with
+ * the number of empty and non-numeric values. If the zone shows that no
+ * row in a block can match the where clause of a query (for example,
+ * "altitude > 9000" on a block whose largest altitude is 3000), the scan
+ * skips the block.
+ *
+ * Zones are built for a column when a where clause first compares it with
+ * a number. Updates only widen the zones (values that are overwritten are
+ * not removed from them), so the zones stay conservative.
+ */
+
+#include <mutex>
+#include <atomic>
+#include <memory>
+#include <vector>
+#include <string>
+#include <cstdint>
+#include "CSV.h"
+#include "Predicate.h"
+
+/** The zone maps for the columns of a CSV */
+class ZoneMap {
+public:
+    /** The number of rows in each block */
+    static const size_t BlockRows = 65536;
+
+    /**
+     * Creates zone maps for a CSV, without any zones yet.
+     *
+     * @param numCols The number of columns in the CSV.
+     */
+    explicit ZoneMap(int numCols);
+
+    /**
+     * Checks if zones need to be built for the numeric comparisons in a
+     * where clause.
+     *
+     * @param where The where clause to be used to skip blocks.
+     */
+    bool missing(const Predicate& where) const;
+
+    /**
+     * Builds the zones for the columns compared with numbers in a where
+     * clause, unless they were already built. The caller must hold the
+     * lock on the CSV, so that no values are changed meanwhile.
+     *
+     * @param csv The CSV whose rows are summarized.
+     * @param dict The dictionary used to access the values of the rows.
+     * @param where The where clause to be used to skip blocks.
+     */
+    void build(const CSV& csv, const Dictionary& dict, const Predicate& where);
+
+    /**
+     * Checks if any row in a block may match a where clause. This method
+     * returns true if there is no zone for the block.
+     *
+     * @param block The index of the block (the row index / BlockRows).
+     * @param where The where clause (for table 0) of the query.
+     */
+    bool mayMatch(size_t block, const Predicate& where) const;
+
+    /**
+     * Widens the zone of a row's block to include a new value. This method
+     * is called (via Dictionary::set) each time a value is changed.
+     *
+     * @param rowIdx The index of the row in the CSV.
+     * @param col The zero-based index of the column.
+     * @param value The new value for the column.
+     */
+    void widen(size_t rowIdx, int col, const std::string& value);
+
+    /**
+     * Adds the rows appended to a CSV (by copy into) to the zones that are
+     * built. The caller must hold the lock on the CSV and keep scans out,
+     * as the zones may be moved in memory.
+     *
+     * @param csv The CSV to which rows were appended.
+     * @param dict The dictionary used to access the values of the rows.
+     * @param firstRow The index of the first row appended.
+     */
+    void extend(const CSV& csv, const Dictionary& dict, size_t firstRow);
+
+    /** Returns the memory (in bytes) used by the zones */
+    size_t memoryUsed() const;
+
+private:
+    /** The summary of the values of a column in a block of rows */
+    struct Zone {
+        /** The smallest number (or +infinity if there are none) */
+        std::atomic<double> min;
+
+        /** The largest number (or -infinity if there are none) */
+        std::atomic<double> max;
+
+        /** The number of empty values */
+        std::atomic<uint32_t> empty = {0};
+
+        /** The number of values that are neither numbers nor empty */
+        std::atomic<uint32_t> other = {0};
+
+        Zone();
+
+        /** Adds a value to the summary */
+        void add(const std::string& value);
+    };
+
+    /** The zones of a column */
+    struct Column {
+        /** The zones, one per block, once built */
+        std::unique_ptr<Zone[]> zones;
+
+        /** The number of blocks when the zones were built */
+        size_t blocks = 0;
+
+        /** Flag set (with release semantics) once the zones are built */
+        std::atomic<bool> built = {false};
+    };
+
+    /**
+     * Checks if any row in a block may meet a comparison, using the zone
+     * for the block.
+     *
+     * @param zone The zone of the block for the compared column.
+     * @param cmp The comparison (with a number) in a where clause.
+     */
+    static bool mayMatch(const Zone& zone, const Predicate& cmp);
+
+    /**
+     * Checks if a predicate node is a comparison of a column of table 0
+     * with a number, whose condition can use zones (i.e., not like or <>).
+     */
+    static bool usesZones(const Predicate& node);
+
+    /** The zones of each column */
+    std::vector<Column> columns;
+
+    /** The mutex used to build zones */
+    mutable std::mutex mutex;
+};
+
+#endif /* ZONE_MAP_H */
@@ -0,0 +1,522 @@
+/*
+ * Copyright (C) Ethan Gutknecht 2021 (gutkneET@miamioh.edu)
+ *
+ * A load generator to measure the throughput and latency of SQLAir. It
+ * generates a synthetic table and then runs a configurable mix of queries
+ * from multiple threads, either directly via SQLAir::process (in-process)
+ * or via requests to a running SQLAir server. Requests to a server use
+ * HTTP or the binary protocol (with prepared statements and, optionally,
+ * several pipelined requests per connection).
+ *
+ * This is a separate program (with its own main). Build it from the
+ * project directory (homework09) using "make bench", which runs:
+ *
+ *     g++ -std=c++14 -O2 -Wall -I. -o bench/sqlair_bench \
+ *         bench/sqlair_bench.cpp <all *.cpp except main.cpp> \
+ *         libsqlair_lib.a -lboost_system -lpthread
+ *
+ * The table and the queries are generated from --seed, so runs with the
+ * same options use the same table and queries (the timings still depend
+ * on the machine and its load).
+ *
+ * Example runs:
+ *
+ *     bench/sqlair_bench --rows=100000 --threads=8 --requests=20000
+ *     bench/sqlair_bench --server=localhost:8080 --rate=500 --duration=10 \
+ *         --mix=point:80,update:15,scan:5
+ *     bench/sqlair_bench --server=localhost:8081 --protocol=binary --pipeline=8
+ *
+ * The binary protocol is served only if the server was started with
+ * SQLAIR_BINARY_PORT set (to 8081 in this example).
+ *
+ * When using --server, run the benchmark from the directory from where the
+ * server was started so the server can load the generated table. The
+ * results are printed as a single line of JSON. For in-process runs, the
+ * results include the number of heap allocations made per request.
+ */
+
+#include <boost/asio.hpp>
+#include <cstdlib>
+#include <cctype>
+#include <cmath>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include <iomanip>
+#include <random>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <algorithm>
+#include <deque>
+#include "SQLAir.h"
+#include "Arena.h"
+#include "SQLAirClient.h"
+
+using Clock = std::chrono::steady_clock;
+
+/** The number of heap allocations made by each thread */
+thread_local long threadAllocs = 0;
+
+// Replace the global allocation functions to count heap allocations. The
+// count is per-thread so that counting does not add any contention.
+void* operator new(size_t size) {
+    threadAllocs++;
+    void* ptr = std::malloc(size == 0 ? 1 : size);
+    if (ptr == nullptr) {
+        throw std::bad_alloc();
+    }
+    return ptr;
+}
+
+// The default sized (and array) forms call these, so they are not replaced.
+void operator delete(void* ptr) noexcept {
+    std::free(ptr);
+}
+
+/** The different kinds of queries that can be used in a query mix */
+const StrVec QueryKinds = {"point", "scan", "update", "wait", "repeat"};
+
+/** The words used for the category column in the synthetic table */
+const int NumCategories = 16;
+
+/** The settings for a benchmark run, set from the command-line */
+struct Options {
+    std::string server;          // host:port or empty for in-process
+    std::string protocol = "http";  // http or binary, used with server
+    int pipeline      = 1;       // Requests in flight per binary connection
+    std::string table = "bench.csv";
+    int rows          = 10000;   // Rows in the synthetic table
+    int cols          = 0;       // Extra padding columns in the table
+    int threads       = 4;
+    long requests     = 10000;   // Used if duration is zero
+    double duration   = 0;       // Seconds to run, 0 to use requests
+    double rate       = 0;       // Requests/second, 0 for closed loop
+    unsigned seed     = 381;
+    bool generate     = true;    // Generate the table before running
+    std::vector<double> mix = {70, 20, 10, 0, 0};  // Weight of each kind
+};
+
+/** The results recorded by each thread */
+struct ThreadResult {
+    std::vector<uint64_t> latencies;  // Microseconds
+    std::vector<long> kindCounts = std::vector<long>(QueryKinds.size());
+    long errors = 0;
+    long allocs = 0;  // Heap allocations while processing queries
+};
+
+// Print the usage message and exit.
+void usage(const std::string& error) {
+    std::cerr << "Error: " << error << "\n"
+        "Usage: sqlair_bench [--server=host:port] [--protocol=http|binary]\n"
+        "    [--pipeline=1] [--table=bench.csv]\n"
+        "    [--rows=10000] [--cols=0] [--threads=4] [--requests=10000]\n"
+        "    [--duration=secs] [--rate=reqs/sec] [--seed=381]\n"
+        "    [--mix=point:70,scan:20,update:10,wait:0,repeat:0]"
+        " [--no-generate]\n";
+    std::exit(1);
+}
+
+// Parse a query mix of the form "point:70,scan:20,update:10".
+std::vector<double> parseMix(const std::string& mixStr) {
+    std::vector<double> mix(QueryKinds.size(), 0);
+    std::istringstream is(mixStr);
+    for (std::string entry; std::getline(is, entry, ',');) {
+        const size_t colon = entry.find(':');
+        const int kind = Helper::find(QueryKinds, entry.substr(0, colon));
+        if (kind == -1 || colon == std::string::npos) {
+            usage("Invalid query mix entry " + entry);
+        }
+        mix[kind] = std::stod(entry.substr(colon + 1));
+    }
+    if (*std::max_element(mix.begin(), mix.end()) <= 0) {
+        usage("The query mix must have at least one query kind");
+    }
+    return mix;
+}
+
+// Process the command-line arguments into options.
+Options parseArgs(int argc, char *argv[]) {
+    Options opts;
+    for (int i = 1; (i < argc); i++) {
+        const std::string arg = argv[i];
+        const size_t eq = arg.find('=');
+        const std::string key = arg.substr(0, eq);
+        const std::string val = (eq == std::string::npos ? "" :
+                                 arg.substr(eq + 1));
+        if (key == "--server") {
+            opts.server = val;
+        } else if (key == "--protocol") {
+            opts.protocol = val;
+        } else if (key == "--pipeline") {
+            opts.pipeline = std::max(1, std::stoi(val));
+        } else if (key == "--table") {
+            opts.table = val;
+        } else if (key == "--rows") {
+            opts.rows = std::stoi(val);
+        } else if (key == "--cols") {
+            opts.cols = std::stoi(val);
+        } else if (key == "--threads") {
+            opts.threads = std::max(1, std::stoi(val));
+        } else if (key == "--requests") {
+            opts.requests = std::stol(val);
+        } else if (key == "--duration") {
+            opts.duration = std::stod(val);
+        } else if (key == "--rate") {
+            opts.rate = std::stod(val);
+        } else if (key == "--seed") {
+            opts.seed = std::stoul(val);
+        } else if (key == "--mix") {
+            opts.mix = parseMix(val);
+        } else if (key == "--no-generate") {
+            opts.generate = false;
+        } else {
+            usage("Unknown option " + arg);
+        }
+    }
+    if (opts.rows < 1) {
+        usage("The table must have at least 1 row");
+    }
+    if (opts.protocol != "http" && opts.protocol != "binary") {
+        usage("The protocol must be http or binary");
+    }
+    if (opts.protocol == "binary" && opts.server.empty()) {
+        usage("The binary protocol requires --server");
+    }
+    return opts;
+}
+
+// Write a synthetic table with a unique id, a name, a category, a numeric
+// value, and optional padding columns. The same seed gives the same table.
+void generateTable(const Options& opts) {
+    std::ofstream csv(opts.table);
+    if (!csv.good()) {
+        usage("Unable to write " + opts.table);
+    }
+    std::mt19937 rnd(opts.seed);
+    csv << "\"id\",\"name\",\"category\",\"value\"";
+    for (int c = 0; (c < opts.cols); c++) {
+        csv << ",\"pad" << c << '"';
+    }
+    csv << '\n';
+    for (int r = 0; (r < opts.rows); r++) {
+        csv << '"' << r << "\",\"item " << r << "\",\"cat"
+            << rnd() % NumCategories << "\",\"" << rnd() % 1000 << '"';
+        for (int c = 0; (c < opts.cols); c++) {
+            csv << ",\"" << std::hex << rnd() << std::dec << '"';
+        }
+        csv << '\n';
+    }
+}
+
+// Return the query for a kind, with a ? for each parameter. The binary
+// protocol prepares these queries once and then sends just the parameters.
+std::string queryTemplate(int kind, const Options& opts) {
+    switch (kind) {
+    case 0:
+        return "select id, value from " + opts.table + " where id = ?";
+    case 1:
+        return "select id, name from " + opts.table + " where category = ? "
+            "and value > ?";
+    case 2:
+        return "update " + opts.table + " set value = ? where id = ?";
+    case 3:
+        // The row always exists, so this measures the cost of the wait path.
+        return "wait select id from " + opts.table + " where id = ?";
+    default:
+        // The same scan each time, like a dashboard that polls a table.
+        return "select id, name from " + opts.table + " where category = "
+            "'cat1' and value > 500";
+    }
+}
+
+// Create random parameters for a query of the given kind.
+StrVec makeParams(int kind, const Options& opts, std::mt19937& rnd) {
+    const std::string id = std::to_string(rnd() % opts.rows);
+    switch (kind) {
+    case 0:
+    case 3:
+        return {id};
+    case 1:
+        return {"cat" + std::to_string(rnd() % NumCategories),
+                std::to_string(rnd() % 1000)};
+    case 2:
+        return {std::to_string(rnd() % 1000), id};
+    default:
+        return {};
+    }
+}
+
+// Create a random query of the given kind, with the parameters quoted in
+// the text of the query.
+std::string makeQuery(int kind, const Options& opts, std::mt19937& rnd) {
+    const StrVec params = makeParams(kind, opts, rnd);
+    std::string query = queryTemplate(kind, opts);
+    size_t pos = 0;
+    for (const auto& param : params) {
+        pos = query.find('?', pos);
+        query.replace(pos, 1, "'" + param + "'");
+        pos += param.size() + 2;
+    }
+    return query;
+}
+
+// URL-encode a query to be sent in an HTTP request.
+std::string urlEncode(const std::string& str) {
+    std::ostringstream os;
+    for (const unsigned char c : str) {
+        if (std::isalnum(c) || c == '-' || c == '_' || c == '.') {
+            os << c;
+        } else {
+            os << '%' << std::uppercase << std::hex << std::setw(2)
+               << std::setfill('0') << (int) c << std::dec;
+        }
+    }
+    return os.str();
+}
+
+// Run a query on a SQLAir server and return the response (without headers)
+std::string runHttp(const std::string& server, const std::string& query) {
+    const size_t colon = server.find(':');
+    boost::asio::ip::tcp::iostream client(server.substr(0, colon),
+                                          server.substr(colon + 1));
+    if (!client.good()) {
+        throw Exp("Unable to connect to " + server);
+    }
+    client << "GET /sql-air?query=" << urlEncode(query) << " HTTP/1.1\r\n"
+           << "Host: " << server << "\r\nConnection: Close\r\n\r\n";
+    std::string status;
+    std::getline(client, status);
+    for (std::string hdr; std::getline(client, hdr) && !hdr.empty() &&
+             hdr != "\r";) {}
+    if (status.find("200 OK") == std::string::npos) {
+        throw Exp("Error (" + Helper::trim(status) + ") from " + server);
+    }
+    std::ostringstream resp;
+    resp << client.rdbuf();
+    return resp.str();
+}
+
+// Run a query either in-process or via HTTP. Returns false on errors.
+// For in-process runs, the heap allocations made by SQLAir are counted.
+bool runQuery(SQLAir& air, const Options& opts, const std::string& query,
+        long& allocs) {
+    try {
+        if (opts.server.empty()) {
+            // Reuse the output buffer of this thread, like the server does.
+            OutputBuffer& os = OutputBuffer::forThread();
+            const long before = threadAllocs;
+            air.process(query, os);
+            allocs += threadAllocs - before;
+            return true;
+        } else if (opts.protocol == "binary") {
+            // Used just to load the table. Workers keep their connections.
+            const size_t colon = opts.server.find(':');
+            SQLAirClient client(opts.server.substr(0, colon),
+                                opts.server.substr(colon + 1));
+            client.query(query);
+            return true;
+        }
+        return runHttp(opts.server, query).find("Error") != 0;
+    } catch (const std::exception&) {
+        return false;
+    }
+}
+
+// Returns the time when a request is to be started. In an open-loop run
+// each request has a scheduled start time and latency is measured from
+// then. So a slow server cannot hide its delays by slowing down the rate of
+// requests.
+Clock::time_point schedule(const Options& opts, long req,
+        Clock::time_point start) {
+    if (opts.rate <= 0) {
+        return Clock::now();
+    }
+    return start + std::chrono::duration_cast<Clock::duration>(
+        std::chrono::duration<double>(req / opts.rate));
+}
+
+// Thread-main method to keep running queries until the run ends.
+void worker(SQLAir& air, const Options& opts, int thrId,
+        std::atomic<long>& nextReq, Clock::time_point start,
+        ThreadResult& result) {
+    std::mt19937 rnd(opts.seed + thrId + 1);
+    std::discrete_distribution<int> kinds(opts.mix.begin(), opts.mix.end());
+    const Clock::time_point end = start +
+        std::chrono::duration_cast<Clock::duration>(
+            std::chrono::duration<double>(opts.duration));
+    while (true) {
+        const long req = nextReq++;
+        if (opts.duration <= 0 && req >= opts.requests) {
+            break;
+        }
+        const Clock::time_point sched = schedule(opts, req, start);
+        std::this_thread::sleep_until(sched);
+        if (opts.duration > 0 && sched >= end) {
+            break;
+        }
+        const int kind = kinds(rnd);
+        const bool ok  = runQuery(air, opts, makeQuery(kind, opts, rnd),
+                                  result.allocs);
+        result.latencies.push_back(std::chrono::duration_cast<
+            std::chrono::microseconds>(Clock::now() - sched).count());
+        result.kindCounts[kind]++;
+        result.errors += (ok ? 0 : 1);
+    }
+}
+
+// Thread-main method to run queries via the binary protocol. Each thread
+// has one connection with up to opts.pipeline requests in flight.
+void binaryWorker(const Options& opts, int thrId, std::atomic<long>& nextReq,
+        Clock::time_point start, ThreadResult& result) {
+    std::mt19937 rnd(opts.seed + thrId + 1);
+    std::discrete_distribution<int> kinds(opts.mix.begin(), opts.mix.end());
+    const Clock::time_point end = start +
+        std::chrono::duration_cast<Clock::duration>(
+            std::chrono::duration<double>(opts.duration));
+    const size_t colon = opts.server.find(':');
+    std::unique_ptr<SQLAirClient> client;
+    std::vector<uint32_t> stmts;
+    try {
+        client.reset(new SQLAirClient(opts.server.substr(0, colon),
+                                      opts.server.substr(colon + 1)));
+        for (size_t kind = 0; (kind < QueryKinds.size()); kind++) {
+            stmts.push_back(client->prepare(queryTemplate(kind, opts)));
+        }
+    } catch (const std::exception& exp) {
+        usage(std::string("Unable to prepare queries: ") + exp.what());
+    }
+    // The requests in flight: request id, scheduled time, and kind.
+    struct InFlight {
+        uint32_t reqId;
+        Clock::time_point sched;
+        int kind;
+    };
+    std::deque<InFlight> inFlight;
+    for (bool more = true; (more || !inFlight.empty());) {
+        // Send requests until opts.pipeline of them are in flight.
+        while (more && static_cast<int>(inFlight.size()) < opts.pipeline) {
+            const long req = nextReq++;
+            const Clock::time_point sched = schedule(opts, req, start);
+            if ((opts.duration <= 0 && req >= opts.requests) ||
+                (opts.duration > 0 && sched >= end)) {
+                more = false;
+                break;
+            }
+            if (sched > Clock::now()) {
+                client->flush();  // Do not hold requests while sleeping.
+                std::this_thread::sleep_until(sched);
+            }
+            const int kind = kinds(rnd);
+            inFlight.push_back({client->send(stmts[kind],
+                makeParams(kind, opts, rnd)), sched, kind});
+        }
+        if (inFlight.empty()) {
+            break;
+        }
+        // Then wait for the oldest one.
+        const InFlight done = inFlight.front();
+        inFlight.pop_front();
+        bool ok = true;
+        try {
+            client->wait(done.reqId);
+        } catch (const std::exception&) {
+            ok = false;
+        }
+        result.latencies.push_back(std::chrono::duration_cast<
+            std::chrono::microseconds>(Clock::now() - done.sched).count());
+        result.kindCounts[done.kind]++;
+        result.errors += (ok ? 0 : 1);
+    }
+}
+
+// Returns the latency (in microseconds) at a given percentile.
+uint64_t percentile(const std::vector<uint64_t>& sorted, double pct) {
+    if (sorted.empty()) {
+        return 0;
+    }
+    const size_t rank = std::ceil(pct / 100 * sorted.size());
+    return sorted[std::min(sorted.size(), std::max<size_t>(rank, 1)) - 1];
+}
+
+int main(int argc, char *argv[]) {
+    const Options opts = parseArgs(argc, argv);
+    if (opts.generate) {
+        generateTable(opts);
+    }
+    SQLAir air;
+    // Load the table (on the server or in-process) before timing.
+    long allocs = 0;
+    if (!runQuery(air, opts, "select id from " + opts.table +
+                  " where id = 0", allocs)) {
+        usage("Unable to query " + opts.table);
+    }
+
+    std::vector<ThreadResult> results(opts.threads);
+    std::vector<std::thread> thrList;
+    std::atomic<long> nextReq = {0};
+    const Clock::time_point start = Clock::now();
+    for (int i = 0; (i < opts.threads); i++) {
+        if (opts.protocol == "binary") {
+            thrList.push_back(std::thread(binaryWorker, std::cref(opts), i,
+                std::ref(nextReq), start, std::ref(results[i])));
+        } else {
+            thrList.push_back(std::thread(worker, std::ref(air),
+                std::cref(opts), i, std::ref(nextReq), start,
+                std::ref(results[i])));
+        }
+    }
+    for (auto& thr : thrList) {
+        thr.join();
+    }
+    const double elapsed =
+        std::chrono::duration<double>(Clock::now() - start).count();
+
+    // Combine the results from all the threads.
+    std::vector<uint64_t> latencies;
+    std::vector<long> kindCounts(QueryKinds.size());
+    long errors = 0;
+    allocs = 0;
+    for (const auto& res : results) {
+        latencies.insert(latencies.end(), res.latencies.begin(),
+                         res.latencies.end());
+        for (size_t k = 0; (k < QueryKinds.size()); k++) {
+            kindCounts[k] += res.kindCounts[k];
+        }
+        errors += res.errors;
+        allocs += res.allocs;
+    }
+    std::sort(latencies.begin(), latencies.end());
+    double total = 0;
+    for (const auto lat : latencies) {
+        total += lat;
+    }
+
+    // Print the results as a single line of JSON.
+    std::cout << std::fixed << std::setprecision(3) << "{\"mode\":\""
+              << (opts.server.empty() ? "in-process" : opts.protocol)
+              << "\",\"pipeline\":" << opts.pipeline << ",\"rows\":"
+              << opts.rows << ",\"cols\":" << 4 + opts.cols
+              << ",\"threads\":" << opts.threads << ",\"rate\":" << opts.rate
+              << ",\"seed\":" << opts.seed << ",\"requests\":"
+              << latencies.size() << ",\"errors\":" << errors
+              << ",\"elapsed_sec\":" << elapsed << ",\"throughput_rps\":"
+              << latencies.size() / elapsed << ",\"allocs_per_request\":"
+              << (opts.server.empty() && !latencies.empty() ?
+                  double(allocs) / latencies.size() : 0) << ",\"mix\":{";
+    for (size_t k = 0; (k < QueryKinds.size()); k++) {
+        std::cout << (k ? "," : "") << '"' << QueryKinds[k] << "\":"
+                  << kindCounts[k];
+    }
+    std::cout << "},\"latency_us\":{\"mean\":"
+              << (latencies.empty() ? 0 : total / latencies.size());
+    for (const double pct : {50.0, 90.0, 99.0, 99.9}) {
+        std::cout << ",\"p" << std::setprecision(pct < 99.5 ? 0 : 1) << pct
+                  << "\":" << percentile(latencies, pct);
+    }
+    std::cout << ",\"max\":" << (latencies.empty() ? 0 : latencies.back())
+              << "}}" << std::endl;
+    return (errors == 0 ? 0 : 2);
+}
@@ -35,7 +35,32 @@ OBJECTDIR=${CND_BUILDDIR}/${CND_CONF}/${CND_PLATFORM}
 
 # Object Files
 OBJECTFILES= \
+	${OBJECTDIR}/AdmissionQueue.o \
+	${OBJECTDIR}/Arena.o \
+	${OBJECTDIR}/Catalog.o \
+	${OBJECTDIR}/Cursor.o \
+	${OBJECTDIR}/Dictionary.o \
+	${OBJECTDIR}/Expression.o \
+	${OBJECTDIR}/HashJoin.o \
+	${OBJECTDIR}/LazyColumns.o \
+	${OBJECTDIR}/Metrics.o \
+	${OBJECTDIR}/Predicate.o \
+	${OBJECTDIR}/QueryStats.o \
+	${OBJECTDIR}/Replication.o \
+	${OBJECTDIR}/ResultCache.o \
 	${OBJECTDIR}/SQLAir.o \
+	${OBJECTDIR}/SQLAirClient.o \
+	${OBJECTDIR}/ScanPlan.o \
+	${OBJECTDIR}/Session.o \
+	${OBJECTDIR}/Sharding.o \
+	${OBJECTDIR}/StaticFiles.o \
+	${OBJECTDIR}/StreamScan.o \
+	${OBJECTDIR}/TableStats.o \
+	${OBJECTDIR}/Transaction.o \
+	${OBJECTDIR}/TrigramIndex.o \
+	${OBJECTDIR}/WaitList.o \
+	${OBJECTDIR}/WireProtocol.o \
+	${OBJECTDIR}/ZoneMap.o \
 	${OBJECTDIR}/main.o
 
 
@@ -64,11 +89,136 @@ homework09: libsqlair_lib.a
 homework09: ${OBJECTFILES}
 	${LINK.cc} -o homework09 ${OBJECTFILES} ${LDLIBSOPTIONS} -lboost_system -lpthread -lmysqlpp
 
+${OBJECTDIR}/AdmissionQueue.o: AdmissionQueue.cpp
+	${MKDIR} -p ${OBJECTDIR}
+	${RM} "$@.d"
+	$(COMPILE.cc) -g -Wall -std=c++14 -MMD -MP -MF "$@.d" -o ${OBJECTDIR}/AdmissionQueue.o AdmissionQueue.cpp
+
+${OBJECTDIR}/Arena.o: Arena.cpp
+	${MKDIR} -p ${OBJECTDIR}
+	${RM} "$@.d"
+	$(COMPILE.cc) -g -Wall -std=c++14 -MMD -MP -MF "$@.d" -o ${OBJECTDIR}/Arena.o Arena.cpp
+
+${OBJECTDIR}/Catalog.o: Catalog.cpp
+	${MKDIR} -p ${OBJECTDIR}
+	${RM} "$@.d"
+	$(COMPILE.cc) -g -Wall -std=c++14 -MMD -MP -MF "$@.d" -o ${OBJECTDIR}/Catalog.o Catalog.cpp
+
+${OBJECTDIR}/Cursor.o: Cursor.cpp
+	${MKDIR} -p ${OBJECTDIR}
+	${RM} "$@.d"
+	$(COMPILE.cc) -g -Wall -std=c++14 -MMD -MP -MF "$@.d" -o ${OBJECTDIR}/Cursor.o Cursor.cpp
+
+${OBJECTDIR}/Dictionary.o: Dictionary.cpp
+	${MKDIR} -p ${OBJECTDIR}
+	${RM} "$@.d"
+	$(COMPILE.cc) -g -Wall -std=c++14 -MMD -MP -MF "$@.d" -o ${OBJECTDIR}/Dictionary.o Dictionary.cpp
+
+${OBJECTDIR}/Expression.o: Expression.cpp
+	${MKDIR} -p ${OBJECTDIR}
+	${RM} "$@.d"
+	$(COMPILE.cc) -g -Wall -std=c++14 -MMD -MP -MF "$@.d" -o ${OBJECTDIR}/Expression.o Expression.cpp
+
+${OBJECTDIR}/HashJoin.o: HashJoin.cpp
+	${MKDIR} -p ${OBJECTDIR}
+	${RM} "$@.d"
+	$(COMPILE.cc) -g -Wall -std=c++14 -MMD -MP -MF "$@.d" -o ${OBJECTDIR}/HashJoin.o HashJoin.cpp
+
+${OBJECTDIR}/LazyColumns.o: LazyColumns.cpp
+	${MKDIR} -p ${OBJECTDIR}
+	${RM} "$@.d"
+	$(COMPILE.cc) -g -Wall -std=c++14 -MMD -MP -MF "$@.d" -o ${OBJECTDIR}/LazyColumns.o LazyColumns.cpp
+
+${OBJECTDIR}/Metrics.o: Metrics.cpp
+	${MKDIR} -p ${OBJECTDIR}
+	${RM} "$@.d"
+	$(COMPILE.cc) -g -Wall -std=c++14 -MMD -MP -MF "$@.d" -o ${OBJECTDIR}/Metrics.o Metrics.cpp
+
+${OBJECTDIR}/Predicate.o: Predicate.cpp
+	${MKDIR} -p ${OBJECTDIR}
+	${RM} "$@.d"
+	$(COMPILE.cc) -g -Wall -std=c++14 -MMD -MP -MF "$@.d" -o ${OBJECTDIR}/Predicate.o Predicate.cpp
+
+${OBJECTDIR}/QueryStats.o: QueryStats.cpp
+	${MKDIR} -p ${OBJECTDIR}
+	${RM} "$@.d"
+	$(COMPILE.cc) -g -Wall -std=c++14 -MMD -MP -MF "$@.d" -o ${OBJECTDIR}/QueryStats.o QueryStats.cpp
+
+${OBJECTDIR}/Replication.o: Replication.cpp
+	${MKDIR} -p ${OBJECTDIR}
+	${RM} "$@.d"
+	$(COMPILE.cc) -g -Wall -std=c++14 -MMD -MP -MF "$@.d" -o ${OBJECTDIR}/Replication.o Replication.cpp
+
+${OBJECTDIR}/ResultCache.o: ResultCache.cpp
+	${MKDIR} -p ${OBJECTDIR}
+	${RM} "$@.d"
+	$(COMPILE.cc) -g -Wall -std=c++14 -MMD -MP -MF "$@.d" -o ${OBJECTDIR}/ResultCache.o ResultCache.cpp
+
 ${OBJECTDIR}/SQLAir.o: SQLAir.cpp
 	${MKDIR} -p ${OBJECTDIR}
 	${RM} "$@.d"
 	$(COMPILE.cc) -g -Wall -std=c++14 -MMD -MP -MF "$@.d" -o ${OBJECTDIR}/SQLAir.o SQLAir.cpp
 
+${OBJECTDIR}/SQLAirClient.o: SQLAirClient.cpp
+	${MKDIR} -p ${OBJECTDIR}
+	${RM} "$@.d"
+	$(COMPILE.cc) -g -Wall -std=c++14 -MMD -MP -MF "$@.d" -o ${OBJECTDIR}/SQLAirClient.o SQLAirClient.cpp
+
+${OBJECTDIR}/ScanPlan.o: ScanPlan.cpp
+	${MKDIR} -p ${OBJECTDIR}
+	${RM} "$@.d"
+	$(COMPILE.cc) -g -Wall -std=c++14 -MMD -MP -MF "$@.d" -o ${OBJECTDIR}/ScanPlan.o ScanPlan.cpp
+
+${OBJECTDIR}/Session.o: Session.cpp
+	${MKDIR} -p ${OBJECTDIR}
+	${RM} "$@.d"
+	$(COMPILE.cc) -g -Wall -std=c++14 -MMD -MP -MF "$@.d" -o ${OBJECTDIR}/Session.o Session.cpp
+
+${OBJECTDIR}/Sharding.o: Sharding.cpp
+	${MKDIR} -p ${OBJECTDIR}
+	${RM} "$@.d"
+	$(COMPILE.cc) -g -Wall -std=c++14 -MMD -MP -MF "$@.d" -o ${OBJECTDIR}/Sharding.o Sharding.cpp
+
+${OBJECTDIR}/StaticFiles.o: StaticFiles.cpp
+	${MKDIR} -p ${OBJECTDIR}
+	${RM} "$@.d"
+	$(COMPILE.cc) -g -Wall -std=c++14 -MMD -MP -MF "$@.d" -o ${OBJECTDIR}/StaticFiles.o StaticFiles.cpp
+
+${OBJECTDIR}/StreamScan.o: StreamScan.cpp
+	${MKDIR} -p ${OBJECTDIR}
+	${RM} "$@.d"
+	$(COMPILE.cc) -g -Wall -std=c++14 -MMD -MP -MF "$@.d" -o ${OBJECTDIR}/StreamScan.o StreamScan.cpp
+
+${OBJECTDIR}/TableStats.o: TableStats.cpp
+	${MKDIR} -p ${OBJECTDIR}
+	${RM} "$@.d"
+	$(COMPILE.cc) -g -Wall -std=c++14 -MMD -MP -MF "$@.d" -o ${OBJECTDIR}/TableStats.o TableStats.cpp
+
+${OBJECTDIR}/Transaction.o: Transaction.cpp
+	${MKDIR} -p ${OBJECTDIR}
+	${RM} "$@.d"
+	$(COMPILE.cc) -g -Wall -std=c++14 -MMD -MP -MF "$@.d" -o ${OBJECTDIR}/Transaction.o Transaction.cpp
+
+${OBJECTDIR}/TrigramIndex.o: TrigramIndex.cpp
+	${MKDIR} -p ${OBJECTDIR}
+	${RM} "$@.d"
+	$(COMPILE.cc) -g -Wall -std=c++14 -MMD -MP -MF "$@.d" -o ${OBJECTDIR}/TrigramIndex.o TrigramIndex.cpp
+
+${OBJECTDIR}/WaitList.o: WaitList.cpp
+	${MKDIR} -p ${OBJECTDIR}
+	${RM} "$@.d"
+	$(COMPILE.cc) -g -Wall -std=c++14 -MMD -MP -MF "$@.d" -o ${OBJECTDIR}/WaitList.o WaitList.cpp
+
+${OBJECTDIR}/WireProtocol.o: WireProtocol.cpp
+	${MKDIR} -p ${OBJECTDIR}
+	${RM} "$@.d"
+	$(COMPILE.cc) -g -Wall -std=c++14 -MMD -MP -MF "$@.d" -o ${OBJECTDIR}/WireProtocol.o WireProtocol.cpp
+
+${OBJECTDIR}/ZoneMap.o: ZoneMap.cpp
+	${MKDIR} -p ${OBJECTDIR}
+	${RM} "$@.d"
+	$(COMPILE.cc) -g -Wall -std=c++14 -MMD -MP -MF "$@.d" -o ${OBJECTDIR}/ZoneMap.o ZoneMap.cpp
+
 ${OBJECTDIR}/main.o: main.cpp
 	${MKDIR} -p ${OBJECTDIR}
 	${RM} "$@.d"
@@ -0,0 +1,99 @@
+/*
+ * Copyright (C) Ethan Gutknecht 2021 (gutkneET@miamioh.edu)
+ *
+ * Tests for the binary protocol (see WireProtocol.h), which the tests in
+ * the *_tests.txt files (run via HTTP) cannot reach. Build it with
+ * "make binary-test" and run it against a server started (from the
+ * project directory) with the binary protocol enabled:
+ *
+ *     SQLAIR_BINARY_PORT=5401 ./homework09 5400 &
+ *     tests/binary_protocol_test localhost 5401
+ *
+ * The test restores the values it changes in test.csv.
+ */
+
+#include <iostream>
+#include <string>
+#include "SQLAirClient.h"
+
+// The number of checks run and passed.
+int numChecks = 0, numPassed = 0;
+
+// Print a message if the value returned by the server is not as expected.
+void check(const std::string& what, const std::string& expected,
+        const std::string& actual) {
+    numChecks++;
+    if (actual == expected) {
+        numPassed++;
+    } else {
+        std::cout << "FAIL: " << what << "\n--exp--\n" << expected
+                  << "\n--got--\n" << actual << std::endl;
+    }
+}
+
+// Return the value in the first row of a result, or the message if the
+// result has no rows.
+std::string firstValue(const SQLAirClient::Result& res) {
+    for (const auto& batch : res.batches) {
+        if (batch.rows > 0) {
+            return batch.columns.front().text(0);
+        }
+    }
+    return res.message;
+}
+
+// Bound values are used as is and never parsed as SQL.
+void testBoundValues(SQLAirClient& client) {
+    const uint32_t setTitle = client.prepare(
+        "update test.csv set title = ? where movieid = ?");
+    const uint32_t setRaters = client.prepare(
+        "update test.csv set raters = ? where movieid = ?");
+    const uint32_t getTitle = client.prepare(
+        "select title from test.csv where movieid = ?");
+    const uint32_t getRaters = client.prepare(
+        "select raters from test.csv where movieid = ?");
+    const uint32_t byTitle = client.prepare(
+        "select movieid from test.csv where title = ?");
+
+    // A value "where" does not end the set clause.
+    check("set title = 'where'", "1 row(s) updated.\n",
+          client.execute(setTitle, {"where", "176389"}).message);
+    check("title set to 'where'", "where",
+          firstValue(client.execute(getTitle, {"176389"})));
+    check("where title = 'where'", "176389",
+          firstValue(client.execute(byTitle, {"where"})));
+
+    // A value with operators is not an arithmetic expression.
+    client.execute(setRaters, {"raters*0", "176389"});
+    check("raters set to 'raters*0'", "raters*0",
+          firstValue(client.execute(getRaters, {"176389"})));
+    client.execute(setRaters, {"year-1", "176389"});
+    check("raters set to 'year-1'", "year-1",
+          firstValue(client.execute(getRaters, {"176389"})));
+
+    // A value of parentheses is not split into parentheses.
+    check("where title = '(('", "0 row(s) selected.\n",
+          firstValue(client.execute(byTitle, {"(("})));
+
+    // Restore the values.
+    client.execute(setTitle, {"The Nut Job 2: Nutty by Nature", "176389"});
+    client.execute(setRaters, {"1", "176389"});
+    check("raters restored", "1",
+          firstValue(client.execute(getRaters, {"176389"})));
+}
+
+int main(int argc, char *argv[]) {
+    if (argc != 3) {
+        std::cerr << "Usage: " << argv[0] << " <host> <binary port>\n";
+        return 2;
+    }
+    try {
+        SQLAirClient client(argv[1], argv[2]);
+        testBoundValues(client);
+    } catch (const std::exception& exp) {
+        std::cout << "Error: " << exp.what() << std::endl;
+        return 1;
+    }
+    std::cout << numPassed << "/" << numChecks << " passed" << std::endl;
+    return (numPassed == numChecks ? 0 : 1);
+}
@@ -11,6 +11,17 @@ var cmdID = 1;
 // to estimate the time taken to get response from the server.
 var startTime = 0;
 
+// A random ID for the session of this page, so that statements such as
+// begin and commit apply to the same session across requests.
+var sessionID = Math.random().toString(36).substring(2);
+
+// The number of rows of a select that are fetched (and shown) at a time.
+var pageSize = 100;
+
+// The cursor (and its button) of the last select with more rows to show,
+// which is closed when another select is run, or null if there is none.
+var openCursor = null;
+
 /**
  * This method intercepts and handles the enter key by sending a request
  * to the SQLAir web-serer.
@@ -98,9 +109,110 @@ function formatResponse(resp) {
     return tbl + msg;
 }
 
+/**
+ * Helper method to send a command to the SQLAir web-server as an Ajax
+ * call. The call does not block the page and the response is passed to a
+ * callback when it is received.
+ *
+ * @param {string} cmd The command to be run on the server.
+ * @param {function} done The callback that is given the response.
+ *
+ * @returns {undefined} This method does not return any value.
+ */
+function send(cmd, done) {
+    var xhttp = new XMLHttpRequest();
+    xhttp.onreadystatechange = function() {
+        // An overloaded server responds (with status 503) with an error
+        // message that is shown just like other errors.
+        if (this.readyState === 4) {
+            done(this.status !== 0 ? this.responseText :
+                 "Error: No response from the server.");
+        }
+    };
+    console.log("Running command: " + cmd);
+    // The command (which may be a batch of statements) is sent as the
+    // body, as it may be too long for an URL.
+    xhttp.open("POST", "/sql-air?session=" + sessionID, true);
+    xhttp.setRequestHeader("Content-Type", "text/plain");
+    // Save the tarting time.
+    startTime = new Date().getMilliseconds();
+    xhttp.send(cmd);
+}
+
+/**
+ * Checks if a command is a select whose results can be shown page by page
+ * via a cursor. Joins, stream() scans, and batches of statements are not
+ * supported by cursors.
+ *
+ * @param {string} cmd The command to be checked.
+ *
+ * @returns {boolean} True if the results are to be shown in pages.
+ */
+function isPaged(cmd) {
+    return /^\s*select\s/i.test(cmd) &&
+        !/\sjoin\s|stream\s*\(|;\s*\S/i.test(cmd);
+}
+
+/**
+ * Helper method to fetch and show the next page of rows from a cursor. The
+ * rows are added to the table with the rows of the earlier pages, and a
+ * button to show the next page is added until there are no more rows.
+ *
+ * @param {type} output The div of the command that declared the cursor.
+ * @param {type} results The div with the earlier pages, if any.
+ * @param {string} cursor The name of the cursor.
+ *
+ * @returns {undefined} This method does not return any value.
+ */
+function fetchPage(output, results, cursor) {
+    send("fetch " + pageSize + " from " + cursor, function(resp) {
+        var page = document.createElement('div');
+        page.innerHTML = formatResponse(resp);
+        if (results === null) {
+            results = page;
+            output.appendChild(results);
+            // Create input box for user to enter the next command to run.
+            createInput();
+        } else {
+            // Move the rows (without the header) to the earlier pages and
+            // replace the message and button of the previous page.
+            var table = results.querySelector("table");
+            var rows = page.querySelectorAll("tr");
+            for (var i = 1; (table !== null && i < rows.length); i++) {
+                table.appendChild(rows[i]);
+            }
+            results.removeChild(results.querySelector("p"));
+            var button = results.querySelector("button");
+            if (button !== null) {
+                results.removeChild(button);
+            }
+            results.appendChild(page.querySelector("p"));
+        }
+        if (openCursor !== null && openCursor.name === cursor) {
+            openCursor = null;
+        }
+        if (resp.startsWith("Error")) {
+            return;  // The server closed the cursor.
+        } else if (resp.indexOf("No more rows") !== -1) {
+            send("close " + cursor, function() {});
+            return;
+        }
+        var more = document.createElement('button');
+        more.innerHTML = "Show the next " + pageSize + " rows";
+        more.onclick = function() {
+            more.disabled = true;
+            fetchPage(output, results, cursor);
+        };
+        results.appendChild(more);
+        openCursor = {name: cursor, button: more};
+    });
+}
+
 /**
  * Helper method to run a given command and also print the response when
- * it is received from the server. It sends the response as an Ajax call.
+ * it is received from the server. The results of a select are fetched
+ * (and shown) a page at a time via a cursor, so that big results are not
+ * sent all at once.
  * 
  * @param {type} cmd The command to be run on the server.
  * 
@@ -108,30 +220,36 @@ function formatResponse(resp) {
  */
 function run(cmd) {
     if (cmd.length > 0) {
-        // Run the command using an AJAX request.
-        var xhttp = new XMLHttpRequest();
-        // Setup handler to add result to the HTML
-        xhttp.onreadystatechange = function() {
-            if (this.readyState === 4 && this.status === 200) {
-                // Nicely format the result.
-                var result = formatResponse(this.responseText);
-                // Put results in a div.
-                var resDiv = document.createElement('div');
-                // Add results div to the input div to organize things
-                // nicely for the user.
-                resDiv.innerHTML = result;
-                var output = document.getElementById("" + cmdID);
-                output.appendChild(resDiv);
-               // Create input box for user to enter the next command to run.
-                createInput();
+        var output = document.getElementById("" + cmdID);
+        if (isPaged(cmd)) {
+            if (openCursor !== null) {
+                // Only the results of the last select can be paged.
+                openCursor.button.remove();
+                send("close " + openCursor.name, function() {});
+                openCursor = null;
             }
-        };
-        // Run the command.
-        console.log("Running command: " + cmd);
-        cmd = encodeURIComponent(cmd);
-        xhttp.open("GET", "/sql-air?query=" + cmd, false);
-        // Save the tarting time.
-        startTime = new Date().getMilliseconds();
-        xhttp.send();
+            var cursor = "page" + cmdID;
+            send("declare " + cursor + " cursor for " + cmd, function(resp) {
+                if (resp.startsWith("Error")) {
+                    var resDiv = document.createElement('div');
+                    resDiv.innerHTML = formatResponse(resp);
+                    output.appendChild(resDiv);
+                    createInput();
+                } else {
+                    fetchPage(output, null, cursor);
+                }
+            });
+            return;
+        }
+        send(cmd, function(resp) {
+            // Put the nicely formatted results in a div.
+            var resDiv = document.createElement('div');
+            resDiv.innerHTML = formatResponse(resp);
+            // Add results div to the input div to organize things
+            // nicely for the user.
+            output.appendChild(resDiv);
+            // Create input box for user to enter the next command to run.
+            createInput();
+        });
     }
 }